@@ -17,12 +17,50 @@ DEFINES += QT_DEPRECATED_WARNINGS
 
 SOURCES += main.cpp \
     atomengineserver.cpp \
+    blacklist.cpp \
+    binaryprotocol.cpp \
+    commands.cpp \
+    connectionworker.cpp \
     dbmanager.cpp \
+    dbwriter.cpp \
+    eventjournal.cpp \
     info.cpp \
-    logger.cpp
+    jsonreader.cpp \
+    lineframer.cpp \
+    logger.cpp \
+    metrics.cpp \
+    metricsserver.cpp \
+    orderbook.cpp \
+    ratelimiter.cpp \
+    replystream.cpp \
+    request.cpp \
+    snapshot.cpp \
+    subscriptions.cpp \
+    tcpserver.cpp \
+    terminationwatcher.cpp
 
 HEADERS += \
     atomengineserver.h \
+    blacklist.h \
+    binaryprotocol.h \
+    commands.h \
+    connectionworker.h \
     dbmanager.h \
+    dbwriter.h \
+    eventjournal.h \
     info.h \
-    logger.h
+    ipkey.h \
+    jsonreader.h \
+    lineframer.h \
+    logger.h \
+    metrics.h \
+    metricsserver.h \
+    orderbook.h \
+    ratelimiter.h \
+    replystream.h \
+    request.h \
+    slabpool.h \
+    snapshot.h \
+    subscriptions.h \
+    tcpserver.h \
+    terminationwatcher.h
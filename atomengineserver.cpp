@@ -11,40 +11,98 @@
 #include <QByteArrayList>
 #include "logger.h"
 #include <QDateTime>
+#include <QElapsedTimer>
+#include <algorithm>
+#include <iterator>
 #include "dbmanager.h"
+#include "snapshot.h"
+#include "tcpserver.h"
+#include "binaryprotocol.h"
+#include "metrics.h"
+#include "metricsserver.h"
+#include "slabpool.h"
 
 namespace {
     const QString backupFileName = "info.dat";
+    const QString journalFileName = "info.journal";
     const QString curVersion = "0.3";
     const QString settingsFileName = "Settings.conf";
 }
 
 AtomEngineServer::AtomEngineServer() :
+    nextWorker_(0),
+    curConnectionId_(0),
+    binaryConnections_(0),
     curOrderId_(0),
     curTradeId_(0),
     backupFile_(backupFileName),
     settings_(nullptr),
+    blackListTtl_(0),
     maxRequestSize_(0),
     requestCheckingInterval_(0),
-    requestsCount_(0)
+    requestsCount_(0),
+    metricsServer_(nullptr)
 {
+    qRegisterMetaType<qintptr>("qintptr");
+    qRegisterMetaType<Requests>("Requests");
+    qRegisterMetaType<ReplyStreamPtr>("ReplyStreamPtr");
+    qRegisterMetaType<QVector<qintptr>>("QVector<qintptr>");
+
     settings_ = new QSettings("settings.conf", QSettings::IniFormat);
 
-    server_ = new QTcpServer();
-    connect(server_, SIGNAL(newConnection()), this, SLOT(onNewConnection()));
+    server_ = new TcpServer();
+    server_->setBlackList(&blackList_);
+    connect(server_, SIGNAL(socketAccepted(qintptr)), this, SLOT(onSocketAccepted(qintptr)));
+    connect(&queuesTimer_, SIGNAL(timeout()), this, SLOT(onReportQueues()));
+    connect(&blackListTimer_, SIGNAL(timeout()), this, SLOT(onExpireBlackList()));
+    presenceTimer_.setSingleShot(true);
+    connect(&presenceTimer_, SIGNAL(timeout()), this, SLOT(onFlushPresence()));
+
+    Metrics& metrics = Metrics::instance();
+    for (int command = 0; command < Commands::Count; ++command) {
+        QString labels = QString("command=\"") + Commands::name(Commands::Command(command)) + "\"";
+        commandsMetrics_[command].requests = metrics.counter("atom_engine_requests_total", "Requests handled by the engine", labels);
+        commandsMetrics_[command].duration = metrics.histogram("atom_engine_command_duration_us", "Time of handling a request in the engine thread", labels);
+        commandCosts_[command] = 1.0;
+    }
+    broadcastRecipients_ = metrics.histogram("atom_engine_broadcast_recipients", "Connections a broadcast message is sent to");
+    openBlackListHits_ = metrics.counter("atom_engine_black_list_hits_total", "Connections and requests rejected by the black list", "stage=\"open\"");
+    requestBlackListHits_ = metrics.counter("atom_engine_black_list_hits_total", "Connections and requests rejected by the black list", "stage=\"request\"");
+    rateLimited_ = metrics.counter("atom_engine_rate_limited_total", "Clients black listed for exceeding the request rate");
+    connectionsGauge_ = metrics.gauge("atom_engine_connections", "Open client connections");
+    binaryConnectionsGauge_ = metrics.gauge("atom_engine_binary_connections", "Open client connections which use the binary protocol");
+    outputQueueBytesGauge_ = metrics.gauge("atom_engine_output_queue_bytes", "Bytes written by the engine which the clients did not read yet");
+    dbQueueDepthGauge_ = metrics.gauge("atom_engine_db_queue_depth", "Mutations waiting for the database writer");
+    blackListSizeGauge_ = metrics.gauge("atom_engine_black_list_entries", "Addresses and ranges in the black list");
+    rateLimiterBucketsGauge_ = metrics.gauge("atom_engine_rate_limiter_buckets", "Client IPs with a partly used request budget");
+    poolBytesGauge_ = metrics.gauge("atom_engine_pool_bytes", "Bytes of the slabs orders and trades are allocated from");
+    poolUsedBytesGauge_ = metrics.gauge("atom_engine_pool_used_bytes", "Bytes of the slabs which hold live orders and trades");
 }
 
 AtomEngineServer::~AtomEngineServer()
 {
-    for (auto it = connections_.begin(); it != connections_.end(); ++it) {
-        it->second->close();
-    }
+    stopWorkers();
+    DBManager::instance().shutdown();
+    delete metricsServer_;
     delete server_;
     Logger::info() << "Atom engine was closed";
 }
 
 bool AtomEngineServer::run()
 {
+    if (settings_) {
+        Logger::Settings loggerSettings;
+        QString level = settings_->value("logging/level", "debug").toString();
+        if (!Logger::parseLevel(level, loggerSettings.level)) {
+            Logger::warning() << "Unknown logging level " + level + ", using debug";
+        }
+        loggerSettings.debugSampling = settings_->value("logging/debug_sampling", loggerSettings.debugSampling).toInt();
+        loggerSettings.maxFileSize = settings_->value("logging/max_file_size_bytes", loggerSettings.maxFileSize).toLongLong();
+        loggerSettings.maxFiles = settings_->value("logging/max_files", loggerSettings.maxFiles).toInt();
+        loggerSettings.console = settings_->value("logging/console", loggerSettings.console).toBool();
+        loggerSettings.flushIntervalMs = settings_->value("logging/flush_interval_ms", loggerSettings.flushIntervalMs).toInt();
+        Logger::configure(loggerSettings);
+    }
     Logger::info() << "Atom engine start";
     if (!settings_) {
         Logger::info() << "Start failed: settings are not initialized";
@@ -55,16 +113,70 @@ bool AtomEngineServer::run()
         Logger::info() << "Start failed: need set a port";
         return false;
     }
-    load();
-    QString dbName = settings_->value("database/name", "engine.db").toString();
-    if (!DBManager::instance().init(dbName)) {
+    DBSettings dbSettings;
+    dbSettings.name = settings_->value("database/name", "engine.db").toString();
+    dbSettings.flushIntervalMs = settings_->value("database/flush_interval_ms", dbSettings.flushIntervalMs).toInt();
+    dbSettings.syncCommit = settings_->value("database/durability", "async").toString() == "sync";
+    dbSettings.groupCommitMaxBatch = settings_->value("database/group_commit_max_batch", dbSettings.groupCommitMaxBatch).toInt();
+    dbSettings.journalMode = settings_->value("database/journal_mode", dbSettings.journalMode).toString();
+    dbSettings.synchronous = settings_->value("database/synchronous", dbSettings.synchronous).toString();
+    dbSettings.cacheSizeKb = settings_->value("database/cache_size_kb", dbSettings.cacheSizeKb).toLongLong();
+    dbSettings.mmapSizeBytes = settings_->value("database/mmap_size_bytes", dbSettings.mmapSizeBytes).toLongLong();
+    backupFile_.setFileName(settings_->value("snapshot/file", backupFileName).toString());
+    if (settings_->value("snapshot/enabled", true).toBool()) {
+        dbSettings.snapshotFile = backupFile_.fileName();
+        dbSettings.journalFile = settings_->value("snapshot/journal_file", journalFileName).toString();
+        dbSettings.snapshotIntervalSec = settings_->value("snapshot/interval_sec", dbSettings.snapshotIntervalSec).toInt();
+    }
+    if (!DBManager::instance().init(dbSettings)) {
         return false;
     }
+    load(dbSettings);
+    events_.setLimits(settings_->value("events/journal_max_events", 100000).toULongLong(),
+                      settings_->value("events/journal_max_bytes", 64 * 1024 * 1024).toLongLong());
+    maxRequestSize_ = settings_->value("security/request_max_size_bytes", 0).toLongLong();
+    requestsCount_ = settings_->value("security/requests_count", 0).toLongLong();
+    requestCheckingInterval_ = settings_->value("security/requests_checking_interval_ms", 0).toLongLong();
+    rateLimiter_.configure(requestsCount_, requestCheckingInterval_);
+    settings_->beginGroup("security/command_cost");
+    QStringList costCommands = settings_->childKeys();
+    for (int i = 0; i < costCommands.size(); ++i) {
+        rateLimiter_.setCost(costCommands[i], settings_->value(costCommands[i]).toDouble());
+    }
+    settings_->endGroup();
+    for (int command = 0; command < Commands::Count; ++command) {
+        commandCosts_[command] = rateLimiter_.cost(Commands::name(Commands::Command(command)));
+    }
+    blackListTtl_ = settings_->value("security/black_list_ttl_sec", 0).toLongLong();
+    blackListTimer_.start(60 * 1000);
+    outputLimits_.highWaterMark = settings_->value("output/high_water_mark_bytes", outputLimits_.highWaterMark).toLongLong();
+    QString policy = settings_->value("output/policy", "coalesce").toString();
+    if (!OutputLimits::parsePolicy(policy, outputLimits_.policy)) {
+        Logger::warning() << "Unknown output policy " + policy + ", using coalesce";
+        outputLimits_.policy = OutputLimits::Coalesce;
+    }
+    outputLimits_.chunkSize = std::max(1024, settings_->value("output/chunk_bytes", outputLimits_.chunkSize).toInt());
+    presenceTimer_.setInterval(settings_->value("presence/coalesce_ms", 50).toInt());
+    for (const QString& code : settings_->value("orders/currencies").toStringList()) {
+        if (CurrencyCode::fromString(code.trimmed()).isValid()) {
+            currencies_.insert(code.trimmed());
+        } else {
+            Logger::warning() << "Invalid currency " + code + " in orders/currencies";
+        }
+    }
+    int queuesReportSec = settings_->value("output/report_interval_sec", 60).toInt();
+    if (queuesReportSec > 0 && outputLimits_.highWaterMark > 0) {
+        queuesTimer_.start(queuesReportSec * 1000);
+    }
+    int workerThreads = settings_->value("server/worker_threads", 0).toInt();
+    startWorkers(workerThreads);
+    startMetrics();
     if (server_->listen(QHostAddress::Any, port)) {
-        maxRequestSize_ = settings_->value("security/request_max_size_bytes", 0).toLongLong();
-        requestsCount_ = settings_->value("security/requests_count", 0).toLongLong();
         Logger::info() << "Atom engine was started success, port = " + QString::number(port) + " version = " + curVersion;
+        Logger::info() << "Connection worker threads = " + QString::number(workerThreads);
         Logger::info() << "Max request size in bytes = " + QString::number(maxRequestSize_);
+        Logger::info() << "Output queue high-water mark in bytes = " + QString::number(outputLimits_.highWaterMark) + ", policy = " + policy;
+        Logger::info() << "Streamed reply chunk size in bytes = " + QString::number(outputLimits_.chunkSize);
         Logger::info() << "Requests checking interval in ms = " + QString::number(requestCheckingInterval_);
         Logger::info() << "Request count from client at checking interval = " + QString::number(requestsCount_);
         return true;
@@ -74,449 +186,902 @@ bool AtomEngineServer::run()
     }
 }
 
-void AtomEngineServer::onNewConnection()
+void AtomEngineServer::startMetrics()
 {
-    QTcpSocket* clientSocket = server_->nextPendingConnection();
-    QString clientIp = clientSocket->peerAddress().toString();
-
-    if (blackList_.find(clientIp) != blackList_.end()) {
-        Logger::info() << "Attempt of connection from IP in black list. IP = " + clientIp;
-        clientSocket->close();
+    int metricsPort = settings_->value("metrics/port", 0).toInt();
+    if (metricsPort <= 0) {
         return;
     }
-
-    connect(clientSocket, SIGNAL(disconnected()), this, SLOT(onClientDisconnected()));
-    int socketId = clientSocket->socketDescriptor();
-    connections_[socketId] = clientSocket;
-    connect(clientSocket, SIGNAL(readyRead()), this, SLOT(onReadyRead()));
-    Logger::info() << "New connection id = " + QString::number(socketId) + ", active connections = " + QString::number(connections_.size());
+    metricsServer_ = new MetricsServer();
+    connect(metricsServer_, SIGNAL(collecting()), this, SLOT(onCollectMetrics()));
+    // the metrics are for the local monitoring agent only
+    if (metricsServer_->listen(QHostAddress::LocalHost, metricsPort)) {
+        Logger::info() << "Metrics are served on 127.0.0.1:" + QString::number(metricsPort) + "/metrics";
+    } else {
+        Logger::warning() << "Failed to serve metrics on port " + QString::number(metricsPort) + ": " + metricsServer_->errorString();
+    }
 }
 
-void AtomEngineServer::onClientDisconnected()
+void AtomEngineServer::onCollectMetrics()
 {
-    QTcpSocket* clientSocket = (QTcpSocket*)sender();
-    QString clientIp = clientSocket->peerAddress().toString();
+    OutputQueues queues;
+    for (size_t i = 0; i < workers_.size(); ++i) {
+        workers_[i]->outputQueues(queues);
+    }
+    qint64 totalBytes = 0;
+    for (size_t i = 0; i < queues.size(); ++i) {
+        totalBytes += queues[i].bytes;
+    }
+    outputQueueBytesGauge_->set(totalBytes);
+    connectionsGauge_->set(connections_.size());
+    binaryConnectionsGauge_->set(binaryConnections_);
+    dbQueueDepthGauge_->set(DBManager::instance().queueDepth());
+    blackListSizeGauge_->set(blackList_.size());
+    rateLimiterBucketsGauge_->set(rateLimiter_.size());
+    poolBytesGauge_->set(SlabPools::slabBytes());
+    poolUsedBytesGauge_->set(SlabPools::usedBytes());
+}
 
-    Addrs disconnectedAddrs;
+void AtomEngineServer::startWorkers(int threadsCount)
+{
+    int workersCount = threadsCount > 0 ? threadsCount : 1;
+    for (int i = 0; i < workersCount; ++i) {
+        ConnectionWorker* worker = new ConnectionWorker(maxRequestSize_, outputLimits_);
+        if (threadsCount > 0) {
+            QThread* thread = new QThread();
+            thread->setObjectName("connection worker " + QString::number(i));
+            worker->moveToThread(thread);
+            thread->start();
+            workerThreads_.push_back(thread);
+        }
+        connect(worker, SIGNAL(connectionOpened(qintptr, QString)), this, SLOT(onConnectionOpened(qintptr, QString)));
+        connect(worker, SIGNAL(connectionClosed(qintptr, QString)), this, SLOT(onConnectionClosed(qintptr, QString)));
+        connect(worker, SIGNAL(requestsReceived(qintptr, QString, Requests)), this, SLOT(onRequestsReceived(qintptr, QString, Requests)));
+        connect(worker, SIGNAL(requestTooLarge(qintptr, QString)), this, SLOT(onRequestTooLarge(qintptr, QString)));
+        workers_.push_back(worker);
+    }
+}
 
-    auto itConnection = connections_.begin();
-    while (itConnection != connections_.end()) {
-        if (itConnection->second == clientSocket) {
-            auto itAddr = addrs_.begin();
-            while (itAddr != addrs_.end()) {
-                if (itAddr->second == itConnection->first) {
-                    disconnectedAddrs.insert(itAddr->first);
-                    itAddr = addrs_.erase(itAddr);
-                } else {
-                    ++itAddr;
-                }
-            }
-            auto itBuf = buffers_.find(itConnection->first);
-            if (itBuf != buffers_.end()) {
-                buffers_.erase(itBuf);
-            }
-            itConnection = connections_.erase(itConnection);
+void AtomEngineServer::stopWorkers()
+{
+    for (size_t i = 0; i < workers_.size(); ++i) {
+        ConnectionWorker* worker = workers_[i];
+        disconnect(worker, nullptr, this, nullptr);
+        if (worker->thread() == QThread::currentThread()) {
+            worker->closeAll();
         } else {
-            ++itConnection;
+            QMetaObject::invokeMethod(worker, "closeAll", Qt::BlockingQueuedConnection);
+        }
+    }
+    for (size_t i = 0; i < workerThreads_.size(); ++i) {
+        workerThreads_[i]->quit();
+        workerThreads_[i]->wait();
+        delete workerThreads_[i];
+    }
+    workerThreads_.clear();
+    for (size_t i = 0; i < workers_.size(); ++i) {
+        delete workers_[i];
+    }
+    workers_.clear();
+    connections_.clear();
+}
+
+void AtomEngineServer::onExpireBlackList()
+{
+    std::vector<QString> expired;
+    blackList_.removeExpired(QDateTime::currentMSecsSinceEpoch() / 1000, expired);
+    for (size_t i = 0; i < expired.size(); ++i) {
+        DBManager::instance().removeFromBlackList(expired[i]);
+    }
+    if (!expired.empty()) {
+        Logger::info() << "Black list entries expired = " + QString::number(expired.size()) + ", left = " + QString::number(blackList_.size())
+                          + ", connections rejected at accept = " + QString::number(server_->rejectedCount());
+    }
+}
+
+void AtomEngineServer::onReportQueues()
+{
+    OutputQueues queues;
+    for (size_t i = 0; i < workers_.size(); ++i) {
+        workers_[i]->outputQueues(queues);
+    }
+    qint64 totalBytes = 0;
+    for (size_t i = 0; i < queues.size(); ++i) {
+        const OutputQueue& queue = queues[i];
+        totalBytes += queue.bytes;
+        if (queue.bytes > outputLimits_.highWaterMark / 4) {
+            Logger::info() << "Output queue of client descr = " + QString::number(queue.connectionId) + " ip = " + queue.ip
+                              + ": " + QString::number(queue.bytes) + " bytes, peak " + QString::number(queue.peakBytes)
+                              + " bytes, dropped " + QString::number(queue.droppedMessages) + " messages";
         }
     }
+    Logger::info() << "Output queues: " + QString::number(queues.size()) + " connections, " + QString::number(totalBytes) + " bytes";
+}
+
+void AtomEngineServer::send(qintptr descr, const QByteArray& data, const QByteArray& binary)
+{
+    auto it = connections_.find(descr);
+    if (it != connections_.end()) {
+        it->second.worker->send(descr, data, binary);
+    }
+}
+
+void AtomEngineServer::sendStream(qintptr descr, const ReplyStreamPtr& stream)
+{
+    auto it = connections_.find(descr);
+    if (it != connections_.end()) {
+        it->second.worker->send(descr, stream);
+    }
+}
 
-    sendDisconnectedAddrs(disconnectedAddrs);
+bool AtomEngineServer::isBinary(qintptr descr) const
+{
+    auto it = connections_.find(descr);
+    return it != connections_.end() && it->second.binary;
+}
 
-    auto it1 = checkingTime_.find(clientIp);
-    if (it1 != checkingTime_.end()) {
-        checkingTime_.erase(it1);
+void AtomEngineServer::broadcast(const std::vector<qintptr>& descrs, const QByteArray& data, const QByteArray& binary)
+{
+    // data is encoded once and shared by all recipients, every worker gets
+    // a single batch with its own connections
+    broadcastRecipients_->record(descrs.size());
+    std::map<ConnectionWorker*, QVector<qintptr>> batches;
+    for (size_t i = 0; i < descrs.size(); ++i) {
+        auto it = connections_.find(descrs[i]);
+        if (it != connections_.end()) {
+            batches[it->second.worker].append(descrs[i]);
+        }
     }
+    for (auto it = batches.begin(); it != batches.end(); ++it) {
+        it->first->send(it->second, data, binary);
+    }
+}
 
-    auto it2 = checkingCount_.find(clientIp);
-    if (it2 != checkingCount_.end()) {
-        checkingCount_.erase(it2);
+void AtomEngineServer::closeConnection(qintptr descr)
+{
+    auto it = connections_.find(descr);
+    if (it != connections_.end()) {
+        it->second.worker->close(descr);
+    }
+}
+
+void AtomEngineServer::addToBlackList(qintptr descr, const QString& clientIp)
+{
+    long long expiresAt = blackListTtl_ > 0 ? QDateTime::currentMSecsSinceEpoch() / 1000 + blackListTtl_ : 0;
+    if (blackList_.add(clientIp, expiresAt)) {
+        DBManager::instance().addToBlackList(clientIp, expiresAt);
+    }
+    closeConnection(descr);
+}
+
+void AtomEngineServer::onSocketAccepted(qintptr socketDescriptor)
+{
+    ConnectionWorker* worker = workers_[nextWorker_];
+    nextWorker_ = (nextWorker_ + 1) % workers_.size();
+    ++curConnectionId_;
+    if (worker->thread() == QThread::currentThread()) {
+        worker->addConnection(curConnectionId_, socketDescriptor);
+    } else {
+        QMetaObject::invokeMethod(worker, "addConnection", Qt::QueuedConnection, Q_ARG(qintptr, curConnectionId_), Q_ARG(qintptr, socketDescriptor));
+    }
+}
+
+void AtomEngineServer::onConnectionOpened(qintptr descr, const QString& clientIp)
+{
+    ConnectionWorker* worker = (ConnectionWorker*)sender();
+
+    IpKey ipKey = IpKey::fromString(clientIp);
+    if (blackList_.contains(ipKey)) {
+        openBlackListHits_->add();
+        Logger::info() << "Attempt of connection from IP in black list. IP = " + clientIp;
+        worker->close(descr);
+        return;
+    }
+
+    Connection& connection = connections_[descr];
+    connection.worker = worker;
+    connection.ip = clientIp;
+    connection.ipKey = ipKey;
+    connection.binary = false;
+    subscriptions_.addConnection(descr);
+    Logger::info() << "New connection id = " + QString::number(descr) + ", active connections = " + QString::number(connections_.size());
+}
+
+void AtomEngineServer::onConnectionClosed(qintptr descr, const QString& clientIp)
+{
+    auto itConnection = connections_.find(descr);
+    if (itConnection == connections_.end()) {
+        return;
+    }
+    if (itConnection->second.binary) {
+        --binaryConnections_;
+    }
+    connections_.erase(itConnection);
+    subscriptions_.removeConnection(descr);
+
+    Addrs disconnectedAddrs;
+    auto itAddrs = connectionAddrs_.find(descr);
+    if (itAddrs != connectionAddrs_.end()) {
+        disconnectedAddrs.swap(itAddrs->second);
+        connectionAddrs_.erase(itAddrs);
+        for (auto it = disconnectedAddrs.begin(); it != disconnectedAddrs.end(); ++it) {
+            addrs_.erase(*it);
+            changePresence(*it, false);
+        }
     }
 
     Logger::info() << "Client disconnected, active connections = " + QString::number(connections_.size());
 }
 
-void AtomEngineServer::sendDisconnectedAddrs(const Addrs& addrs)
+void AtomEngineServer::onRequestTooLarge(qintptr descr, const QString& clientIp)
 {
-    QString rep = "{\"reply\":\"user_disconnected\", \"addrs\": [";
+    Logger::info() << "Request too match size from ip = " + clientIp;
+    addToBlackList(descr, clientIp);
+}
+
+void AtomEngineServer::changePresence(const QString& addr, bool connected)
+{
+    auto it = presenceChanges_.find(addr);
+    if (it != presenceChanges_.end() && it->second != connected) {
+        // connected and disconnected again within the window, the clients saw neither
+        presenceChanges_.erase(it);
+    } else {
+        presenceChanges_[addr] = connected;
+    }
+    if (!presenceTimer_.isActive()) {
+        presenceTimer_.start();
+    }
+}
+
+QByteArray AtomEngineServer::presenceJson(const char* reply, long long seq, const Addrs& addrs)
+{
+    QByteArray rep = "{\"reply\":\"" + QByteArray(reply) + "\", \"seq\": " + QByteArray::number(seq) + ", \"addrs\": [";
     for (auto it = addrs.begin(); it != addrs.end(); ++it) {
         if (it != addrs.begin()) {
             rep +=  ", ";
         }
-        rep += "\"" + *it + "\"";
+        rep += "\"" + it->toUtf8() + "\"";
     }
     rep += "]}\n";
-    for (auto it = connections_.begin(); it != connections_.end(); ++it) {
-        it->second->write(rep.toStdString().c_str());
+    return rep;
+}
+
+QByteArray AtomEngineServer::presenceBinary(BinaryProtocol::MessageType type, long long seq, const Addrs& addrs)
+{
+    if (binaryConnections_ == 0) {
+        return QByteArray();
     }
+    BinaryProtocol::Writer writer(type);
+    for (auto it = addrs.begin(); it != addrs.end(); ++it) {
+        writer.addString(BinaryProtocol::Addrs, *it);
+    }
+    writer.addInt(BinaryProtocol::Seq, seq);
+    return writer.finish();
 }
 
-void AtomEngineServer::sendConnectedAddrs(qintptr curDescr)
+void AtomEngineServer::onFlushPresence()
 {
-    QString rep = "{\"reply\":\"user_connected\", \"addrs\": [";
-    for (auto it = addrs_.begin(); it != addrs_.end(); ++it) {
-        if (it != addrs_.begin()) {
-            rep +=  ", ";
+    Addrs connected;
+    Addrs disconnected;
+    for (auto it = presenceChanges_.begin(); it != presenceChanges_.end(); ++it) {
+        if (it->second) {
+            connected.insert(connected.end(), it->first);
+        } else {
+            disconnected.insert(disconnected.end(), it->first);
         }
-        rep += "\"" + it->first + "\"";
     }
-    rep += "]}\n";
+    presenceChanges_.clear();
+
+    // a connection is not told about the addresses it connected itself
+    std::map<qintptr, Addrs> ownAddrs;
+    for (const QString& addr : connected) {
+        auto itAddr = addrs_.find(addr);
+        if (itAddr != addrs_.end()) {
+            ownAddrs[itAddr->second].insert(addr);
+        }
+    }
+
+    long long connectedSeq = 0;
+    QByteArray connectedData;
+    QByteArray connectedBinary;
+    if (!connected.empty()) {
+        connectedSeq = events_.nextSeq();
+        connectedData = presenceJson("user_connected", connectedSeq, connected);
+        events_.append(connectedSeq, connectedData);
+        connectedBinary = presenceBinary(BinaryProtocol::UsersConnected, connectedSeq, connected);
+    }
+    QByteArray disconnectedData;
+    QByteArray disconnectedBinary;
+    if (!disconnected.empty()) {
+        long long seq = events_.nextSeq();
+        disconnectedData = presenceJson("user_disconnected", seq, disconnected);
+        events_.append(seq, disconnectedData);
+        disconnectedBinary = presenceBinary(BinaryProtocol::UsersDisconnected, seq, disconnected);
+    }
+    if (connectedData.isEmpty() && disconnectedData.isEmpty()) {
+        return;
+    }
+
+    // both replies go out in one write per connection
+    std::vector<qintptr> recipients;
+    recipients.reserve(connections_.size());
     for (auto it = connections_.begin(); it != connections_.end(); ++it) {
-        if (it->first != curDescr) {
-            it->second->write(rep.toStdString().c_str());
+        if (ownAddrs.find(it->first) == ownAddrs.end()) {
+            recipients.push_back(it->first);
+        }
+    }
+    broadcast(recipients, connectedData + disconnectedData, connectedBinary + disconnectedBinary);
+
+    for (auto itOwn = ownAddrs.begin(); itOwn != ownAddrs.end(); ++itOwn) {
+        Addrs others;
+        std::set_difference(connected.begin(), connected.end(), itOwn->second.begin(), itOwn->second.end(), std::inserter(others, others.end()));
+        QByteArray data;
+        QByteArray binary;
+        if (!others.empty()) {
+            // the same event as the others get, without the connection's own addresses
+            data = presenceJson("user_connected", connectedSeq, others);
+            binary = presenceBinary(BinaryProtocol::UsersConnected, connectedSeq, others);
+        }
+        data += disconnectedData;
+        binary += disconnectedBinary;
+        if (!data.isEmpty()) {
+            send(itOwn->first, data, binary);
         }
     }
 }
 
-void AtomEngineServer::onReadyRead()
+void AtomEngineServer::onRequestsReceived(qintptr descr, const QString& clientIp, const Requests& requests)
 {
-    QTcpSocket* clientSocket = (QTcpSocket*)sender();
-    QString clientIp = clientSocket->peerAddress().toString();
-    if (blackList_.find(clientIp) != blackList_.end()) {
+    auto itConnection = connections_.find(descr);
+    if (itConnection == connections_.end()) {
+        return;
+    }
+    if (blackList_.contains(itConnection->second.ipKey)) {
+        requestBlackListHits_->add();
         return;
     }
 
-    QByteArray& buffer = buffers_[clientSocket->socketDescriptor()];
+    if (rateLimiter_.isEnabled()) {
+        double cost = 0;
+        for (int i = 0; i < requests.size(); ++i) {
+            cost += commandCosts_[requests[i].command];
+        }
+        if (!rateLimiter_.consume(itConnection->second.ipKey, cost)) {
+            rateLimited_->add();
+            Logger::info() << "Requests too match count from ip = " + clientIp;
+            addToBlackList(descr, clientIp);
+            return;
+        }
+    }
 
-    QByteArray answer = clientSocket->readAll();
-    buffer.append(answer);
+    for (int i = 0; i < requests.size(); ++i) {
+        const CommandMetrics& commandMetrics = commandsMetrics_[requests[i].command];
+        commandMetrics.requests->add();
+        MetricsTimer timer(commandMetrics.duration);
+        handleRequest(descr, requests[i]);
+    }
+}
 
-    if (buffer.size() > maxRequestSize_) {
-        Logger::info() << "Request too match size from ip = " + clientIp;
-        auto it = buffers_.find(clientSocket->socketDescriptor());
-        if (it != buffers_.end()) {
-            buffers_.erase(it);
+void AtomEngineServer::sendInitState(qintptr descr, const Addrs& activeAddrs, bool binary)
+{
+    // the worker encodes the reply as the socket drains, here only the shared parts are collected
+    ReplyStreamPtr stream = std::make_shared<ReplyStream>();
+    stream->append("{\"reply\": \"init_success\", \"isActual\": true, \"epoch\": " + QByteArray::number(events_.epoch())
+            + ", \"seq\": " + QByteArray::number(events_.lastSeq()) + ", \"orders\": [");
+    const Orders& orders = orders_.orders();
+    for (auto it = orders.begin(); it != orders.end(); ++it) {
+        stream->append(it->second->getJson(), it != orders.begin());
+    }
+    stream->append("], \"trades\": [");
+    // ordered by id like trades_
+    std::set<long long> tradeIds;
+    for (auto it = activeAddrs.begin(); it != activeAddrs.end(); ++it) {
+        auto itTrades = addrTrades_.find(*it);
+        if (itTrades != addrTrades_.end()) {
+            tradeIds.insert(itTrades->second.begin(), itTrades->second.end());
         }
-        blackList_.insert(clientIp);
-        DBManager::instance().addToBlackList(clientIp);
-        clientSocket->close();
-        return;
     }
+    bool firstTrade = true;
+    for (auto it = tradeIds.begin(); it != tradeIds.end(); ++it) {
+        auto itTrade = trades_.find(*it);
+        if (itTrade != trades_.end()) {
+            stream->append(itTrade->second->getJson(), !firstTrade);
+            firstTrade = false;
+        }
+    }
+    stream->append("], \"commissions\": [], \"active_addrs\": [");
+    for (auto it = addrs_.begin(); it != addrs_.end(); ++it) {
+        stream->appendString(it->first, it != addrs_.begin());
+    }
+    stream->append(binary ? "], \"protocol\": \"binary\"}\n" : "]}\n");
+    sendStream(descr, stream);
+}
 
-    int pos = buffer.lastIndexOf("\n");
-    if (pos < 0) {
+bool AtomEngineServer::sendEventsSince(qintptr descr, long long lastSeq, const Addrs& activeAddrs, bool binary)
+{
+    EventJournal::Events events;
+    if (!events_.since(lastSeq, events)) {
+        return false;
+    }
+    ReplyStreamPtr stream = std::make_shared<ReplyStream>();
+    stream->append("{\"reply\": \"init_success\", \"isActual\": true, \"epoch\": " + QByteArray::number(events_.epoch())
+            + ", \"seq\": " + QByteArray::number(events_.lastSeq()) + ", \"events\": [");
+    bool firstEvent = true;
+    for (size_t i = 0; i < events.size(); ++i) {
+        const EventJournal::Event* event = events[i];
+        if (event->isPrivate && activeAddrs.find(event->firstAddr) == activeAddrs.end()
+                && activeAddrs.find(event->secondAddr) == activeAddrs.end()) {
+            continue;
+        }
+        stream->appendLine(event->json, !firstEvent);
+        firstEvent = false;
+    }
+    stream->append(binary ? "], \"commissions\": [], \"protocol\": \"binary\"}\n" : "], \"commissions\": []}\n");
+    sendStream(descr, stream);
+    return true;
+}
+
+void AtomEngineServer::handleRequest(qintptr descr, const Request& request)
+{
+    using Handler = void (AtomEngineServer::*)(qintptr descr, const Request& req);
+    // in the order of Commands::Command, unknown commands are ignored
+    static const Handler handlers[Commands::Count] = {
+        nullptr,
+        &AtomEngineServer::handleInit,
+        &AtomEngineServer::handleRequestSwapCommission,
+        &AtomEngineServer::handleCreateOrder,
+        &AtomEngineServer::handleDeleteOrder,
+        &AtomEngineServer::handleGetOrders,
+        &AtomEngineServer::handleSubscribe,
+        &AtomEngineServer::handleUnsubscribe,
+        &AtomEngineServer::handleCreateTrade,
+        &AtomEngineServer::handleUpdateTrade
+    };
+    Handler handler = handlers[request.command];
+    if (handler) {
+        (this->*handler)(descr, request);
+    }
+}
+
+void AtomEngineServer::handleInit(qintptr descr, const Request& req)
+{
+    Addrs activeAddrs;
+    for (const QString& addr : req.addrs) {
+        bindAddr(addr, descr);
+        activeAddrs.insert(addr);
+    }
+    bool binary = req.binaryProtocol;
+    // a client which was connected before sends the epoch and the last seq it saw
+    bool resynced = req.hasLastSeq && req.epoch == events_.epoch() && sendEventsSince(descr, req.lastSeq, activeAddrs, binary);
+    if (!resynced) {
+        sendInitState(descr, activeAddrs, binary);
+    }
+    auto itConnection = connections_.find(descr);
+    if (binary && itConnection != connections_.end() && !itConnection->second.binary) {
+        // the init reply is the last JSON line the client gets
+        itConnection->second.binary = true;
+        ++binaryConnections_;
+        itConnection->second.worker->switchToBinary(descr);
+    }
+}
+
+void AtomEngineServer::handleRequestSwapCommission(qintptr descr, const Request& req)
+{
+    for (const QString& addr : req.addrs) {
+        bindAddr(addr, descr);
+    }
+    QByteArray rep = "{\"reply\": \"request_swap_commission_success\", \"commissions\": []}\n";
+    send(descr, rep);
+}
+
+void AtomEngineServer::handleCreateOrder(qintptr descr, const Request& req)
+{
+    if (!req.order || !req.order->hasPrice()) {
+        // it would break the ordering of the book
+        send(descr, "{\"reply\": \"create_order_failed\", \"reason\": \"invalid count\"}\n");
+        return;
+    }
+    if (!acceptCurrency(req.orderSendCur) || !acceptCurrency(req.orderGetCur)) {
+        send(descr, "{\"reply\": \"create_order_failed\", \"reason\": \"invalid currency\"}\n");
         return;
     }
+    // only codes of accepted orders get into the table of codes, which is never cleared
+    req.order->sendCur_ = CurrencyCode::fromString(req.orderSendCur);
+    req.order->getCur_ = CurrencyCode::fromString(req.orderGetCur);
+    if (!req.order->hasValidCurrencies()) {
+        send(descr, "{\"reply\": \"create_order_failed\", \"reason\": \"invalid currency\"}\n");
+        return;
+    }
+    // the request owns its order
+    OrderInfoPtr newOrder = createOrder(req.key, req.order);
+    if (newOrder) {
+        DBManager::instance().addToOrders(newOrder);
+        // the creator gets the seq of the event it caused, so it does not get the order again on resync
+        long long seq = events_.nextSeq();
+        QByteArray seqJson = ", \"seq\": " + QByteArray::number(seq);
+        QByteArray rep1 = "{\"reply\": \"create_order_success\"" + seqJson + ", \"order\": " + newOrder->getJson() + "}\n";
+        QByteArray rep2 = "{\"reply\": \"create_order\"" + seqJson + ", \"order\": " + newOrder->getJson() + "}\n";
+        events_.append(seq, rep2);
+        send(descr, rep1, isBinary(descr) ? BinaryProtocol::encodeOrder(BinaryProtocol::CreateOrderSuccess, *newOrder, seq) : QByteArray());
+        std::vector<qintptr> subscribers;
+        subscriptions_.getSubscribers(CurrencyPair(newOrder->sendCur_.toString(), newOrder->getCur_.toString()), subscribers);
+        subscribers.erase(std::remove(subscribers.begin(), subscribers.end(), descr), subscribers.end());
+        broadcast(subscribers, rep2, binaryConnections_ > 0 ? BinaryProtocol::encodeOrder(BinaryProtocol::OrderCreated, *newOrder, seq) : QByteArray());
+        bindAddr(newOrder->getAddress_, descr);
+    }
+}
 
-    auto it1 = checkingTime_.find(clientIp);
-    if (it1 != checkingTime_.end()) {
-        long long curRequestsCount = checkingCount_[clientIp];
-        ++curRequestsCount;
-        if (QDateTime::currentDateTime().toTime_t() - it1->second < requestCheckingInterval_) {
-            if (curRequestsCount > requestsCount_) {
-                auto it2 = checkingCount_.find(clientIp);
-                if (it2 != checkingCount_.end()) {
-                    checkingCount_.erase(it2);
-                }
-                checkingTime_.erase(it1);
-                Logger::info() << "Requests too match count from ip = " + clientIp;
-                auto it = buffers_.find(clientSocket->socketDescriptor());
-                if (it != buffers_.end()) {
-                    buffers_.erase(it);
-                }
-                blackList_.insert(clientIp);
-                DBManager::instance().addToBlackList(clientIp);
-                clientSocket->close();
-                return;
-            } else {
-                checkingCount_[clientIp] = curRequestsCount;
-            }
-        } else {
-            auto it2 = checkingCount_.find(clientIp);
-            if (it2 != checkingCount_.end()) {
-                checkingCount_.erase(it2);
-            }
-            checkingTime_.erase(it1);
+bool AtomEngineServer::acceptCurrency(const QString& code) const
+{
+    return code.isEmpty() || currencies_.empty() || currencies_.count(code) > 0;
+}
+
+void AtomEngineServer::handleDeleteOrder(qintptr descr, const Request& req)
+{
+    long long id = req.id;
+    OrderInfoPtr deleted = deleteOrder(req.key, id);
+    long long seq = 0;
+    QByteArray seqJson;
+    QByteArray rep2;
+    if (deleted) {
+        seq = events_.nextSeq();
+        seqJson = ", \"seq\": " + QByteArray::number(seq);
+        rep2 = "{\"reply\": \"delete_order\"" + seqJson + ", \"id\": " + QByteArray::number(id) + "}\n";
+        events_.append(seq, rep2);
+    }
+    QByteArray rep1 = "{\"reply\": \"delete_order_success\"" + seqJson + ", \"id\": " + QByteArray::number(id) + "}\n";
+    send(descr, rep1, isBinary(descr) ? BinaryProtocol::encodeId(BinaryProtocol::DeleteOrderSuccess, id, seq) : QByteArray());
+    if (deleted) {
+        DBManager::instance().deleteFromOrders(id);
+        std::vector<qintptr> subscribers;
+        subscriptions_.getSubscribers(CurrencyPair(deleted->sendCur_.toString(), deleted->getCur_.toString()), subscribers);
+        subscribers.erase(std::remove(subscribers.begin(), subscribers.end(), descr), subscribers.end());
+        broadcast(subscribers, rep2, binaryConnections_ > 0 ? BinaryProtocol::encodeId(BinaryProtocol::OrderDeleted, id, seq) : QByteArray());
+    }
+}
+
+void AtomEngineServer::handleGetOrders(qintptr descr, const Request& req)
+{
+    CurrencyPair pair(req.sendCur, req.getCur);
+    long long limit = req.limit;
+    std::vector<OrderInfoPtr> orders;
+    orders_.getOrders(pair, limit > 0 ? limit : 0, orders);
+    QByteArray rep = "{\"reply\": \"get_orders_success\", \"sendCur\": \"" + pair.first.toUtf8() + "\", \"getCur\": \"" + pair.second.toUtf8() + "\", \"orders\": [";
+    for (size_t i = 0; i < orders.size(); ++i) {
+        if (i != 0) {
+            rep += ", ";
         }
-    } else {
-        checkingTime_[clientIp] = QDateTime::currentDateTime().toTime_t();
-        checkingCount_[clientIp] = 1;
+        rep += orders[i]->getJson();
     }
+    rep += "]}\n";
+    send(descr, rep);
+}
 
-    QByteArrayList commands = buffer.left(pos).split('\n');
-    int rightCount = buffer.length() - pos - 1;
-    if (rightCount > 0) {
-        buffer = buffer.right(rightCount);
+void AtomEngineServer::handleSubscribe(qintptr descr, const Request& req)
+{
+    changeSubscription(descr, req, true);
+}
+
+void AtomEngineServer::handleUnsubscribe(qintptr descr, const Request& req)
+{
+    changeSubscription(descr, req, false);
+}
+
+void AtomEngineServer::changeSubscription(qintptr descr, const Request& req, bool subscribe)
+{
+    CurrencyPair pair(req.sendCur, req.getCur);
+    if (subscribe) {
+        subscriptions_.subscribe(descr, pair);
     } else {
-        buffer.clear();
+        subscriptions_.unsubscribe(descr, pair);
     }
+    QByteArray rep = QByteArray("{\"reply\": \"") + (subscribe ? "subscribe" : "unsubscribe") + "_success\", \"sendCur\": \"" + pair.first.toUtf8() + "\", \"getCur\": \"" + pair.second.toUtf8() + "\"}\n";
+    send(descr, rep);
+}
 
-    for (int i = 0; i < commands.size(); ++i) {
-        QByteArray& commandStr = commands[i];
-        if (commandStr.length() == 0) {
-            continue;
-        }
-        QJsonDocument doc = QJsonDocument::fromJson(commandStr);
-        commandStr.append("\n");
-        Logger::info() << QString("client descr = ") + QString::number(clientSocket->socketDescriptor()) + QString(" ") + commandStr;
-        if (doc.isObject()) {
-            QJsonObject req = doc.object();
-            QString command = req["command"].toString();
-            if (command == "init") {
-                Addrs activeAddrs;
-                QJsonArray curs = req["curs"].toArray();
-                for (int i = 0; i < curs.size(); ++i) {
-                    QJsonObject curInfo = curs[i].toObject();
-                    QJsonArray addrs = curInfo["addrs"].toArray();
-                    for (int i = 0; i < addrs.size(); ++i) {
-                        QString addr = addrs[i].toString();
-                        addrs_[addr] = clientSocket->socketDescriptor();
-                        activeAddrs.insert(addr);
-                    }
-                }
-                QString rep = "{\"reply\": \"init_success\", \"isActual\": true, \"orders\": [";
-                for (auto it = orders_.begin(); it != orders_.end(); ++it) {
-                    if (it != orders_.begin()) {
-                        rep += ", ";
-                    }
-                    rep += it->second->getJson();
-                }
-                rep += "], \"trades\": [";
-                bool firstTrade = true;
-                for (auto it = trades_.begin(); it != trades_.end(); ++it) {
-                    const QString& addr1 = it->second->order_->getAddress_;
-                    const QString& addr2 = it->second->initiatorAddress_;
-                    if (activeAddrs.find(addr1) != activeAddrs.end() || activeAddrs.find(addr2) != activeAddrs.end()) {
-                        if (!firstTrade) {
-                            rep +=  ", ";
-                        }
-                        rep += it->second->getJson();
-                        firstTrade = false;
-                    }
-                }
-                rep += "], \"commissions\": [], \"active_addrs\": [";
-                for (auto it = addrs_.begin(); it != addrs_.end(); ++it) {
-                    if (it != addrs_.begin()) {
-                        rep +=  ", ";
-                    }
-                    rep += "\"" + it->first + "\"";
-                }
-                rep += "]}\n";
-                clientSocket->write(rep.toStdString().c_str());
+void AtomEngineServer::handleCreateTrade(qintptr descr, const Request& req)
+{
+    long long orderId = req.orderId;
+    const QString& initiatorAddr = req.address;
+    bindAddr(initiatorAddr, descr);
+    TradeInfoPtr trade = createTrade(req.key, orderId, initiatorAddr);
+    if (trade) {
+        DBManager::instance().addToTrades(trade);
 
-                sendConnectedAddrs(clientSocket->socketDescriptor());
-            }
-            if (command == "request_swap_commission") {
-                QJsonArray curs = req["curs"].toArray();
-                for (int i = 0; i < curs.size(); ++i) {
-                    QJsonObject curInfo = curs[i].toObject();
-                    QJsonArray addrs = curInfo["addrs"].toArray();
-                    for (int i = 0; i < addrs.size(); ++i) {
-                        QString addr = addrs[i].toString();
-                        addrs_[addr] = clientSocket->socketDescriptor();
-                    }
-                }
-                QString rep = "{\"reply\": \"request_swap_commission_success\", \"commissions\": []}\n";
-                clientSocket->write(rep.toStdString().c_str());
-            }
-            if (command == "create_order") {
-                QJsonObject orderJson = req["order"].toObject();
-                QString key = "";
-                if (req.contains("key")) {
-                    key = req["key"].toString();
-                }
-                OrderInfoPtr newOrder = createOrder(key, orderJson);
-                if (newOrder) {
-                    DBManager::instance().addToOrders(newOrder);
-                    QString rep1 = "{\"reply\": \"create_order_success\", \"order\": " + newOrder->getJson() + "}\n";
-                    QString rep2 = "{\"reply\": \"create_order\", \"order\": " + newOrder->getJson() + "}\n";
-                    clientSocket->write(rep1.toStdString().c_str());
-                    for (auto it = connections_.begin(); it != connections_.end(); ++it) {
-                        if (it->first != clientSocket->socketDescriptor()) {
-                            it->second->write(rep2.toStdString().c_str());
-                        }
-                    }
-                    bool newAddrForOrder = false;
-                    if (addrs_.find(newOrder->getAddress_) == addrs_.end()) {
-                        newAddrForOrder = true;
-                    }
-                    addrs_[newOrder->getAddress_] = clientSocket->socketDescriptor();
-                    if (newAddrForOrder) {
-                        sendConnectedAddrs(clientSocket->socketDescriptor());
-                    }
-                }
-            }
-            if (command == "delete_order") {
-                long long id = req["id"].toVariant().toLongLong();
-                QString key = "";
-                if (req.contains("key")) {
-                    key = req["key"].toString();
-                }
-                bool deleted = deleteOrder(key, id);
-                QString rep1 = "{\"reply\": \"delete_order_success\", \"id\": " + QString::number(id) + "}\n";
-                clientSocket->write(rep1.toStdString().c_str());
-                if (deleted) {
-                    DBManager::instance().deleteFromOrders(id);
-                    QString rep2 = "{\"reply\": \"delete_order\", \"id\": " + QString::number(id) + "}\n";
-                    for (auto it = connections_.begin(); it != connections_.end(); ++it) {
-                        if (it->first != clientSocket->socketDescriptor()) {
-                            it->second->write(rep2.toStdString().c_str());
-                        }
-                    }
+        long long deleteSeq = events_.nextSeq();
+        QByteArray rep1 = "{\"reply\": \"delete_order\", \"seq\": " + QByteArray::number(deleteSeq) + ", \"id\": " + QByteArray::number(orderId) + "}\n";
+        events_.append(deleteSeq, rep1);
+        long long tradeSeq = events_.nextSeq();
+        QByteArray seqJson = ", \"seq\": " + QByteArray::number(tradeSeq);
+        const QByteArray& tradeJson = trade->getJson();
+        QByteArray rep2 = "{\"reply\": \"create_trade\"" + seqJson + ", \"trade\": " + tradeJson + "}\n";
+        QByteArray rep3 = "{\"reply\": \"create_trade_success\"" + seqJson + ", \"trade\": " + tradeJson + "}\n";
+        events_.appendPrivate(tradeSeq, rep2, trade->order_->getAddress_, trade->initiatorAddress_);
+
+        send(descr, rep3, isBinary(descr) ? BinaryProtocol::encodeTrade(BinaryProtocol::CreateTradeSuccess, *trade, tradeSeq) : QByteArray());
+
+        qintptr firstSocketDescr = descr;
+        qintptr secondSocketDescr = -1;
+        auto it = addrs_.find(trade->order_->getAddress_);
+        if (it != addrs_.end()) {
+            auto itCon = connections_.find(it->second);
+            if (itCon != connections_.end()) {
+                secondSocketDescr = itCon->first;
+                if (secondSocketDescr != firstSocketDescr) {
+                    send(itCon->first, rep2, itCon->second.binary ? BinaryProtocol::encodeTrade(BinaryProtocol::TradeCreated, *trade, tradeSeq) : QByteArray());
                 }
             }
-            if (command == "create_trade") {
-                long long orderId = req["orderId"].toVariant().toLongLong();
-                QString initiatorAddr = req["address"].toString();
-                addrs_[initiatorAddr] = clientSocket->socketDescriptor();
-                QString key = "";
-                if (req.contains("key")) {
-                    key = req["key"].toString();
-                }
-                TradeInfoPtr trade = createTrade(key, orderId, initiatorAddr);
-                if (trade) {
-                    DBManager::instance().addToTrades(trade);
-
-                    QString rep1 = "{\"reply\": \"delete_order\", \"id\": " + QString::number(orderId) + "}\n";
-                    QString rep2 = "{\"reply\": \"create_trade\", \"trade\": " + trade->getJson() + "}\n";
-                    QString rep3 = "{\"reply\": \"create_trade_success\", \"trade\": " + trade->getJson() + "}\n";
-
-                    clientSocket->write(rep3.toStdString().c_str());
-
-                    int firstSocketDescr = clientSocket->socketDescriptor();
-                    int secondSocketDescr = -1;
-                    auto it = addrs_.find(trade->order_->getAddress_);
-                    if (it != addrs_.end()) {
-                        auto itCon = connections_.find(it->second);
-                        if (itCon != connections_.end()) {
-                            secondSocketDescr = itCon->first;
-                            if (secondSocketDescr != firstSocketDescr) {
-                                itCon->second->write(rep2.toStdString().c_str());
-                            }
-                        }
-                    }
-
-                    for (auto it = connections_.begin(); it != connections_.end(); ++it) {
-                        if (it->first != firstSocketDescr && it->first != secondSocketDescr) {
-                            it->second->write(rep1.toStdString().c_str());
-                        }
-                    }
-                } else {
-                    QString rep = "{\"reply\": \"create_trade_failed\", \"reasone\": \"order out of date\"}\n";
-                    clientSocket->write(rep.toStdString().c_str());
-                }
+        }
+
+        std::vector<qintptr> subscribers;
+        subscriptions_.getSubscribers(CurrencyPair(trade->order_->sendCur_.toString(), trade->order_->getCur_.toString()), subscribers);
+        std::vector<qintptr> recipients;
+        recipients.reserve(subscribers.size());
+        for (size_t i = 0; i < subscribers.size(); ++i) {
+            if (subscribers[i] != firstSocketDescr && subscribers[i] != secondSocketDescr) {
+                recipients.push_back(subscribers[i]);
             }
-            if (command == "update_trade") {
-                QJsonObject tradeJson = req["trade"].toObject();
-                QString key = "";
-                if (req.contains("key")) {
-                    key = req["key"].toString();
-                }
-                TradeInfoPtr trade = updateTrade(key, tradeJson);
-                QString rep1 = "{\"reply\": \"update_trade_success\"}\n";
-                clientSocket->write(rep1.toStdString().c_str());
-                if (trade) {
-                    if (trade->isComplited()) {
-                        DBManager::instance().deleteFromTrades(trade->tradeId_);
-                    } else {
-                        DBManager::instance().updateTrade(trade);
-                    }
-                    QString rep2 = "{\"reply\": \"update_trade\", \"trade\": " + trade->getJson() + "}\n";
-                    const QString& firstAddr = trade->order_->getAddress_;
-                    const QString& secondAddr = trade->initiatorAddress_;
-                    auto itFirstDescr = addrs_.find(firstAddr);
-                    auto itSecondDescr = addrs_.find(secondAddr);
-                    int anotherConnectionDescr = -1;
-                    if (itFirstDescr != addrs_.end() && itSecondDescr != addrs_.end() && itFirstDescr->second == clientSocket->socketDescriptor()) {
-                        anotherConnectionDescr = itSecondDescr->second;
-                    } else if (itFirstDescr != addrs_.end() && itSecondDescr != addrs_.end()) {
-                        anotherConnectionDescr = itFirstDescr->second;
-                    }
-                    if (anotherConnectionDescr != -1) {
-                        auto it = connections_.find(anotherConnectionDescr);
-                        if (it != connections_.end()) {
-                            it->second->write(rep2.toStdString().c_str());
-                        }
-                    }
-                    auto tradeIt = trades_.find(trade->tradeId_);
-                    if (tradeIt != trades_.end()) {
-                        trades_.erase(tradeIt);
-                    }
-                }
+        }
+        broadcast(recipients, rep1, binaryConnections_ > 0 ? BinaryProtocol::encodeId(BinaryProtocol::OrderDeleted, orderId, deleteSeq) : QByteArray());
+    } else {
+        QByteArray rep = "{\"reply\": \"create_trade_failed\", \"reasone\": \"order out of date\"}\n";
+        QByteArray binary;
+        if (isBinary(descr)) {
+            BinaryProtocol::Writer writer(BinaryProtocol::CreateTradeFailed);
+            writer.addString(BinaryProtocol::Reason, "order out of date");
+            binary = writer.finish();
+        }
+        send(descr, rep, binary);
+    }
+}
+
+void AtomEngineServer::handleUpdateTrade(qintptr descr, const Request& req)
+{
+    TradeInfoPtr trade = updateTrade(req.key, req.trade);
+    long long seq = trade ? events_.nextSeq() : 0;
+    QByteArray rep1 = trade ? "{\"reply\": \"update_trade_success\", \"seq\": " + QByteArray::number(seq) + "}\n" : "{\"reply\": \"update_trade_success\"}\n";
+    QByteArray rep2;
+    if (trade) {
+        rep2 = "{\"reply\": \"update_trade\", \"seq\": " + QByteArray::number(seq) + ", \"trade\": " + trade->getJson() + "}\n";
+        events_.appendPrivate(seq, rep2, trade->order_->getAddress_, trade->initiatorAddress_);
+    }
+    send(descr, rep1, isBinary(descr) ? BinaryProtocol::encodeEmpty(BinaryProtocol::UpdateTradeSuccess, seq) : QByteArray());
+    if (trade) {
+        if (trade->isComplited()) {
+            DBManager::instance().deleteFromTrades(trade->tradeId_);
+        } else {
+            DBManager::instance().updateTrade(trade);
+        }
+        const QString& firstAddr = trade->order_->getAddress_;
+        const QString& secondAddr = trade->initiatorAddress_;
+        auto itFirstDescr = addrs_.find(firstAddr);
+        auto itSecondDescr = addrs_.find(secondAddr);
+        int anotherConnectionDescr = -1;
+        if (itFirstDescr != addrs_.end() && itSecondDescr != addrs_.end() && itFirstDescr->second == descr) {
+            anotherConnectionDescr = itSecondDescr->second;
+        } else if (itFirstDescr != addrs_.end() && itSecondDescr != addrs_.end()) {
+            anotherConnectionDescr = itFirstDescr->second;
+        }
+        if (anotherConnectionDescr != -1) {
+            auto it = connections_.find(anotherConnectionDescr);
+            if (it != connections_.end()) {
+                send(it->first, rep2, it->second.binary ? BinaryProtocol::encodeTrade(BinaryProtocol::TradeUpdated, *trade, seq) : QByteArray());
             }
         }
+        eraseTrade(trade->tradeId_);
     }
 }
 
-bool AtomEngineServer::load()
+bool AtomEngineServer::load(const DBSettings& dbSettings)
 {
-    DBManager::instance().loadOrders(orders_);
-    DBManager::instance().loadTrades(trades_);
-    DBManager::instance().loadBlackList(blackList_);
+    QElapsedTimer timer;
+    timer.start();
+
+    SnapshotStatePtr state = std::make_shared<SnapshotState>();
+    qint64 journalSize = 0;
+    if (dbSettings.snapshotFile.isEmpty()) {
+        if (backupFile_.exists()) {
+            // it misses every change made while snapshots are disabled
+            backupFile_.remove();
+            Logger::info() << "Snapshots are disabled, removed " + backupFile_.fileName();
+        }
+        loadFromDatabase(*state);
+    } else if (Snapshot::read(backupFile_, *state)) {
+        Logger::info() << "Loaded snapshot " + QString::number(state->generation) + " in " + QString::number(timer.restart()) + " ms";
+        DBMutations mutations;
+        if (Journal::read(dbSettings.journalFile, state->generation, mutations, journalSize)) {
+            for (size_t i = 0; i < mutations.size(); ++i) {
+                Snapshot::apply(*state, mutations[i]);
+            }
+            DBManager::instance().replay(mutations);
+            Logger::info() << "Replayed " + QString::number(mutations.size()) + " journal records in " + QString::number(timer.restart()) + " ms";
+        }
+    } else {
+        Logger::info() << "No valid snapshot in " + backupFile_.fileName() + ", loading from the database";
+        loadFromDatabase(*state);
+    }
+
+    // orders of a snapshot or journal written before the counts and codes were checked
+    for (auto it = state->orders.begin(); it != state->orders.end();) {
+        if (it->second->hasPrice() && it->second->hasValidCurrencies()) {
+            ++it;
+        } else {
+            Logger::warning() << "Skipped order " + QString::number(it->first) + " without positive counts or valid currency codes";
+            it = state->orders.erase(it);
+        }
+    }
+    // orders taken by trades which were persisted before the trade deleted its order
+    for (auto it = state->trades.begin(); it != state->trades.end(); ++it) {
+        long long orderId = it->second->order_->orderId_;
+        if (state->orders.erase(orderId) > 0) {
+            Logger::warning() << "Skipped order " + QString::number(orderId) + " taken by trade " + QString::number(it->first);
+            DBManager::instance().deleteFromOrders(orderId);
+        }
+    }
+    Orders orders(state->orders);
+    orders_.load(std::move(orders));
+    // trades are changed in place by the server, the writer keeps its own copies
+    for (auto it = state->trades.begin(); it != state->trades.end(); ++it) {
+        trades_.emplace_hint(trades_.end(), it->first, TradeInfo::create(*it->second));
+    }
+    for (auto it = trades_.begin(); it != trades_.end(); ++it) {
+        indexTrade(it->second);
+    }
+    blackList_.load(state->blackList);
+    curOrderId_ = std::max(curOrderId_, state->maxOrderId);
+    curTradeId_ = std::max(curTradeId_, state->maxTradeId);
+    Logger::info() << "State loaded, orders = " + QString::number(orders_.size()) + ", trades = " + QString::number(trades_.size()) + ", black list entries = " + QString::number(blackList_.size()) + ", last order id = " + QString::number(curOrderId_) + ", last trade id = " + QString::number(curTradeId_);
+
+    if (!dbSettings.snapshotFile.isEmpty()) {
+        DBManager::instance().startSnapshots(state, journalSize);
+    }
     return true;
 }
 
-OrderInfoPtr AtomEngineServer::createOrder(const QString& key, const QJsonObject& orderJson)
+void AtomEngineServer::loadFromDatabase(SnapshotState& state)
+{
+    QElapsedTimer totalTimer;
+    totalTimer.start();
+    QElapsedTimer timer;
+    timer.start();
+
+    DBManager::instance().loadOrders(state.orders);
+    Logger::info() << "Loaded " + QString::number(state.orders.size()) + " orders in " + QString::number(timer.restart()) + " ms";
+
+    DBManager::instance().loadTrades(state.orders, state.trades);
+    Logger::info() << "Loaded " + QString::number(state.trades.size()) + " trades in " + QString::number(timer.restart()) + " ms";
+
+    DBManager::instance().loadBlackList(state.blackList);
+    Logger::info() << "Loaded " + QString::number(state.blackList.size()) + " black list entries in " + QString::number(timer.restart()) + " ms";
+
+    DBManager::instance().loadMaxIds(state.maxOrderId, state.maxTradeId);
+
+    qint64 totalMs = totalTimer.elapsed();
+    Logger::info() << "Database loaded in " + QString::number(totalMs) + " ms";
+    long long loadBudgetMs = settings_->value("database/load_budget_ms", 0).toLongLong();
+    if (loadBudgetMs > 0 && totalMs > loadBudgetMs) {
+        Logger::warning() << "State loading took longer than database/load_budget_ms = " + QString::number(loadBudgetMs);
+    }
+}
+
+OrderInfoPtr AtomEngineServer::createOrder(const QString& key, const OrderInfoPtr& order)
 {
     ++curOrderId_;
-    OrderInfoPtr order = std::make_shared<OrderInfo>(curOrderId_, orderJson);
+    order->orderId_ = curOrderId_;
     order->sign(key);
-    orders_[curOrderId_] = order;
+    orders_.insert(order);
     return order;
 }
 
-bool AtomEngineServer::deleteOrder(const QString& key, long long id)
+OrderInfoPtr AtomEngineServer::deleteOrder(const QString& key, long long id)
 {
-    auto it = orders_.find(id);
-    if (it != orders_.end() && it->second->checkKey(key)) {
-        orders_.erase(it);
-        return true;
+    OrderInfoPtr order = orders_.find(id);
+    if (order && order->checkKey(key)) {
+        return orders_.take(id);
     } else {
-        return false;
+        return OrderInfoPtr();
     }
 }
 
 TradeInfoPtr AtomEngineServer::createTrade(const QString& key, long long orderId, const QString& initiatorAddress)
 {
-    auto it = orders_.find(orderId);
-    if (it != orders_.end()) {
-        OrderInfoPtr order = it->second;
-        orders_.erase(it);
+    OrderInfoPtr order = orders_.take(orderId);
+    if (order) {
         ++curTradeId_;
-        TradeInfoPtr trade = std::make_shared<TradeInfo>(curTradeId_, order, initiatorAddress);
+        TradeInfoPtr trade = TradeInfo::create(curTradeId_, order, initiatorAddress);
         trade->sign(key);
         trades_[curTradeId_] = trade;
+        indexTrade(trade);
         return trade;
     } else {
         return TradeInfoPtr();
     }
 }
 
-TradeInfoPtr AtomEngineServer::updateTrade(const QString& key, const QJsonObject& tradeJson)
+void AtomEngineServer::indexTrade(const TradeInfoPtr& trade)
+{
+    addrTrades_[trade->order_->getAddress_].insert(trade->tradeId_);
+    addrTrades_[trade->initiatorAddress_].insert(trade->tradeId_);
+}
+
+void AtomEngineServer::eraseTrade(long long id)
 {
-    long long id = tradeJson["id"].toVariant().toLongLong();
     auto it = trades_.find(id);
+    if (it == trades_.end()) {
+        return;
+    }
+    // trade addresses never change, so they find the index entries
+    const QString* addrs[] = {&it->second->order_->getAddress_, &it->second->initiatorAddress_};
+    for (const QString* addr : addrs) {
+        auto itTrades = addrTrades_.find(*addr);
+        if (itTrades != addrTrades_.end()) {
+            itTrades->second.erase(id);
+            if (itTrades->second.empty()) {
+                addrTrades_.erase(itTrades);
+            }
+        }
+    }
+    trades_.erase(it);
+}
+
+void AtomEngineServer::bindAddr(const QString& addr, qintptr descr)
+{
+    auto it = addrs_.find(addr);
+    if (it != addrs_.end()) {
+        if (it->second == descr) {
+            return;
+        }
+        // the address moved to another connection
+        auto itAddrs = connectionAddrs_.find(it->second);
+        if (itAddrs != connectionAddrs_.end()) {
+            itAddrs->second.erase(addr);
+            if (itAddrs->second.empty()) {
+                connectionAddrs_.erase(itAddrs);
+            }
+        }
+        it->second = descr;
+    } else {
+        addrs_[addr] = descr;
+        changePresence(addr, true);
+    }
+    connectionAddrs_[descr].insert(addr);
+}
+
+TradeInfoPtr AtomEngineServer::updateTrade(const QString& key, const TradeUpdate& update)
+{
+    auto it = trades_.find(update.id);
     if (it != trades_.end() && (it->second->checkKey(key) || it->second->checkOrderKey(key))) {
         TradeInfoPtr trade = it->second;
-        trade->secretHash_ = tradeJson["secretHash"].toString();
-        trade->contractInitiator_ = tradeJson["contractInitiator"].toString();
-        trade->contractParticipant_ = tradeJson["contractParticipant"].toString();
-        trade->initiatorContractTransaction_ = tradeJson["initiatorContractTransaction"].toString();
-        trade->participantContractTransaction_ = tradeJson["participantContractTransaction"].toString();
-        trade->initiatorRedemptionTransaction_ = tradeJson["initiatorRedemptionTransaction"].toString();
-        trade->participantRedemptionTransaction_ = tradeJson["participantRedemptionTransaction"].toString();
+        trade->secretHash_ = update.secretHash;
+        trade->contractInitiator_ = update.contractInitiator;
+        trade->contractParticipant_ = update.contractParticipant;
+        trade->initiatorContractTransaction_ = update.initiatorContractTransaction;
+        trade->participantContractTransaction_ = update.participantContractTransaction;
+        trade->initiatorRedemptionTransaction_ = update.initiatorRedemptionTransaction;
+        trade->participantRedemptionTransaction_ = update.participantRedemptionTransaction;
         if (!trade->initiatorCommissionPaid_) {
-            trade->initiatorCommissionPaid_ = tradeJson["commissionInitiatorPaid"].toBool();
+            trade->initiatorCommissionPaid_ = update.commissionInitiatorPaid;
         }
         if (!trade->participantCommissionPaid_) {
-            trade->participantCommissionPaid_ = tradeJson["commissionParticipantPaid"].toBool();
+            trade->participantCommissionPaid_ = update.commissionParticipantPaid;
         }
 
-        if (tradeJson.contains("refundedInit")) {
-            trade->refundedInit_ = tradeJson["refundedInit"].toBool();
+        if (update.hasRefundedInit) {
+            trade->refundedInit_ = update.refundedInit;
         }
-        if (tradeJson.contains("refundedPart")) {
-            trade->refundedPart_ = tradeJson["refundedPart"].toBool();
+        if (update.hasRefundedPart) {
+            trade->refundedPart_ = update.refundedPart;
         }
 
-        if (tradeJson.contains("refundTimeInit")) {
-            trade->refundTimeInit_ = tradeJson["refundTimeInit"].toVariant().toLongLong();
+        if (update.hasRefundTimeInit) {
+            trade->refundTimeInit_ = update.refundTimeInit;
         }
 
-        if (tradeJson.contains("refundTimePart")) {
-            trade->refundTimePart_ = tradeJson["refundTimePart"].toVariant().toLongLong();
+        if (update.hasRefundTimePart) {
+            trade->refundTimePart_ = update.refundTimePart;
         }
 
+        trade->invalidateJson();
         return trade;
     } else {
         return TradeInfoPtr();
@@ -6,33 +6,52 @@
 #define ATOMENGINESERVER_H
 
 #include <QObject>
-#include <QTcpServer>
-#include <QTcpSocket>
+#include <QThread>
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QFile>
 #include <map>
 #include <memory>
 #include <set>
+#include <vector>
 #include <QSettings>
+#include <QTimer>
+#include "connectionworker.h"
+#include "orderbook.h"
+#include "subscriptions.h"
+#include "eventjournal.h"
+#include "binaryprotocol.h"
+#include "ratelimiter.h"
+#include "blacklist.h"
 
-struct OrderInfo;
-using OrderInfoPtr = std::shared_ptr<OrderInfo>;
-using Orders = std::map<long long, OrderInfoPtr>;
+class TcpServer;
+class MetricsServer;
+class Counter;
+class Gauge;
+class Histogram;
+struct DBSettings;
+struct SnapshotState;
 
 struct TradeInfo;
 using TradeInfoPtr = std::shared_ptr<TradeInfo>;
 using Trades = std::map<long long, TradeInfoPtr>;
 
-using Connections = std::map<qintptr, QTcpSocket*>;
-using Buffers = std::map<qintptr, QByteArray>;
+struct Connection {
+    ConnectionWorker* worker;
+    QString ip;
+    IpKey ipKey;
+    bool binary;
+};
+using Connections = std::map<qintptr, Connection>;
+using Workers = std::vector<ConnectionWorker*>;
+using WorkerThreads = std::vector<QThread*>;
 
 using ActiveAddrs = std::map<QString, qintptr>;
 using Addrs = std::set<QString>;
+using ConnectionAddrs = std::map<qintptr, Addrs>;
+using AddrTrades = std::map<QString, std::set<long long>>;
+using PresenceChanges = std::map<QString, bool>;
 
-using BlackList = std::set<QString>;
-using RequestCheckingTime = std::map<QString, long long>;
-using RequestCheckingCount = std::map<QString, long long>;
 
 class AtomEngineServer : public QObject
 {
@@ -43,34 +62,116 @@ public:
 
     bool run();
 private:
-    bool load();
-    OrderInfoPtr createOrder(const QString& key, const QJsonObject& orderJson);
-    bool deleteOrder(const QString& key, long long id);
+    bool load(const DBSettings& dbSettings);
+    void loadFromDatabase(SnapshotState& state);
+    OrderInfoPtr createOrder(const QString& key, const OrderInfoPtr& order);
+    OrderInfoPtr deleteOrder(const QString& key, long long id);
     TradeInfoPtr createTrade(const QString& key, long long orderId, const QString& initiatorAddress);
-    TradeInfoPtr updateTrade(const QString& key, const QJsonObject& tradeJson);
-    void sendDisconnectedAddrs(const Addrs& addrs);
-    void sendConnectedAddrs(qintptr curDescr);
+    TradeInfoPtr updateTrade(const QString& key, const TradeUpdate& update);
+    void indexTrade(const TradeInfoPtr& trade);
+    void eraseTrade(long long id);
+    void bindAddr(const QString& addr, qintptr descr);
+    void startWorkers(int threadsCount);
+    void stopWorkers();
+    // binary is the encoding for connections which use the binary protocol, if it is empty they get data in a Json frame
+    void send(qintptr descr, const QByteArray& data, const QByteArray& binary = QByteArray());
+    void sendStream(qintptr descr, const ReplyStreamPtr& stream);
+    void broadcast(const std::vector<qintptr>& descrs, const QByteArray& data, const QByteArray& binary = QByteArray());
+    bool isBinary(qintptr descr) const;
+    void closeConnection(qintptr descr);
+    void addToBlackList(qintptr descr, const QString& clientIp);
+    // routes the request to the handler of its command, every handler reads only the fields it needs
+    void handleRequest(qintptr descr, const Request& request);
+    void handleInit(qintptr descr, const Request& req);
+    void handleRequestSwapCommission(qintptr descr, const Request& req);
+    void handleCreateOrder(qintptr descr, const Request& req);
+    // the empty code and, when orders/currencies is set, only the codes it lists
+    bool acceptCurrency(const QString& code) const;
+    void handleDeleteOrder(qintptr descr, const Request& req);
+    void handleGetOrders(qintptr descr, const Request& req);
+    void handleSubscribe(qintptr descr, const Request& req);
+    void handleUnsubscribe(qintptr descr, const Request& req);
+    void changeSubscription(qintptr descr, const Request& req, bool subscribe);
+    void handleCreateTrade(qintptr descr, const Request& req);
+    void handleUpdateTrade(qintptr descr, const Request& req);
+    // presence changes are coalesced for presence/coalesce_ms and sent as deltas
+    void changePresence(const QString& addr, bool connected);
+    QByteArray presenceJson(const char* reply, long long seq, const Addrs& addrs);
+    // empty when no connection uses the binary protocol
+    QByteArray presenceBinary(BinaryProtocol::MessageType type, long long seq, const Addrs& addrs);
+    void sendInitState(qintptr descr, const Addrs& activeAddrs, bool binary);
+    // the events after lastSeq instead of the whole state, false when the journal no longer has them
+    bool sendEventsSince(qintptr descr, long long lastSeq, const Addrs& activeAddrs, bool binary);
+    void startMetrics();
 private slots:
-    void onNewConnection();
-    void onClientDisconnected();
-    void onReadyRead();
+    void onSocketAccepted(qintptr socketDescriptor);
+    void onConnectionOpened(qintptr descr, const QString& clientIp);
+    void onConnectionClosed(qintptr descr, const QString& clientIp);
+    void onRequestsReceived(qintptr descr, const QString& clientIp, const Requests& requests);
+    void onRequestTooLarge(qintptr descr, const QString& clientIp);
+    void onReportQueues();
+    void onFlushPresence();
+    void onExpireBlackList();
+    void onCollectMetrics();
 private:
-    QTcpServer* server_;
+    struct CommandMetrics {
+        Counter* requests;
+        Histogram* duration;
+    };
+
+    TcpServer* server_;
+    Workers workers_;
+    WorkerThreads workerThreads_;
+    size_t nextWorker_;
+    qintptr curConnectionId_;
     Connections connections_;
-    Orders orders_;
+    size_t binaryConnections_;
+    Subscriptions subscriptions_;
+    OrderBook orders_;
+    // orders/currencies, the codes an order may use, any code when it is empty
+    std::set<QString> currencies_;
     Trades trades_;
     ActiveAddrs addrs_;
+    // secondary indexes, so that init and disconnect only touch the client's own addresses and trades
+    ConnectionAddrs connectionAddrs_;
+    AddrTrades addrTrades_;
+    EventJournal events_;
+    // address -> connected, changes which are not sent yet
+    PresenceChanges presenceChanges_;
+    QTimer presenceTimer_;
     long long curOrderId_;
     long long curTradeId_;
     QFile backupFile_;
-    Buffers buffers_;
     QSettings* settings_;
     BlackList blackList_;
+    // seconds an automatically added entry is blocked, 0 is forever
+    long long blackListTtl_;
+    QTimer blackListTimer_;
     long long maxRequestSize_;
+    OutputLimits outputLimits_;
+    // logs the output queues which are above a quarter of the high-water mark
+    QTimer queuesTimer_;
     long long requestCheckingInterval_;
     long long requestsCount_;
-    RequestCheckingTime checkingTime_;
-    RequestCheckingCount checkingCount_;
+    RateLimiter rateLimiter_;
+    // serves Metrics on metrics/port, nullptr when it is 0
+    MetricsServer* metricsServer_;
+    // by command, unknown commands share one entry so that clients cannot add series
+    CommandMetrics commandsMetrics_[Commands::Count];
+    // rate limiter tokens taken by a command
+    double commandCosts_[Commands::Count];
+    Histogram* broadcastRecipients_;
+    Counter* openBlackListHits_;
+    Counter* requestBlackListHits_;
+    Counter* rateLimited_;
+    Gauge* connectionsGauge_;
+    Gauge* binaryConnectionsGauge_;
+    Gauge* outputQueueBytesGauge_;
+    Gauge* dbQueueDepthGauge_;
+    Gauge* blackListSizeGauge_;
+    Gauge* rateLimiterBucketsGauge_;
+    Gauge* poolBytesGauge_;
+    Gauge* poolUsedBytesGauge_;
 };
 
 #endif // ATOMENGINESERVER_H
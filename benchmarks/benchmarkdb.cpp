@@ -0,0 +1,84 @@
+// Copyright 2018 AtomicSwap Solutions Ltd. All rights reserved.
+// Use of this source code is governed by Microsoft Reference Source
+// License (MS-RSL) that can be found in the LICENSE file.
+
+#include "benchmarkdb.h"
+#include <QDir>
+#include <QFile>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+
+namespace {
+    const QString schemaConnectionName = "benchmark schema";
+}
+
+const char BenchmarkDB::orderAddressPrefix[] = "mtG7w1Sg4gMnS5b1PqKz8F3jh2R";
+const char BenchmarkDB::tradeAddressPrefix[] = "n4Vq7k1XoYt2T6UkZb8hP3cS9d";
+const char BenchmarkDB::secretHash[] = "9c1185a5c5e9fc54612808977ee8f548b2258d31ddadef707ba62c3f2d2f3a6a";
+const char BenchmarkDB::contract[] = "6382012088a8209c1185a5c5e9fc54612808977ee8f548b2258d31";
+const char BenchmarkDB::transaction[] = "2b4f6c3e0e5a1d7c9b8a3f2e1d0c9b8a7f6e5d4c3b2a1908f7e6d5c4b3a29180";
+
+QString BenchmarkDB::create(const QString& fileName)
+{
+    QString path = QDir(QDir::tempPath()).filePath(fileName);
+    remove(path);
+
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", schemaConnectionName);
+        db.setDatabaseName(path);
+        db.open();
+        createSchema(db);
+        db.close();
+    }
+    QSqlDatabase::removeDatabase(schemaConnectionName);
+    return path;
+}
+
+void BenchmarkDB::createSchema(QSqlDatabase& db)
+{
+    QSqlQuery query(db);
+    query.exec("CREATE TABLE orders (id INTEGER PRIMARY KEY, sendCur TEXT, sendCount INTEGER, getCur TEXT, getCount INTEGER, getAddress TEXT, hash TEXT)");
+    query.exec("CREATE TABLE trades (orderId INTEGER, sendCur TEXT, sendCount INTEGER, getCur TEXT, getCount INTEGER, getAddress TEXT, orderHash TEXT, " \
+               "id INTEGER PRIMARY KEY, initiatorAddress TEXT, secretHash TEXT, contractInitiator TEXT, contractParticipant TEXT, " \
+               "initiatorContractTransaction TEXT, participantContractTransaction TEXT, initiatorRedemptionTransaction TEXT, participantRedemptionTransaction TEXT, " \
+               "initiatorCommissionPaid INTEGER, participantCommissionPaid INTEGER, refundedInit INTEGER, refundedPart INTEGER, " \
+               "refundTimeInit INTEGER, refundTimePart INTEGER, hash TEXT)");
+    query.exec("CREATE TABLE black_list (ip TEXT, expires_at INTEGER NOT NULL DEFAULT 0)");
+}
+
+void BenchmarkDB::remove(const QString& path)
+{
+    QFile::remove(path);
+    QFile::remove(path + "-wal");
+    QFile::remove(path + "-shm");
+    QFile::remove(path + "-journal");
+}
+
+OrderInfoPtr BenchmarkDB::makeOrder(long long id)
+{
+    OrderInfoPtr order = OrderInfo::create();
+    order->orderId_ = id;
+    order->sendCur_ = CurrencyCode::fromString("BTC");
+    order->sendCount_ = 100000000 + id;
+    order->getCur_ = CurrencyCode::fromString("LTC");
+    order->getCount_ = 6000000000 + id;
+    order->getAddress_ = orderAddressPrefix + QString::number(id);
+    order->sign("key" + QString::number(id));
+    return order;
+}
+
+TradeInfoPtr BenchmarkDB::makeTrade(long long id, OrderInfoPtr order)
+{
+    TradeInfoPtr trade = TradeInfo::create(id, order, tradeAddressPrefix + QString::number(id));
+    trade->secretHash_ = secretHash;
+    trade->contractInitiator_ = contract;
+    trade->contractParticipant_ = contract;
+    trade->initiatorContractTransaction_ = transaction;
+    trade->participantContractTransaction_ = transaction;
+    trade->initiatorCommissionPaid_ = true;
+    trade->participantCommissionPaid_ = true;
+    trade->refundTimeInit_ = 1530000000 + id;
+    trade->refundTimePart_ = 1530000000 + id;
+    trade->sign("key" + QString::number(id));
+    return trade;
+}
@@ -0,0 +1,31 @@
+// Copyright 2018 AtomicSwap Solutions Ltd. All rights reserved.
+// Use of this source code is governed by Microsoft Reference Source
+// License (MS-RSL) that can be found in the LICENSE file.
+
+#ifndef BENCHMARKDB_H
+#define BENCHMARKDB_H
+
+#include <QString>
+#include <QSqlDatabase>
+#include "info.h"
+
+namespace BenchmarkDB {
+    // a fresh database file with the engine's schema
+    QString create(const QString& fileName);
+    void createSchema(QSqlDatabase& db);
+    void remove(const QString& path);
+
+    // the records all benchmarks use, every field which a client fills in is set
+    // and every text is a copy of its own like a parsed request gives
+    OrderInfoPtr makeOrder(long long id);
+    TradeInfoPtr makeTrade(long long id, OrderInfoPtr order);
+
+    // texts of the records, an address is the prefix followed by the id
+    extern const char orderAddressPrefix[];
+    extern const char tradeAddressPrefix[];
+    extern const char secretHash[];
+    extern const char contract[];
+    extern const char transaction[];
+}
+
+#endif // BENCHMARKDB_H
@@ -0,0 +1,62 @@
+QT -= gui
+QT += network sql testlib
+
+CONFIG += c++11 console
+CONFIG -= app_bundle
+
+TARGET = atom-engine-benchmarks
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+INCLUDEPATH += ..
+
+SOURCES += main.cpp \
+    benchmarkdb.cpp \
+    broadcastbenchmark.cpp \
+    dbwritebenchmark.cpp \
+    documentparser.cpp \
+    framingbenchmark.cpp \
+    jsonreaderbenchmark.cpp \
+    memorybenchmark.cpp \
+    serializationbenchmark.cpp \
+    statementbenchmark.cpp \
+    ../binaryprotocol.cpp \
+    ../blacklist.cpp \
+    ../commands.cpp \
+    ../connectionworker.cpp \
+    ../dbwriter.cpp \
+    ../info.cpp \
+    ../jsonreader.cpp \
+    ../lineframer.cpp \
+    ../logger.cpp \
+    ../metrics.cpp \
+    ../replystream.cpp \
+    ../request.cpp \
+    ../snapshot.cpp \
+    ../tcpserver.cpp
+
+HEADERS += \
+    benchmarkdb.h \
+    broadcastbenchmark.h \
+    dbwritebenchmark.h \
+    documentparser.h \
+    framingbenchmark.h \
+    jsonreaderbenchmark.h \
+    memorybenchmark.h \
+    serializationbenchmark.h \
+    statementbenchmark.h \
+    ../binaryprotocol.h \
+    ../blacklist.h \
+    ../commands.h \
+    ../connectionworker.h \
+    ../dbwriter.h \
+    ../info.h \
+    ../jsonreader.h \
+    ../lineframer.h \
+    ../logger.h \
+    ../metrics.h \
+    ../replystream.h \
+    ../request.h \
+    ../slabpool.h \
+    ../snapshot.h \
+    ../tcpserver.h
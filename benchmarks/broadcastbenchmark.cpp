@@ -0,0 +1,193 @@
+// Copyright 2018 AtomicSwap Solutions Ltd. All rights reserved.
+// Use of this source code is governed by Microsoft Reference Source
+// License (MS-RSL) that can be found in the LICENSE file.
+
+#include "broadcastbenchmark.h"
+#include "connectionworker.h"
+#include "tcpserver.h"
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QHostAddress>
+#include <QTest>
+#include <string>
+
+#ifdef Q_OS_UNIX
+#include <sys/resource.h>
+#endif
+
+namespace {
+    const int addrsCount = 200;
+    // how long connecting or draining may take before the row fails
+    const int timeoutMs = 30000;
+
+    QString presenceReply()
+    {
+        QString rep = "{\"reply\":\"user_connected\", \"addrs\": [";
+        for (int i = 0; i < addrsCount; ++i) {
+            if (i != 0) {
+                rep += ", ";
+            }
+            rep += "\"mtG7w1Sg4gMnS5b1PqKz8F3jh2R" + QString::number(100000 + i) + "\"";
+        }
+        rep += "]}\n";
+        return rep;
+    }
+
+    void addRows()
+    {
+        QTest::addColumn<int>("connections");
+        QTest::newRow("1k connections") << 1000;
+        QTest::newRow("10k connections") << 10000;
+    }
+
+    // both ends of every connection are in this process
+    bool reserveDescriptors(int connections)
+    {
+#ifdef Q_OS_UNIX
+        rlim_t needed = rlim_t(connections) * 2 + 64;
+        rlimit limit;
+        if (getrlimit(RLIMIT_NOFILE, &limit) != 0) {
+            return false;
+        }
+        if (limit.rlim_cur >= needed) {
+            return true;
+        }
+        if (limit.rlim_max != RLIM_INFINITY && limit.rlim_max < needed) {
+            return false;
+        }
+        limit.rlim_cur = needed;
+        return setrlimit(RLIMIT_NOFILE, &limit) == 0;
+#else
+        Q_UNUSED(connections);
+        return true;
+#endif
+    }
+}
+
+BroadcastBenchmark::BroadcastBenchmark() :
+    server_(nullptr),
+    worker_(nullptr)
+{
+}
+
+BroadcastBenchmark::~BroadcastBenchmark()
+{
+    cleanup();
+}
+
+void BroadcastBenchmark::onSocketAccepted(qintptr socketDescriptor)
+{
+    qintptr connectionId = connectionIds_.size() + 1;
+    connectionIds_.append(connectionId);
+    worker_->addConnection(connectionId, socketDescriptor);
+}
+
+void BroadcastBenchmark::onClientReadyRead()
+{
+    ((QTcpSocket*)sender())->readAll();
+}
+
+bool BroadcastBenchmark::openConnections(int connections)
+{
+    if (!reserveDescriptors(connections)) {
+        return false;
+    }
+    OutputLimits outputLimits;
+    // every message is written, none is dropped however many are queued
+    outputLimits.highWaterMark = 0;
+    worker_ = new ConnectionWorker(1024 * 1024, outputLimits);
+    server_ = new TcpServer();
+    connect(server_, SIGNAL(socketAccepted(qintptr)), this, SLOT(onSocketAccepted(qintptr)));
+    if (!server_->listen(QHostAddress::LocalHost)) {
+        return false;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < connections; ++i) {
+        QTcpSocket* client = new QTcpSocket();
+        connect(client, SIGNAL(readyRead()), this, SLOT(onClientReadyRead()));
+        clients_.push_back(client);
+        client->connectToHost(QHostAddress::LocalHost, server_->serverPort());
+        // accepted one by one, so the listen backlog never overflows
+        while (connectionIds_.size() <= i) {
+            if (timer.elapsed() > timeoutMs) {
+                return false;
+            }
+            QCoreApplication::processEvents();
+        }
+    }
+    return true;
+}
+
+void BroadcastBenchmark::drain()
+{
+    QElapsedTimer timer;
+    timer.start();
+    while (timer.elapsed() < timeoutMs) {
+        QCoreApplication::processEvents();
+        OutputQueues queues;
+        worker_->outputQueues(queues);
+        qint64 bytes = 0;
+        for (size_t i = 0; i < queues.size(); ++i) {
+            bytes += queues[i].bytes;
+        }
+        if (bytes == 0) {
+            return;
+        }
+    }
+    QFAIL("the worker did not write its output");
+}
+
+void BroadcastBenchmark::cleanup()
+{
+    for (size_t i = 0; i < clients_.size(); ++i) {
+        delete clients_[i];
+    }
+    clients_.clear();
+    delete worker_;
+    worker_ = nullptr;
+    delete server_;
+    server_ = nullptr;
+    connectionIds_.clear();
+}
+
+void BroadcastBenchmark::perRecipientEncoding_data()
+{
+    addRows();
+}
+
+void BroadcastBenchmark::perRecipientEncoding()
+{
+    QFETCH(int, connections);
+    if (!openConnections(connections)) {
+        QSKIP("not enough sockets for this row");
+    }
+    QString rep = presenceReply();
+
+    QBENCHMARK {
+        for (int i = 0; i < connectionIds_.size(); ++i) {
+            worker_->send(connectionIds_[i], QByteArray(rep.toStdString().c_str()));
+        }
+        drain();
+    }
+}
+
+void BroadcastBenchmark::sharedBuffer_data()
+{
+    addRows();
+}
+
+void BroadcastBenchmark::sharedBuffer()
+{
+    QFETCH(int, connections);
+    if (!openConnections(connections)) {
+        QSKIP("not enough sockets for this row");
+    }
+    QString rep = presenceReply();
+
+    QBENCHMARK {
+        worker_->send(connectionIds_, rep.toUtf8());
+        drain();
+    }
+}
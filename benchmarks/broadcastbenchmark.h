@@ -0,0 +1,48 @@
+// Copyright 2018 AtomicSwap Solutions Ltd. All rights reserved.
+// Use of this source code is governed by Microsoft Reference Source
+// License (MS-RSL) that can be found in the LICENSE file.
+
+#ifndef BROADCASTBENCHMARK_H
+#define BROADCASTBENCHMARK_H
+
+#include <QObject>
+#include <QTcpSocket>
+#include <QVector>
+#include <vector>
+
+class ConnectionWorker;
+class TcpServer;
+
+// Cost of one broadcast event through a ConnectionWorker with 1k and 10k
+// loopback connections, until the worker has written it to every socket. The
+// old path encoded the reply for every recipient and sent it connection by
+// connection, the new one encodes it once and hands the same shared buffer to
+// writeToMany() for all connections of the worker.
+class BroadcastBenchmark : public QObject
+{
+    Q_OBJECT
+public:
+    BroadcastBenchmark();
+    ~BroadcastBenchmark();
+public slots:
+    void onSocketAccepted(qintptr socketDescriptor);
+    void onClientReadyRead();
+private slots:
+    void perRecipientEncoding_data();
+    void perRecipientEncoding();
+    void sharedBuffer_data();
+    void sharedBuffer();
+    void cleanup();
+private:
+    // false when the process may not open that many sockets
+    bool openConnections(int connections);
+    // runs the event loop until the worker has no output left
+    void drain();
+private:
+    TcpServer* server_;
+    ConnectionWorker* worker_;
+    std::vector<QTcpSocket*> clients_;
+    QVector<qintptr> connectionIds_;
+};
+
+#endif // BROADCASTBENCHMARK_H
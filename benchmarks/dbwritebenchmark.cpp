@@ -0,0 +1,79 @@
+// Copyright 2018 AtomicSwap Solutions Ltd. All rights reserved.
+// Use of this source code is governed by Microsoft Reference Source
+// License (MS-RSL) that can be found in the LICENSE file.
+
+#include "dbwritebenchmark.h"
+#include <QTest>
+#include <QElapsedTimer>
+#include "benchmarkdb.h"
+#include "dbwriter.h"
+
+namespace {
+    const int ordersCount = 2000;
+}
+
+void DBWriteBenchmark::orderLifecycle_data()
+{
+    QTest::addColumn<bool>("groupCommit");
+    QTest::addColumn<QString>("journalMode");
+    QTest::addColumn<QString>("synchronous");
+
+    QTest::newRow("autocommit, DELETE, FULL") << false << QString("DELETE") << QString("FULL");
+    QTest::newRow("autocommit, WAL, NORMAL") << false << QString("WAL") << QString("NORMAL");
+    QTest::newRow("group commit, DELETE, FULL") << true << QString("DELETE") << QString("FULL");
+    QTest::newRow("group commit, WAL, NORMAL") << true << QString("WAL") << QString("NORMAL");
+}
+
+void DBWriteBenchmark::orderLifecycle()
+{
+    QFETCH(bool, groupCommit);
+    QFETCH(QString, journalMode);
+    QFETCH(QString, synchronous);
+
+    DBSettings settings;
+    settings.name = BenchmarkDB::create("atom-engine-write-benchmark.db");
+    // autocommit: every mutation is committed before the next one is queued
+    settings.syncCommit = !groupCommit;
+    settings.flushIntervalMs = groupCommit ? 5 : 0;
+    settings.journalMode = journalMode;
+    settings.synchronous = synchronous;
+
+    // every order is created, taken by a trade, updated and completed
+    qint64 elapsedNs = 0;
+    {
+        QElapsedTimer timer;
+        timer.start();
+        DBWriter writer(settings);
+        QVERIFY(writer.open());
+        for (long long id = 1; id <= ordersCount; ++id) {
+            OrderInfoPtr order = BenchmarkDB::makeOrder(id);
+            TradeInfoPtr trade = BenchmarkDB::makeTrade(id, order);
+
+            DBMutation mutation;
+            mutation.type = DBMutation::AddOrder;
+            mutation.order = order;
+            writer.enqueue(mutation);
+
+            mutation.type = DBMutation::DeleteOrder;
+            mutation.id = id;
+            writer.enqueue(mutation);
+
+            mutation.type = DBMutation::AddTrade;
+            mutation.trade = trade;
+            writer.enqueue(mutation);
+
+            mutation.type = DBMutation::UpdateTrade;
+            writer.enqueue(mutation);
+
+            mutation.type = DBMutation::DeleteTrade;
+            writer.enqueue(mutation);
+        }
+        writer.stop();
+        elapsedNs = timer.nsecsElapsed();
+    }
+
+    // the time of one mutation, until it is committed
+    long long mutations = ordersCount * 5;
+    QTest::setBenchmarkResult(qreal(elapsedNs) / mutations, QTest::WalltimeNanoseconds);
+    BenchmarkDB::remove(settings.name);
+}
@@ -0,0 +1,20 @@
+// Copyright 2018 AtomicSwap Solutions Ltd. All rights reserved.
+// Use of this source code is governed by Microsoft Reference Source
+// License (MS-RSL) that can be found in the LICENSE file.
+
+#ifndef DBWRITEBENCHMARK_H
+#define DBWRITEBENCHMARK_H
+
+#include <QObject>
+
+// Write throughput of DBWriter over the engine schema with autocommit and
+// group commit, rollback journal and WAL.
+class DBWriteBenchmark : public QObject
+{
+    Q_OBJECT
+private slots:
+    void orderLifecycle_data();
+    void orderLifecycle();
+};
+
+#endif // DBWRITEBENCHMARK_H
@@ -0,0 +1,75 @@
+// Copyright 2018 AtomicSwap Solutions Ltd. All rights reserved.
+// Use of this source code is governed by Microsoft Reference Source
+// License (MS-RSL) that can be found in the LICENSE file.
+
+#include "documentparser.h"
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QVariant>
+#include "info.h"
+
+namespace DocumentParser
+{
+    bool parse(const QByteArray& json, Request& request)
+    {
+        QJsonDocument doc = QJsonDocument::fromJson(json);
+        if (!doc.isObject()) {
+            return false;
+        }
+        fromObject(doc.object(), request);
+        return true;
+    }
+
+    void fromObject(const QJsonObject& object, Request& request)
+    {
+        request.command = Commands::find(object["command"].toString());
+        request.key = object["key"].toString();
+        if (object.contains("order")) {
+            QJsonObject orderJson = object["order"].toObject();
+            request.order = OrderInfo::create();
+            request.order->orderId_ = 0;
+            request.order->sendCount_ = orderJson["sendCount"].toVariant().toLongLong();
+            request.order->getCount_ = orderJson["getCount"].toVariant().toLongLong();
+            request.order->getAddress_ = orderJson["getAddr"].toString();
+            request.orderSendCur = orderJson["sendCur"].toString();
+            request.orderGetCur = orderJson["getCur"].toString();
+        }
+        QJsonObject tradeJson = object["trade"].toObject();
+        TradeUpdate& trade = request.trade;
+        trade.id = tradeJson["id"].toVariant().toLongLong();
+        trade.secretHash = tradeJson["secretHash"].toString();
+        trade.contractInitiator = tradeJson["contractInitiator"].toString();
+        trade.contractParticipant = tradeJson["contractParticipant"].toString();
+        trade.initiatorContractTransaction = tradeJson["initiatorContractTransaction"].toString();
+        trade.participantContractTransaction = tradeJson["participantContractTransaction"].toString();
+        trade.initiatorRedemptionTransaction = tradeJson["initiatorRedemptionTransaction"].toString();
+        trade.participantRedemptionTransaction = tradeJson["participantRedemptionTransaction"].toString();
+        trade.commissionInitiatorPaid = tradeJson["commissionInitiatorPaid"].toBool();
+        trade.commissionParticipantPaid = tradeJson["commissionParticipantPaid"].toBool();
+        trade.hasRefundedInit = tradeJson.contains("refundedInit");
+        trade.refundedInit = tradeJson["refundedInit"].toBool();
+        trade.hasRefundedPart = tradeJson.contains("refundedPart");
+        trade.refundedPart = tradeJson["refundedPart"].toBool();
+        trade.hasRefundTimeInit = tradeJson.contains("refundTimeInit");
+        trade.refundTimeInit = tradeJson["refundTimeInit"].toVariant().toLongLong();
+        trade.hasRefundTimePart = tradeJson.contains("refundTimePart");
+        trade.refundTimePart = tradeJson["refundTimePart"].toVariant().toLongLong();
+        request.id = object["id"].toVariant().toLongLong();
+        request.orderId = object["orderId"].toVariant().toLongLong();
+        request.address = object["address"].toString();
+        QJsonArray curs = object["curs"].toArray();
+        for (int i = 0; i < curs.size(); ++i) {
+            QJsonArray addrs = curs[i].toObject()["addrs"].toArray();
+            for (int j = 0; j < addrs.size(); ++j) {
+                request.addrs.push_back(addrs[j].toString());
+            }
+        }
+        request.binaryProtocol = object["protocol"].toString() == "binary";
+        request.hasLastSeq = object.contains("lastSeq");
+        request.lastSeq = object["lastSeq"].toVariant().toLongLong();
+        request.epoch = object["epoch"].toVariant().toLongLong();
+        request.sendCur = object["sendCur"].toString();
+        request.getCur = object["getCur"].toString();
+        request.limit = object["limit"].toVariant().toLongLong();
+    }
+}
@@ -0,0 +1,22 @@
+// Copyright 2018 AtomicSwap Solutions Ltd. All rights reserved.
+// Use of this source code is governed by Microsoft Reference Source
+// License (MS-RSL) that can be found in the LICENSE file.
+
+#ifndef DOCUMENTPARSER_H
+#define DOCUMENTPARSER_H
+
+#include <QByteArray>
+#include <QJsonObject>
+#include "request.h"
+
+// The way requests were read before RequestParser: the line is parsed into a
+// QJsonDocument and the fields are read from its objects. It is the baseline
+// of the benchmarks and the reference of the parser tests.
+namespace DocumentParser
+{
+    // false when the line is not a JSON object
+    bool parse(const QByteArray& json, Request& request);
+    void fromObject(const QJsonObject& object, Request& request);
+}
+
+#endif // DOCUMENTPARSER_H
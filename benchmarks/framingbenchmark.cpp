@@ -0,0 +1,104 @@
+// Copyright 2018 AtomicSwap Solutions Ltd. All rights reserved.
+// Use of this source code is governed by Microsoft Reference Source
+// License (MS-RSL) that can be found in the LICENSE file.
+
+#include "framingbenchmark.h"
+#include <QTest>
+#include <QByteArrayList>
+#include <QVector>
+#include "lineframer.h"
+
+namespace {
+    using Packets = QVector<QByteArray>;
+
+    QByteArray request(int size)
+    {
+        QByteArray req = "{\"command\": \"get_orders\", \"sendCur\": \"BTC\", \"getCur\": \"BCA\", \"padding\": \"";
+        req += QByteArray(qMax(0, size - req.size() - 3), 'x');
+        req += "\"}\n";
+        return req;
+    }
+
+    Packets fragment(const QByteArray& stream, int packetSize)
+    {
+        Packets packets;
+        for (int pos = 0; pos < stream.size(); pos += packetSize) {
+            packets.append(stream.mid(pos, packetSize));
+        }
+        return packets;
+    }
+
+    void addRows()
+    {
+        QTest::addColumn<Packets>("packets");
+        QTest::addColumn<int>("lines");
+
+        QByteArray smallRequests;
+        for (int i = 0; i < 1000; ++i) {
+            smallRequests += request(200);
+        }
+        QTest::newRow("1000 x 200 B, 16 B packets") << fragment(smallRequests, 16) << 1000;
+        QTest::newRow("1000 x 200 B, 1460 B packets") << fragment(smallRequests, 1460) << 1000;
+        QTest::newRow("1 x 1 MB, 1460 B packets") << fragment(request(1 << 20), 1460) << 1;
+    }
+}
+
+Q_DECLARE_METATYPE(Packets)
+
+void FramingBenchmark::lastIndexOfSplit_data()
+{
+    addRows();
+}
+
+void FramingBenchmark::lastIndexOfSplit()
+{
+    QFETCH(Packets, packets);
+    QFETCH(int, lines);
+
+    int framed = 0;
+    QBENCHMARK {
+        framed = 0;
+        QByteArray buffer;
+        for (int i = 0; i < packets.size(); ++i) {
+            buffer.append(packets[i]);
+            int pos = buffer.lastIndexOf("\n");
+            if (pos < 0) {
+                continue;
+            }
+            QByteArrayList commands = buffer.left(pos).split('\n');
+            int rightCount = buffer.length() - pos - 1;
+            if (rightCount > 0) {
+                buffer = buffer.right(rightCount);
+            } else {
+                buffer.clear();
+            }
+            framed += commands.size();
+        }
+    }
+    QCOMPARE(framed, lines);
+}
+
+void FramingBenchmark::lineFramer_data()
+{
+    addRows();
+}
+
+void FramingBenchmark::lineFramer()
+{
+    QFETCH(Packets, packets);
+    QFETCH(int, lines);
+
+    int framed = 0;
+    QBENCHMARK {
+        framed = 0;
+        LineFramer framer;
+        QByteArray line;
+        for (int i = 0; i < packets.size(); ++i) {
+            framer.append(packets[i]);
+            while (framer.next(line)) {
+                ++framed;
+            }
+        }
+    }
+    QCOMPARE(framed, lines);
+}
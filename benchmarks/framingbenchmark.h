@@ -0,0 +1,24 @@
+// Copyright 2018 AtomicSwap Solutions Ltd. All rights reserved.
+// Use of this source code is governed by Microsoft Reference Source
+// License (MS-RSL) that can be found in the LICENSE file.
+
+#ifndef FRAMINGBENCHMARK_H
+#define FRAMINGBENCHMARK_H
+
+#include <QObject>
+
+// Framing a fragmented stream: small requests in packets of different sizes and
+// one large request trickling in. The old path rescanned the whole buffer with
+// lastIndexOf() and copied every line with split() and right(), LineFramer scans
+// every byte once and returns views.
+class FramingBenchmark : public QObject
+{
+    Q_OBJECT
+private slots:
+    void lastIndexOfSplit_data();
+    void lastIndexOfSplit();
+    void lineFramer_data();
+    void lineFramer();
+};
+
+#endif // FRAMINGBENCHMARK_H
@@ -0,0 +1,102 @@
+// Copyright 2018 AtomicSwap Solutions Ltd. All rights reserved.
+// Use of this source code is governed by Microsoft Reference Source
+// License (MS-RSL) that can be found in the LICENSE file.
+
+#include "jsonreaderbenchmark.h"
+#include <QTest>
+#include <QFile>
+#include "benchmarkdb.h"
+#include "documentparser.h"
+#include "request.h"
+
+Q_DECLARE_METATYPE(QList<QByteArray>)
+
+namespace {
+    QByteArray initRequest(int addrsCount)
+    {
+        QByteArray request = "{\"command\": \"init\", \"curs\": [{\"cur\": \"BTC\", \"addrs\": [";
+        for (int i = 0; i < addrsCount; ++i) {
+            if (i != 0) {
+                request += ", ";
+            }
+            request += "\"mtG7w1Sg4gMnS5b1PqKz8F3jh2R" + QByteArray::number(i) + "\"";
+        }
+        request += "]}], \"protocol\": \"json\", \"epoch\": 1539820800000, \"lastSeq\": 1000}";
+        return request;
+    }
+
+    void addRequestRows()
+    {
+        QTest::addColumn<QList<QByteArray>>("requests");
+
+        OrderInfoPtr order = BenchmarkDB::makeOrder(1);
+        TradeInfoPtr trade = BenchmarkDB::makeTrade(1, order);
+
+        QTest::newRow("init, 10 addrs") << QList<QByteArray>{initRequest(10)};
+        QTest::newRow("init, 500 addrs") << QList<QByteArray>{initRequest(500)};
+        QTest::newRow("create_order") << QList<QByteArray>{"{\"command\": \"create_order\", \"key\": \"key1\", \"order\": " + order->getJson() + "}"};
+        QTest::newRow("create_trade") << QList<QByteArray>{"{\"command\": \"create_trade\", \"key\": \"key1\", \"orderId\": 1, \"address\": \"n4Vq7k1XoYt2T6UkZb8hP3cS9d1\"}"};
+        QTest::newRow("update_trade") << QList<QByteArray>{"{\"command\": \"update_trade\", \"key\": \"key1\", \"trade\": " + trade->getJson() + "}"};
+
+        QByteArray path = qgetenv("ATOM_ENGINE_CAPTURED_REQUESTS");
+        if (path.isEmpty()) {
+            return;
+        }
+        QFile file(QString::fromLocal8Bit(path));
+        if (!file.open(QIODevice::ReadOnly)) {
+            qWarning().noquote() << "Can't open captured requests " + QString::fromLocal8Bit(path);
+            return;
+        }
+        QList<QByteArray> captured;
+        for (const QByteArray& line : file.readAll().split('\n')) {
+            if (!line.trimmed().isEmpty()) {
+                captured.append(line);
+            }
+        }
+        QTest::newRow("captured") << captured;
+    }
+}
+
+void JsonReaderBenchmark::document_data()
+{
+    addRequestRows();
+}
+
+void JsonReaderBenchmark::document()
+{
+    QFETCH(QList<QByteArray>, requests);
+
+    int parsed = 0;
+    QBENCHMARK {
+        parsed = 0;
+        for (const QByteArray& json : requests) {
+            Request request;
+            if (DocumentParser::parse(json, request)) {
+                parsed += request.command != Commands::Unknown;
+            }
+        }
+    }
+    QVERIFY(parsed > 0);
+}
+
+void JsonReaderBenchmark::jsonReader_data()
+{
+    addRequestRows();
+}
+
+void JsonReaderBenchmark::jsonReader()
+{
+    QFETCH(QList<QByteArray>, requests);
+
+    int parsed = 0;
+    QBENCHMARK {
+        parsed = 0;
+        for (const QByteArray& json : requests) {
+            Request request;
+            if (RequestParser::parse(json, request)) {
+                parsed += request.command != Commands::Unknown;
+            }
+        }
+    }
+    QVERIFY(parsed > 0);
+}
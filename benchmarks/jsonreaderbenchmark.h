@@ -0,0 +1,25 @@
+// Copyright 2018 AtomicSwap Solutions Ltd. All rights reserved.
+// Use of this source code is governed by Microsoft Reference Source
+// License (MS-RSL) that can be found in the LICENSE file.
+
+#ifndef JSONREADERBENCHMARK_H
+#define JSONREADERBENCHMARK_H
+
+#include <QObject>
+
+// Parsing requests into the fields the engine uses: the old path built a
+// QJsonDocument and read the fields from its objects, RequestParser reads them
+// with JsonReader in one pass. The rows are typical commands, an init with
+// many addresses and, when ATOM_ENGINE_CAPTURED_REQUESTS names a file with one
+// JSON request per line, the captured traffic in it.
+class JsonReaderBenchmark : public QObject
+{
+    Q_OBJECT
+private slots:
+    void document_data();
+    void document();
+    void jsonReader_data();
+    void jsonReader();
+};
+
+#endif // JSONREADERBENCHMARK_H
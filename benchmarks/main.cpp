@@ -0,0 +1,49 @@
+// Copyright 2018 AtomicSwap Solutions Ltd. All rights reserved.
+// Use of this source code is governed by Microsoft Reference Source
+// License (MS-RSL) that can be found in the LICENSE file.
+
+#include <QCoreApplication>
+#include <QTest>
+#include "broadcastbenchmark.h"
+#include "dbwritebenchmark.h"
+#include "framingbenchmark.h"
+#include "jsonreaderbenchmark.h"
+#include "memorybenchmark.h"
+#include "serializationbenchmark.h"
+#include "statementbenchmark.h"
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+
+    int status = 0;
+    {
+        BroadcastBenchmark benchmark;
+        status |= QTest::qExec(&benchmark, argc, argv);
+    }
+    {
+        DBWriteBenchmark benchmark;
+        status |= QTest::qExec(&benchmark, argc, argv);
+    }
+    {
+        FramingBenchmark benchmark;
+        status |= QTest::qExec(&benchmark, argc, argv);
+    }
+    {
+        JsonReaderBenchmark benchmark;
+        status |= QTest::qExec(&benchmark, argc, argv);
+    }
+    {
+        MemoryBenchmark benchmark;
+        status |= QTest::qExec(&benchmark, argc, argv);
+    }
+    {
+        SerializationBenchmark benchmark;
+        status |= QTest::qExec(&benchmark, argc, argv);
+    }
+    {
+        StatementBenchmark benchmark;
+        status |= QTest::qExec(&benchmark, argc, argv);
+    }
+    return status;
+}
@@ -0,0 +1,193 @@
+// Copyright 2018 AtomicSwap Solutions Ltd. All rights reserved.
+// Use of this source code is governed by Microsoft Reference Source
+// License (MS-RSL) that can be found in the LICENSE file.
+
+#include "memorybenchmark.h"
+#include <QTest>
+#include <QCryptographicHash>
+#include <map>
+#include <memory>
+#include "benchmarkdb.h"
+#include "info.h"
+#include "slabpool.h"
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+namespace {
+    const int recordsCount = 100000;
+
+    // the layout of OrderInfo and TradeInfo before the pools
+    struct QStringOrder {
+        long long orderId_;
+        QString sendCur_;
+        long long sendCount_;
+        QString getCur_;
+        long long getCount_;
+        QString getAddress_;
+        QString keyHash_;
+        QByteArray json_;
+    };
+
+    struct QStringTrade {
+        long long tradeId_;
+        std::shared_ptr<QStringOrder> order_;
+        QString initiatorAddress_;
+        QString secretHash_;
+        QString contractInitiator_;
+        QString contractParticipant_;
+        QString initiatorContractTransaction_;
+        QString participantContractTransaction_;
+        QString initiatorRedemptionTransaction_;
+        QString participantRedemptionTransaction_;
+        bool initiatorCommissionPaid_;
+        bool participantCommissionPaid_;
+        bool refundedInit_;
+        bool refundedPart_;
+        long long refundTimeInit_;
+        long long refundTimePart_;
+        QString keyHash_;
+        QByteArray json_;
+    };
+
+    bool canMeasure()
+    {
+#if defined(__GLIBC__)
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    // bytes malloc handed out, with the chunk headers
+    long long heapBytes()
+    {
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+        struct mallinfo2 info = mallinfo2();
+        return (long long)info.uordblks + (long long)info.hblkhd;
+#elif defined(__GLIBC__)
+        struct mallinfo info = mallinfo();
+        return (long long)(unsigned)info.uordblks + (long long)(unsigned)info.hblkhd;
+#else
+        return 0;
+#endif
+    }
+
+    // pool slots freed by earlier benchmarks are reused without new heap, so the
+    // records are counted by the pool slots they take instead of by slab growth
+    long long recordBytes()
+    {
+        return heapBytes() - SlabPools::slabBytes() + SlabPools::usedBytes();
+    }
+
+    // the fields of BenchmarkDB::makeOrder() in the previous layout
+    QString hexHash(const QString& key)
+    {
+        return QString(QCryptographicHash::hash(key.toUtf8(), QCryptographicHash::Md5).toHex());
+    }
+
+    std::shared_ptr<QStringOrder> makeQStringOrder(long long id)
+    {
+        std::shared_ptr<QStringOrder> order = std::make_shared<QStringOrder>();
+        order->orderId_ = id;
+        order->sendCur_ = QString::fromUtf8("BTC");
+        order->sendCount_ = 100000000 + id;
+        order->getCur_ = QString::fromUtf8("LTC");
+        order->getCount_ = 6000000000 + id;
+        order->getAddress_ = BenchmarkDB::orderAddressPrefix + QString::number(id);
+        order->keyHash_ = hexHash("key" + QString::number(id));
+        return order;
+    }
+
+    OrderInfoPtr makeCompactOrder(long long id)
+    {
+        return BenchmarkDB::makeOrder(id);
+    }
+
+    // the fields of BenchmarkDB::makeTrade() in the previous layout
+    std::shared_ptr<QStringTrade> makeQStringTrade(long long id)
+    {
+        std::shared_ptr<QStringTrade> trade = std::make_shared<QStringTrade>();
+        trade->tradeId_ = id;
+        trade->order_ = makeQStringOrder(id);
+        trade->initiatorAddress_ = BenchmarkDB::tradeAddressPrefix + QString::number(id);
+        trade->secretHash_ = QString::fromUtf8(BenchmarkDB::secretHash);
+        trade->contractInitiator_ = QString::fromUtf8(BenchmarkDB::contract);
+        trade->contractParticipant_ = QString::fromUtf8(BenchmarkDB::contract);
+        trade->initiatorContractTransaction_ = QString::fromUtf8(BenchmarkDB::transaction);
+        trade->participantContractTransaction_ = QString::fromUtf8(BenchmarkDB::transaction);
+        trade->initiatorCommissionPaid_ = true;
+        trade->participantCommissionPaid_ = true;
+        trade->refundedInit_ = false;
+        trade->refundedPart_ = false;
+        trade->refundTimeInit_ = 1530000000 + id;
+        trade->refundTimePart_ = 1530000000 + id;
+        trade->keyHash_ = hexHash("key" + QString::number(id));
+        return trade;
+    }
+
+    TradeInfoPtr makeCompactTrade(long long id)
+    {
+        return BenchmarkDB::makeTrade(id, BenchmarkDB::makeOrder(id));
+    }
+
+    // reports the heap bytes of one record with its map node
+    template<class Ptr>
+    void measure(Ptr (*make)(long long))
+    {
+        std::map<long long, Ptr> records;
+        long long before = recordBytes();
+        for (long long id = 1; id <= recordsCount; ++id) {
+            records.emplace_hint(records.end(), id, make(id));
+        }
+        long long bytes = recordBytes() - before;
+        QCOMPARE(int(records.size()), recordsCount);
+        QTest::setBenchmarkResult(qreal(bytes) / recordsCount, QTest::BytesAllocated);
+    }
+
+    void addLayoutRows()
+    {
+        QTest::addColumn<bool>("compact");
+
+        QTest::newRow("qstring") << false;
+        QTest::newRow("compact") << true;
+    }
+}
+
+void MemoryBenchmark::bytesPerOrder_data()
+{
+    addLayoutRows();
+}
+
+void MemoryBenchmark::bytesPerOrder()
+{
+    QFETCH(bool, compact);
+
+    if (!canMeasure()) {
+        QSKIP("Heap usage is measured with glibc malloc statistics only");
+    }
+    if (compact) {
+        measure(&makeCompactOrder);
+    } else {
+        measure(&makeQStringOrder);
+    }
+}
+
+void MemoryBenchmark::bytesPerTrade_data()
+{
+    addLayoutRows();
+}
+
+void MemoryBenchmark::bytesPerTrade()
+{
+    QFETCH(bool, compact);
+
+    if (!canMeasure()) {
+        QSKIP("Heap usage is measured with glibc malloc statistics only");
+    }
+    if (compact) {
+        measure(&makeCompactTrade);
+    } else {
+        measure(&makeQStringTrade);
+    }
+}
@@ -0,0 +1,27 @@
+// Copyright 2018 AtomicSwap Solutions Ltd. All rights reserved.
+// Use of this source code is governed by Microsoft Reference Source
+// License (MS-RSL) that can be found in the LICENSE file.
+
+#ifndef MEMORYBENCHMARK_H
+#define MEMORYBENCHMARK_H
+
+#include <QObject>
+
+// Heap bytes per order and per trade held in a map like the engine holds
+// them, with the fields a client request fills in. The "qstring" rows are the
+// previous layout: make_shared records, UTF-16 text for every field and the
+// key hash as hex. The "compact" rows are OrderInfo and TradeInfo: records
+// from slab pools, currency codes as two byte indexes of a shared table, UTF-8
+// hashes and transaction ids and a 16 byte key digest. Measured with glibc's malloc statistics, other
+// C libraries skip the benchmark.
+class MemoryBenchmark : public QObject
+{
+    Q_OBJECT
+private slots:
+    void bytesPerOrder_data();
+    void bytesPerOrder();
+    void bytesPerTrade_data();
+    void bytesPerTrade();
+};
+
+#endif // MEMORYBENCHMARK_H
@@ -0,0 +1,149 @@
+// Copyright 2018 AtomicSwap Solutions Ltd. All rights reserved.
+// Use of this source code is governed by Microsoft Reference Source
+// License (MS-RSL) that can be found in the LICENSE file.
+
+#include "serializationbenchmark.h"
+#include <QTest>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QStringList>
+#include "benchmarkdb.h"
+#include "commands.h"
+
+namespace {
+    void addCacheRows()
+    {
+        QTest::addColumn<bool>("cached");
+
+        QTest::newRow("built") << false;
+        QTest::newRow("cached") << true;
+    }
+}
+
+void SerializationBenchmark::orderGetJson_data()
+{
+    addCacheRows();
+}
+
+void SerializationBenchmark::orderGetJson()
+{
+    QFETCH(bool, cached);
+
+    OrderInfoPtr order = BenchmarkDB::makeOrder(1);
+    int size = 0;
+    QBENCHMARK {
+        if (!cached) {
+            order->invalidateJson();
+        }
+        size += order->getJson().size();
+    }
+    QVERIFY(size > 0);
+}
+
+void SerializationBenchmark::tradeGetJson_data()
+{
+    addCacheRows();
+}
+
+void SerializationBenchmark::tradeGetJson()
+{
+    QFETCH(bool, cached);
+
+    TradeInfoPtr trade = BenchmarkDB::makeTrade(1, BenchmarkDB::makeOrder(1));
+    int size = 0;
+    QBENCHMARK {
+        if (!cached) {
+            // the order keeps its copy, like after update_trade
+            trade->invalidateJson();
+        }
+        size += trade->getJson().size();
+    }
+    QVERIFY(size > 0);
+}
+
+void SerializationBenchmark::parseCommand_data()
+{
+    QTest::addColumn<QByteArray>("command");
+
+    OrderInfoPtr order = BenchmarkDB::makeOrder(1);
+    TradeInfoPtr trade = BenchmarkDB::makeTrade(1, order);
+
+    QTest::newRow("init") << QByteArray("{\"command\": \"init\", \"curs\": [{\"cur\": \"BTC\", \"addrs\": [\"mtG7w1Sg4gMnS5b1PqKz8F3jh2R1\", \"mtG7w1Sg4gMnS5b1PqKz8F3jh2R2\"]}, " \
+                                        "{\"cur\": \"LTC\", \"addrs\": [\"n4Vq7k1XoYt2T6UkZb8hP3cS9d1\"]}]}");
+    QTest::newRow("create_order") << "{\"command\": \"create_order\", \"key\": \"key1\", \"order\": " + order->getJson() + "}";
+    QTest::newRow("create_trade") << QByteArray("{\"command\": \"create_trade\", \"key\": \"key1\", \"orderId\": 1, \"address\": \"n4Vq7k1XoYt2T6UkZb8hP3cS9d1\"}");
+    QTest::newRow("update_trade") << "{\"command\": \"update_trade\", \"key\": \"key1\", \"trade\": " + trade->getJson() + "}";
+}
+
+void SerializationBenchmark::parseCommand()
+{
+    QFETCH(QByteArray, command);
+
+    bool parsed = true;
+    QBENCHMARK {
+        QJsonDocument doc = QJsonDocument::fromJson(command);
+        // the engine reads the command name first
+        parsed = parsed && doc.isObject() && !doc.object()["command"].toString().isEmpty();
+    }
+    QVERIFY(parsed);
+}
+
+void SerializationBenchmark::findCommand_data()
+{
+    QTest::addColumn<bool>("perfectHash");
+
+    QTest::newRow("string compares") << false;
+    QTest::newRow("perfect hash") << true;
+}
+
+void SerializationBenchmark::findCommand()
+{
+    QFETCH(bool, perfectHash);
+
+    // the order of the old if chain in the engine
+    const QStringList names = {"init", "request_swap_commission", "create_order", "delete_order", "get_orders",
+                               "subscribe", "unsubscribe", "create_trade", "update_trade", "get_trades"};
+    int found = 0;
+    QBENCHMARK {
+        found = 0;
+        for (const QString& name : names) {
+            if (perfectHash) {
+                found += Commands::find(name) != Commands::Unknown;
+            } else {
+                for (int command = Commands::Unknown + 1; command < Commands::Count; ++command) {
+                    if (name == Commands::name(Commands::Command(command))) {
+                        ++found;
+                    }
+                }
+            }
+        }
+    }
+    QCOMPARE(found, names.size() - 1);
+}
+
+void SerializationBenchmark::checkKey_data()
+{
+    QTest::addColumn<bool>("trade");
+    QTest::addColumn<QString>("key");
+    QTest::addColumn<bool>("valid");
+
+    QTest::newRow("order, valid key") << false << QString("key1") << true;
+    QTest::newRow("order, wrong key") << false << QString("key2") << false;
+    QTest::newRow("trade, valid key") << true << QString("key1") << true;
+    QTest::newRow("trade, wrong key") << true << QString("key2") << false;
+}
+
+void SerializationBenchmark::checkKey()
+{
+    QFETCH(bool, trade);
+    QFETCH(QString, key);
+    QFETCH(bool, valid);
+
+    OrderInfoPtr orderInfo = BenchmarkDB::makeOrder(1);
+    TradeInfoPtr tradeInfo = BenchmarkDB::makeTrade(1, orderInfo);
+    bool checked = valid;
+    QBENCHMARK {
+        checked = trade ? tradeInfo->checkKey(key) : orderInfo->checkKey(key);
+    }
+    QCOMPARE(checked, valid);
+}
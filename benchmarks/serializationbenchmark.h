@@ -0,0 +1,30 @@
+// Copyright 2018 AtomicSwap Solutions Ltd. All rights reserved.
+// Use of this source code is governed by Microsoft Reference Source
+// License (MS-RSL) that can be found in the LICENSE file.
+
+#ifndef SERIALIZATIONBENCHMARK_H
+#define SERIALIZATIONBENCHMARK_H
+
+#include <QObject>
+
+// Per-request CPU work outside the database: building the JSON of orders and
+// trades (cold, and from the cached copy), parsing typical commands with
+// QJsonDocument, finding the command of a request and checking the MD5 key
+// hash of an order or trade.
+class SerializationBenchmark : public QObject
+{
+    Q_OBJECT
+private slots:
+    void orderGetJson_data();
+    void orderGetJson();
+    void tradeGetJson_data();
+    void tradeGetJson();
+    void parseCommand_data();
+    void parseCommand();
+    void findCommand_data();
+    void findCommand();
+    void checkKey_data();
+    void checkKey();
+};
+
+#endif // SERIALIZATIONBENCHMARK_H
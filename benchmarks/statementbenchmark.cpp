@@ -0,0 +1,132 @@
+// Copyright 2018 AtomicSwap Solutions Ltd. All rights reserved.
+// Use of this source code is governed by Microsoft Reference Source
+// License (MS-RSL) that can be found in the LICENSE file.
+
+#include "statementbenchmark.h"
+#include <QTest>
+#include <QElapsedTimer>
+#include <vector>
+#include "benchmarkdb.h"
+#include "dbwriter.h"
+
+namespace {
+    const QString connectionName = "statement benchmark";
+    const int rowsCount = 5000;
+
+    DBMutation mutation(DBMutation::Type type, long long id)
+    {
+        DBMutation mutation;
+        mutation.type = type;
+        mutation.id = id;
+        switch (type) {
+        case DBMutation::AddOrder:
+            mutation.order = BenchmarkDB::makeOrder(id);
+            break;
+        case DBMutation::AddTrade:
+        case DBMutation::UpdateTrade:
+            mutation.trade = BenchmarkDB::makeTrade(id, BenchmarkDB::makeOrder(id));
+            break;
+        case DBMutation::AddToBlackList:
+        case DBMutation::RemoveFromBlackList:
+            mutation.ip = "10.0." + QString::number(id / 256 % 256) + "." + QString::number(id % 256);
+            mutation.id = 0;
+            break;
+        default:
+            break;
+        }
+        return mutation;
+    }
+
+    // the rows a statement which updates or deletes works on
+    DBMutation::Type setupType(DBMutation::Type type)
+    {
+        switch (type) {
+        case DBMutation::DeleteOrder:
+            return DBMutation::AddOrder;
+        case DBMutation::DeleteTrade:
+        case DBMutation::UpdateTrade:
+            return DBMutation::AddTrade;
+        case DBMutation::RemoveFromBlackList:
+            return DBMutation::AddToBlackList;
+        default:
+            return type;
+        }
+    }
+}
+
+Q_DECLARE_METATYPE(DBMutation::Type)
+
+void StatementBenchmark::statement_data()
+{
+    QTest::addColumn<bool>("inMemory");
+    QTest::addColumn<DBMutation::Type>("type");
+
+    const std::vector<std::pair<const char*, DBMutation::Type>> statements = {
+        {"addToOrders", DBMutation::AddOrder},
+        {"deleteFromOrders", DBMutation::DeleteOrder},
+        {"addToTrades", DBMutation::AddTrade},
+        {"updateTrade", DBMutation::UpdateTrade},
+        {"deleteFromTrades", DBMutation::DeleteTrade},
+        {"addToBL", DBMutation::AddToBlackList},
+        {"deleteFromBL", DBMutation::RemoveFromBlackList}
+    };
+    for (int inMemory = 1; inMemory >= 0; --inMemory) {
+        for (const auto& statement : statements) {
+            QString name = QString(statement.first) + (inMemory ? ", memory" : ", disk WAL NORMAL");
+            QTest::newRow(name.toUtf8().constData()) << bool(inMemory) << statement.second;
+        }
+    }
+}
+
+void StatementBenchmark::statement()
+{
+    QFETCH(bool, inMemory);
+    QFETCH(DBMutation::Type, type);
+
+    DBSettings settings;
+    settings.name = inMemory ? QString(":memory:") : BenchmarkDB::create("atom-engine-statement-benchmark.db");
+
+    // built before timing, so that only binding and executing is measured
+    DBMutations setup;
+    DBMutations mutations;
+    for (long long id = 1; id <= rowsCount; ++id) {
+        if (setupType(type) != type) {
+            setup.push_back(mutation(setupType(type), id));
+        }
+        mutations.push_back(mutation(type, id));
+    }
+
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", connectionName);
+        db.setDatabaseName(settings.name);
+        QVERIFY(db.open());
+        if (inMemory) {
+            BenchmarkDB::createSchema(db);
+        }
+        DBWriter::configure(db, settings);
+
+        {
+            DBStatements statements(db);
+            db.transaction();
+            for (const DBMutation& setupMutation : setup) {
+                statements.apply(setupMutation);
+            }
+            QVERIFY(db.commit());
+
+            QElapsedTimer timer;
+            timer.start();
+            db.transaction();
+            for (const DBMutation& benchmarkMutation : mutations) {
+                statements.apply(benchmarkMutation);
+            }
+            QVERIFY(db.commit());
+            // the time of one statement, with its share of the commit
+            QTest::setBenchmarkResult(qreal(timer.nsecsElapsed()) / rowsCount, QTest::WalltimeNanoseconds);
+        }
+        db.close();
+    }
+    QSqlDatabase::removeDatabase(connectionName);
+    if (!inMemory) {
+        BenchmarkDB::remove(settings.name);
+    }
+}
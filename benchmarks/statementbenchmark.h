@@ -0,0 +1,21 @@
+// Copyright 2018 AtomicSwap Solutions Ltd. All rights reserved.
+// Use of this source code is governed by Microsoft Reference Source
+// License (MS-RSL) that can be found in the LICENSE file.
+
+#ifndef STATEMENTBENCHMARK_H
+#define STATEMENTBENCHMARK_H
+
+#include <QObject>
+
+// Cost of every prepared statement of DBWriter on its own, in one transaction
+// so that commits do not dominate, against an in-memory and an on-disk
+// database. Commit cost is measured by DBWriteBenchmark.
+class StatementBenchmark : public QObject
+{
+    Q_OBJECT
+private slots:
+    void statement_data();
+    void statement();
+};
+
+#endif // STATEMENTBENCHMARK_H
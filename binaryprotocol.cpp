@@ -0,0 +1,393 @@
+// Copyright 2018 AtomicSwap Solutions Ltd. All rights reserved.
+// Use of this source code is governed by Microsoft Reference Source
+// License (MS-RSL) that can be found in the LICENSE file.
+
+#include "binaryprotocol.h"
+#include "info.h"
+#include "request.h"
+#include <QtEndian>
+#include <cstring>
+
+namespace BinaryProtocol
+{
+    namespace {
+        const int sizeLength = 4;
+        const int typeLength = 2;
+
+        const char* commandName(int type)
+        {
+            switch (type) {
+            case CreateOrder: return "create_order";
+            case DeleteOrder: return "delete_order";
+            case CreateTrade: return "create_trade";
+            case UpdateTrade: return "update_trade";
+            default: return nullptr;
+            }
+        }
+
+        // a nested message is an order or a trade of the request, deeper messages are rejected
+        const int maxMessageDepth = 1;
+
+        // Walks the fields of a message. The value of a field is checked against
+        // the size of the message before it is taken, an unknown field is skipped
+        // by its size without looking into it. A message nested deeper than
+        // maxMessageDepth fails the frame, so a client cannot make the decoder
+        // recurse without bound.
+        class FieldReader
+        {
+        public:
+            FieldReader(const uchar* data, quint32 size, int depth) :
+                data_(data),
+                size_(size),
+                pos_(0),
+                depth_(depth),
+                error_(false),
+                field_(0),
+                wire_(Int),
+                value_(nullptr),
+                length_(0)
+            {
+            }
+
+            // false at the end of the message and on a malformed field
+            bool next()
+            {
+                if (error_ || pos_ == size_) {
+                    return false;
+                }
+                int tag = data_[pos_++];
+                field_ = tag >> 2;
+                wire_ = tag & 3;
+                switch (wire_) {
+                case Int:
+                    length_ = 8;
+                    break;
+                case Bool:
+                    length_ = 1;
+                    break;
+                default:
+                    if (wire_ == Message && depth_ == maxMessageDepth) {
+                        return fail();
+                    }
+                    if (size_ - pos_ < 4) {
+                        return fail();
+                    }
+                    length_ = qFromBigEndian<quint32>(data_ + pos_);
+                    pos_ += 4;
+                    break;
+                }
+                if (size_ - pos_ < length_) {
+                    return fail();
+                }
+                value_ = data_ + pos_;
+                pos_ += length_;
+                return true;
+            }
+
+            int field() const { return field_; }
+            bool hasError() const { return error_; }
+
+            // a value of another type converts like the same value in a JSON request
+            qint64 toInt() const
+            {
+                switch (wire_) {
+                case Int: return qFromBigEndian<qint64>(value_);
+                case Bool: return value_[0] != 0 ? 1 : 0;
+                case Bytes: return toString().toLongLong();
+                default: return 0;
+                }
+            }
+            bool toBool() const
+            {
+                return wire_ == Bool && value_[0] != 0;
+            }
+            QString toString() const
+            {
+                return wire_ == Bytes ? QString::fromUtf8(reinterpret_cast<const char*>(value_), int(length_)) : QString();
+            }
+            // the fields of a Message value, a value of another type has none
+            FieldReader nested() const
+            {
+                return FieldReader(value_, wire_ == Message ? length_ : 0, depth_ + 1);
+            }
+        private:
+            bool fail()
+            {
+                error_ = true;
+                return false;
+            }
+        private:
+            const uchar* data_;
+            quint32 size_;
+            quint32 pos_;
+            int depth_;
+            bool error_;
+            int field_;
+            int wire_;
+            const uchar* value_;
+            quint32 length_;
+        };
+
+        bool readOrder(FieldReader& reader, OrderInfo& order, Request& request)
+        {
+            while (reader.next()) {
+                switch (reader.field()) {
+                case SendCur: request.orderSendCur = reader.toString(); break;
+                case GetCur: request.orderGetCur = reader.toString(); break;
+                case SendCount: order.sendCount_ = reader.toInt(); break;
+                case GetCount: order.getCount_ = reader.toInt(); break;
+                case GetAddr: order.getAddress_ = reader.toString(); break;
+                default: break;
+                }
+            }
+            return !reader.hasError();
+        }
+
+        bool readTrade(FieldReader& reader, TradeUpdate& trade)
+        {
+            while (reader.next()) {
+                switch (reader.field()) {
+                case Id: trade.id = reader.toInt(); break;
+                case SecretHash: trade.secretHash = reader.toString(); break;
+                case ContractInitiator: trade.contractInitiator = reader.toString(); break;
+                case ContractParticipant: trade.contractParticipant = reader.toString(); break;
+                case InitiatorContractTransaction: trade.initiatorContractTransaction = reader.toString(); break;
+                case ParticipantContractTransaction: trade.participantContractTransaction = reader.toString(); break;
+                case InitiatorRedemptionTransaction: trade.initiatorRedemptionTransaction = reader.toString(); break;
+                case ParticipantRedemptionTransaction: trade.participantRedemptionTransaction = reader.toString(); break;
+                case CommissionInitiatorPaid: trade.commissionInitiatorPaid = reader.toBool(); break;
+                case CommissionParticipantPaid: trade.commissionParticipantPaid = reader.toBool(); break;
+                case RefundedInit:
+                    trade.hasRefundedInit = true;
+                    trade.refundedInit = reader.toBool();
+                    break;
+                case RefundedPart:
+                    trade.hasRefundedPart = true;
+                    trade.refundedPart = reader.toBool();
+                    break;
+                case RefundTimeInit:
+                    trade.hasRefundTimeInit = true;
+                    trade.refundTimeInit = reader.toInt();
+                    break;
+                case RefundTimePart:
+                    trade.hasRefundTimePart = true;
+                    trade.refundTimePart = reader.toInt();
+                    break;
+                default:
+                    // added by a newer client
+                    break;
+                }
+            }
+            return !reader.hasError();
+        }
+
+        bool readRequest(FieldReader& reader, Request& request)
+        {
+            while (reader.next()) {
+                switch (reader.field()) {
+                case Key: request.key = reader.toString(); break;
+                case Id: request.id = reader.toInt(); break;
+                case OrderId: request.orderId = reader.toInt(); break;
+                case Address: request.address = reader.toString(); break;
+                case Addrs: request.addrs.push_back(reader.toString()); break;
+                case Order: {
+                    request.order = OrderInfo::create();
+                    request.order->orderId_ = 0;
+                    request.order->sendCount_ = 0;
+                    request.order->getCount_ = 0;
+                    FieldReader nested = reader.nested();
+                    if (!readOrder(nested, *request.order, request)) {
+                        return false;
+                    }
+                    break;
+                }
+                case Trade: {
+                    FieldReader nested = reader.nested();
+                    if (!readTrade(nested, request.trade)) {
+                        return false;
+                    }
+                    break;
+                }
+                default:
+                    // added by a newer client
+                    break;
+                }
+            }
+            return !reader.hasError();
+        }
+    }
+
+    Writer::Writer(MessageType type)
+    {
+        data_.reserve(64);
+        data_.resize(sizeLength + typeLength);
+        qToBigEndian<quint16>(type, reinterpret_cast<uchar*>(data_.data() + sizeLength));
+    }
+
+    void Writer::addTag(Field field, WireType wire)
+    {
+        data_.append(char(field << 2 | wire));
+    }
+
+    void Writer::addSize(quint32 size)
+    {
+        uchar bytes[4];
+        qToBigEndian<quint32>(size, bytes);
+        data_.append(reinterpret_cast<const char*>(bytes), 4);
+    }
+
+    void Writer::addInt(Field field, qint64 value)
+    {
+        addTag(field, Int);
+        uchar bytes[8];
+        qToBigEndian<qint64>(value, bytes);
+        data_.append(reinterpret_cast<const char*>(bytes), 8);
+    }
+
+    void Writer::addBool(Field field, bool value)
+    {
+        addTag(field, Bool);
+        data_.append(char(value ? 1 : 0));
+    }
+
+    void Writer::addString(Field field, const QString& value)
+    {
+        addUtf8(field, value.toUtf8());
+    }
+
+    void Writer::addUtf8(Field field, const QByteArray& utf8)
+    {
+        addTag(field, Bytes);
+        addSize(utf8.size());
+        data_.append(utf8);
+    }
+
+    void Writer::beginMessage(Field field)
+    {
+        addTag(field, Message);
+        messageStarts_.push_back(data_.size());
+        // patched by endMessage()
+        addSize(0);
+    }
+
+    void Writer::endMessage()
+    {
+        int start = messageStarts_.back();
+        messageStarts_.pop_back();
+        qToBigEndian<quint32>(data_.size() - start - 4, reinterpret_cast<uchar*>(data_.data() + start));
+    }
+
+    void Writer::addOrder(Field field, const OrderInfo& order)
+    {
+        beginMessage(field);
+        addString(SendCur, order.sendCur_.toString());
+        addString(GetCur, order.getCur_.toString());
+        addInt(SendCount, order.sendCount_);
+        addInt(GetCount, order.getCount_);
+        addString(GetAddr, order.getAddress_);
+        addInt(Id, order.orderId_);
+        endMessage();
+    }
+
+    void Writer::addTrade(Field field, const TradeInfo& trade)
+    {
+        beginMessage(field);
+        addInt(Id, trade.tradeId_);
+        addBool(RefundedInit, trade.refundedInit_);
+        addBool(RefundedPart, trade.refundedPart_);
+        addInt(RefundTimeInit, trade.refundTimeInit_);
+        addInt(RefundTimePart, trade.refundTimePart_);
+        addOrder(Order, *trade.order_);
+        addString(InitiatorAddr, trade.initiatorAddress_);
+        addUtf8(SecretHash, trade.secretHash_.utf8());
+        addUtf8(ContractInitiator, trade.contractInitiator_.utf8());
+        addUtf8(ContractParticipant, trade.contractParticipant_.utf8());
+        addUtf8(InitiatorContractTransaction, trade.initiatorContractTransaction_.utf8());
+        addUtf8(ParticipantContractTransaction, trade.participantContractTransaction_.utf8());
+        addUtf8(InitiatorRedemptionTransaction, trade.initiatorRedemptionTransaction_.utf8());
+        addUtf8(ParticipantRedemptionTransaction, trade.participantRedemptionTransaction_.utf8());
+        addBool(CommissionInitiatorPaid, trade.initiatorCommissionPaid_);
+        addBool(CommissionParticipantPaid, trade.participantCommissionPaid_);
+        endMessage();
+    }
+
+    QByteArray Writer::finish()
+    {
+        qToBigEndian<quint32>(data_.size() - sizeLength, reinterpret_cast<uchar*>(data_.data()));
+        return data_;
+    }
+
+    QByteArray encodeOrder(MessageType type, const OrderInfo& order, long long seq)
+    {
+        Writer writer(type);
+        writer.addOrder(Order, order);
+        if (seq > 0) {
+            writer.addInt(Seq, seq);
+        }
+        return writer.finish();
+    }
+
+    QByteArray encodeTrade(MessageType type, const TradeInfo& trade, long long seq)
+    {
+        Writer writer(type);
+        writer.addTrade(Trade, trade);
+        if (seq > 0) {
+            writer.addInt(Seq, seq);
+        }
+        return writer.finish();
+    }
+
+    QByteArray encodeId(MessageType type, long long id, long long seq)
+    {
+        Writer writer(type);
+        writer.addInt(Id, id);
+        if (seq > 0) {
+            writer.addInt(Seq, seq);
+        }
+        return writer.finish();
+    }
+
+    QByteArray encodeEmpty(MessageType type, long long seq)
+    {
+        Writer writer(type);
+        if (seq > 0) {
+            writer.addInt(Seq, seq);
+        }
+        return writer.finish();
+    }
+
+    QByteArray encodeJson(const QByteArray& json)
+    {
+        int size = json.endsWith('\n') ? json.size() - 1 : json.size();
+        QByteArray frame;
+        frame.reserve(sizeLength + typeLength + size);
+        frame.resize(sizeLength + typeLength);
+        qToBigEndian<quint32>(typeLength + size, reinterpret_cast<uchar*>(frame.data()));
+        qToBigEndian<quint16>(Json, reinterpret_cast<uchar*>(frame.data() + sizeLength));
+        frame.append(json.constData(), size);
+        return frame;
+    }
+
+    bool decodeRequest(const QByteArray& payload, Request& request)
+    {
+        if (payload.size() < typeLength) {
+            return false;
+        }
+        const uchar* data = reinterpret_cast<const uchar*>(payload.constData());
+        int type = qFromBigEndian<quint16>(data);
+        if (type == Json) {
+            return RequestParser::parse(payload.mid(typeLength), request);
+        }
+
+        const char* command = commandName(type);
+        if (!command) {
+            return false;
+        }
+        FieldReader reader(data + typeLength, payload.size() - typeLength, 0);
+        if (!readRequest(reader, request)) {
+            return false;
+        }
+        request.command = Commands::find(command, int(std::strlen(command)));
+        return true;
+    }
+}
@@ -0,0 +1,134 @@
+// Copyright 2018 AtomicSwap Solutions Ltd. All rights reserved.
+// Use of this source code is governed by Microsoft Reference Source
+// License (MS-RSL) that can be found in the LICENSE file.
+
+#ifndef BINARYPROTOCOL_H
+#define BINARYPROTOCOL_H
+
+#include <QByteArray>
+#include <QString>
+#include <vector>
+
+struct OrderInfo;
+struct Request;
+struct TradeInfo;
+
+// Length-prefixed binary encoding which a client chooses by sending
+// "protocol": "binary" in its init request. The init request and its reply
+// are newline JSON, every message after them is a frame in both directions:
+//
+//   frame   = quint32 payload size, payload
+//   payload = quint16 message type, fields
+//   field   = quint8 (field id << 2 | wire type), value
+//
+// Numbers are big endian. Int is qint64, Bool is quint8, Bytes (UTF-8) and
+// Message (nested fields) are a quint32 size followed by the data, a request
+// nests one level (its order or trade) and deeper frames are rejected. Field and
+// message ids never change meaning, unknown fields are skipped, so both sides
+// can add fields without breaking the other. Commands and replies without a
+// binary schema are sent as Json frames holding the JSON text.
+namespace BinaryProtocol
+{
+    enum MessageType {
+        Json = 0,
+
+        // requests
+        CreateOrder = 1,
+        DeleteOrder = 2,
+        CreateTrade = 3,
+        UpdateTrade = 4,
+
+        // replies
+        CreateOrderSuccess = 101,
+        DeleteOrderSuccess = 102,
+        CreateTradeSuccess = 103,
+        CreateTradeFailed = 104,
+        UpdateTradeSuccess = 105,
+
+        // events
+        OrderCreated = 201,
+        OrderDeleted = 202,
+        TradeCreated = 203,
+        TradeUpdated = 204,
+        UsersConnected = 205,
+        UsersDisconnected = 206
+    };
+
+    enum WireType {
+        Int = 0,
+        Bool = 1,
+        Bytes = 2,
+        Message = 3
+    };
+
+    enum Field {
+        Key = 1,
+        Order = 2,
+        Id = 3,
+        OrderId = 4,
+        Address = 5,
+        Trade = 6,
+        Reason = 7,
+        // repeated
+        Addrs = 8,
+        Seq = 9,
+
+        SendCur = 16,
+        SendCount = 17,
+        GetCur = 18,
+        GetCount = 19,
+        GetAddr = 20,
+
+        InitiatorAddr = 32,
+        SecretHash = 33,
+        ContractInitiator = 34,
+        ContractParticipant = 35,
+        InitiatorContractTransaction = 36,
+        ParticipantContractTransaction = 37,
+        InitiatorRedemptionTransaction = 38,
+        ParticipantRedemptionTransaction = 39,
+        CommissionInitiatorPaid = 40,
+        CommissionParticipantPaid = 41,
+        RefundedInit = 42,
+        RefundedPart = 43,
+        RefundTimeInit = 44,
+        RefundTimePart = 45
+    };
+
+    class Writer
+    {
+    public:
+        explicit Writer(MessageType type);
+
+        void addInt(Field field, qint64 value);
+        void addBool(Field field, bool value);
+        void addString(Field field, const QString& value);
+        void addUtf8(Field field, const QByteArray& utf8);
+        void beginMessage(Field field);
+        void endMessage();
+        void addOrder(Field field, const OrderInfo& order);
+        void addTrade(Field field, const TradeInfo& trade);
+
+        // the complete frame
+        QByteArray finish();
+    private:
+        void addTag(Field field, WireType wire);
+        void addSize(quint32 size);
+    private:
+        QByteArray data_;
+        std::vector<int> messageStarts_;
+    };
+
+    // seq is the event sequence number, 0 leaves it out
+    QByteArray encodeOrder(MessageType type, const OrderInfo& order, long long seq = 0);
+    QByteArray encodeTrade(MessageType type, const TradeInfo& trade, long long seq = 0);
+    QByteArray encodeId(MessageType type, long long id, long long seq = 0);
+    QByteArray encodeEmpty(MessageType type, long long seq = 0);
+    // a JSON reply in a Json frame, the trailing '\n' is dropped
+    QByteArray encodeJson(const QByteArray& json);
+
+    // payload of a frame into the fields of its command, false when it is malformed
+    bool decodeRequest(const QByteArray& payload, Request& request);
+}
+
+#endif // BINARYPROTOCOL_H
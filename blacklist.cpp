@@ -0,0 +1,111 @@
+// Copyright 2018 AtomicSwap Solutions Ltd. All rights reserved.
+// Use of this source code is governed by Microsoft Reference Source
+// License (MS-RSL) that can be found in the LICENSE file.
+
+#include "blacklist.h"
+#include <QDateTime>
+#include <QPair>
+#include <functional>
+
+BlackList::BlackList()
+{
+}
+
+bool BlackList::parse(const QString& entry, IpKey& prefix, int& length)
+{
+    QHostAddress address;
+    if (entry.contains('/')) {
+        QPair<QHostAddress, int> subnet = QHostAddress::parseSubnet(entry);
+        address = subnet.first;
+        length = subnet.second;
+    } else {
+        address = QHostAddress(entry);
+        length = address.protocol() == QAbstractSocket::IPv4Protocol ? 32 : 128;
+    }
+    if (address.isNull() || length < 0) {
+        return false;
+    }
+    if (address.protocol() == QAbstractSocket::IPv4Protocol) {
+        // IPv4 lives in ::ffff:0:0/96
+        length += 96;
+    }
+    prefix = IpKey::fromAddress(address).prefix(length);
+    return true;
+}
+
+void BlackList::load(const BlackListEntries& entries)
+{
+    QWriteLocker locker(&lock_);
+    entries_.clear();
+    tables_.clear();
+    for (auto it = entries.begin(); it != entries.end(); ++it) {
+        insert(it->first, it->second);
+    }
+}
+
+bool BlackList::add(const QString& entry, long long expiresAt)
+{
+    QWriteLocker locker(&lock_);
+    return insert(entry, expiresAt);
+}
+
+bool BlackList::insert(const QString& entry, long long expiresAt)
+{
+    IpKey prefix;
+    int length;
+    if (!parse(entry, prefix, length)) {
+        return false;
+    }
+    entries_[entry] = expiresAt;
+    tables_[length][prefix] = expiresAt;
+    return true;
+}
+
+void BlackList::removeExpired(long long now, std::vector<QString>& expired)
+{
+    QWriteLocker locker(&lock_);
+    for (auto it = entries_.begin(); it != entries_.end();) {
+        if (it->second == 0 || it->second > now) {
+            ++it;
+            continue;
+        }
+        IpKey prefix;
+        int length;
+        if (parse(it->first, prefix, length)) {
+            auto itTable = tables_.find(length);
+            if (itTable != tables_.end()) {
+                auto itPrefix = itTable->second.find(prefix);
+                // another spelling of the same range may have renewed the slot
+                if (itPrefix != itTable->second.end() && itPrefix->second == it->second) {
+                    itTable->second.erase(itPrefix);
+                    if (itTable->second.empty()) {
+                        tables_.erase(itTable);
+                    }
+                }
+            }
+        }
+        expired.push_back(it->first);
+        it = entries_.erase(it);
+    }
+}
+
+bool BlackList::contains(const IpKey& key) const
+{
+    QReadLocker locker(&lock_);
+    for (auto it = tables_.begin(); it != tables_.end(); ++it) {
+        auto itPrefix = it->second.find(key.prefix(it->first));
+        if (itPrefix != it->second.end()) {
+            long long expiresAt = itPrefix->second;
+            if (expiresAt == 0 || expiresAt > QDateTime::currentMSecsSinceEpoch() / 1000) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+size_t BlackList::size() const
+{
+    QReadLocker locker(&lock_);
+    return entries_.size();
+}
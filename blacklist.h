@@ -0,0 +1,50 @@
+// Copyright 2018 AtomicSwap Solutions Ltd. All rights reserved.
+// Use of this source code is governed by Microsoft Reference Source
+// License (MS-RSL) that can be found in the LICENSE file.
+
+#ifndef BLACKLIST_H
+#define BLACKLIST_H
+
+#include <QReadWriteLock>
+#include <QString>
+#include <map>
+#include <unordered_map>
+#include <vector>
+#include "ipkey.h"
+
+// entry -> expiry time in seconds since epoch, 0 never expires
+using BlackListEntries = std::map<QString, long long>;
+
+// Blocked addresses and ranges: "1.2.3.4", "10.0.0.0/8", "2001:db8::/32".
+// Entries are kept by prefix length, a lookup masks the address once per
+// length which is in use and probes a hash table, so it costs a few hash
+// lookups however many entries there are. The list is changed by the engine
+// and read by any thread.
+class BlackList
+{
+public:
+    BlackList();
+
+    // false when the entry is not an address or a range
+    static bool parse(const QString& entry, IpKey& prefix, int& length);
+
+    void load(const BlackListEntries& entries);
+    // false when the entry does not parse
+    bool add(const QString& entry, long long expiresAt);
+    // entries which expired at now are removed and appended to expired
+    void removeExpired(long long now, std::vector<QString>& expired);
+    bool contains(const IpKey& key) const;
+    size_t size() const;
+private:
+    using Prefixes = std::unordered_map<IpKey, long long, IpKeyHash>;
+    // longest first, so a single address is found with the first probe
+    using PrefixTables = std::map<int, Prefixes, std::greater<int>>;
+
+    bool insert(const QString& entry, long long expiresAt);
+private:
+    mutable QReadWriteLock lock_;
+    BlackListEntries entries_;
+    PrefixTables tables_;
+};
+
+#endif // BLACKLIST_H
@@ -0,0 +1,82 @@
+// Copyright 2018 AtomicSwap Solutions Ltd. All rights reserved.
+// Use of this source code is governed by Microsoft Reference Source
+// License (MS-RSL) that can be found in the LICENSE file.
+
+#include "commands.h"
+#include <cstring>
+
+namespace Commands
+{
+    namespace {
+        // in the order of Command
+        const char* const names[Count] = {
+            "unknown",
+            "init",
+            "request_swap_commission",
+            "create_order",
+            "delete_order",
+            "get_orders",
+            "subscribe",
+            "unsubscribe",
+            "create_trade",
+            "update_trade"
+        };
+
+        // a power of two
+        const int slotsCount = 32;
+
+        template<typename Char>
+        int slot(const Char* name, int size)
+        {
+            return (size + int(name[0]) + int(name[size - 2])) & (slotsCount - 1);
+        }
+
+        struct Table {
+            Table()
+            {
+                for (int i = 0; i < slotsCount; ++i) {
+                    commands[i] = Unknown;
+                }
+                for (int command = Unknown + 1; command < Count; ++command) {
+                    int index = slot(names[command], int(std::strlen(names[command])));
+                    Q_ASSERT_X(commands[index] == Unknown, "Commands", "two command names have the same slot, change slot()");
+                    commands[index] = Command(command);
+                }
+            }
+
+            Command commands[slotsCount];
+        };
+
+        const Table& table()
+        {
+            static const Table commandsTable;
+            return commandsTable;
+        }
+    }
+
+    Command find(const char* name, int size)
+    {
+        if (size < 2) {
+            return Unknown;
+        }
+        Command command = table().commands[slot(name, size)];
+        const char* candidate = names[command];
+        return command != Unknown && int(std::strlen(candidate)) == size && std::memcmp(candidate, name, size) == 0 ? command : Unknown;
+    }
+
+    Command find(const QString& name)
+    {
+        int size = name.size();
+        if (size < 2) {
+            return Unknown;
+        }
+        const ushort* chars = name.utf16();
+        Command command = table().commands[slot(chars, size)];
+        return command != Unknown && name == QLatin1String(names[command]) ? command : Unknown;
+    }
+
+    const char* name(Command command)
+    {
+        return names[command];
+    }
+}
@@ -0,0 +1,37 @@
+// Copyright 2018 AtomicSwap Solutions Ltd. All rights reserved.
+// Use of this source code is governed by Microsoft Reference Source
+// License (MS-RSL) that can be found in the LICENSE file.
+
+#ifndef COMMANDS_H
+#define COMMANDS_H
+
+#include <QString>
+
+// Commands a client can send. A command name is found with a perfect hash:
+// its length, first and next to last character select a slot of a small
+// table and a single compare confirms the name. A new command is added to
+// Command and to the names in commands.cpp, an assertion catches a name whose
+// slot is already taken.
+namespace Commands
+{
+    enum Command {
+        Unknown = 0,
+        Init,
+        RequestSwapCommission,
+        CreateOrder,
+        DeleteOrder,
+        GetOrders,
+        Subscribe,
+        Unsubscribe,
+        CreateTrade,
+        UpdateTrade,
+        Count
+    };
+
+    Command find(const QString& name);
+    Command find(const char* name, int size);
+    // "unknown" for Unknown
+    const char* name(Command command);
+}
+
+#endif // COMMANDS_H
@@ -0,0 +1,425 @@
+// Copyright 2018 AtomicSwap Solutions Ltd. All rights reserved.
+// Use of this source code is governed by Microsoft Reference Source
+// License (MS-RSL) that can be found in the LICENSE file.
+
+#include "connectionworker.h"
+#include <QThread>
+#include "logger.h"
+#include "binaryprotocol.h"
+#include "metrics.h"
+#include <algorithm>
+
+OutputLimits::OutputLimits() :
+    highWaterMark(4 * 1024 * 1024),
+    policy(Coalesce),
+    chunkSize(16 * 1024)
+{
+}
+
+bool OutputLimits::parsePolicy(const QString& name, Policy& policy)
+{
+    if (name == "drop") {
+        policy = Drop;
+    } else if (name == "coalesce") {
+        policy = Coalesce;
+    } else if (name == "disconnect") {
+        policy = Disconnect;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+ConnectionWorker::ConnectionWorker(long long maxRequestSize, const OutputLimits& outputLimits) :
+    maxRequestSize_(maxRequestSize),
+    outputLimits_(outputLimits)
+{
+}
+
+ConnectionWorker::~ConnectionWorker()
+{
+}
+
+void ConnectionWorker::send(qintptr connectionId, const QByteArray& data, const QByteArray& binary)
+{
+    if (thread() == QThread::currentThread()) {
+        write(connectionId, data, binary);
+    } else {
+        QMetaObject::invokeMethod(this, "write", Qt::QueuedConnection, Q_ARG(qintptr, connectionId), Q_ARG(QByteArray, data), Q_ARG(QByteArray, binary));
+    }
+}
+
+void ConnectionWorker::send(const QVector<qintptr>& connectionIds, const QByteArray& data, const QByteArray& binary)
+{
+    if (connectionIds.isEmpty()) {
+        return;
+    }
+    if (thread() == QThread::currentThread()) {
+        writeToMany(connectionIds, data, binary);
+    } else {
+        QMetaObject::invokeMethod(this, "writeToMany", Qt::QueuedConnection, Q_ARG(QVector<qintptr>, connectionIds), Q_ARG(QByteArray, data), Q_ARG(QByteArray, binary));
+    }
+}
+
+void ConnectionWorker::send(qintptr connectionId, const ReplyStreamPtr& stream)
+{
+    if (thread() == QThread::currentThread()) {
+        writeStream(connectionId, stream);
+    } else {
+        QMetaObject::invokeMethod(this, "writeStream", Qt::QueuedConnection, Q_ARG(qintptr, connectionId), Q_ARG(ReplyStreamPtr, stream));
+    }
+}
+
+void ConnectionWorker::close(qintptr connectionId)
+{
+    if (thread() == QThread::currentThread()) {
+        closeConnection(connectionId);
+    } else {
+        QMetaObject::invokeMethod(this, "closeConnection", Qt::QueuedConnection, Q_ARG(qintptr, connectionId));
+    }
+}
+
+void ConnectionWorker::switchToBinary(qintptr connectionId)
+{
+    // queued like send(), so the messages sent before keep their encoding
+    if (thread() == QThread::currentThread()) {
+        setBinaryOutput(connectionId);
+    } else {
+        QMetaObject::invokeMethod(this, "setBinaryOutput", Qt::QueuedConnection, Q_ARG(qintptr, connectionId));
+    }
+}
+
+void ConnectionWorker::outputQueues(OutputQueues& queues) const
+{
+    QMutexLocker locker(&clientsMutex_);
+    queues.reserve(queues.size() + clients_.size());
+    for (auto it = clients_.begin(); it != clients_.end(); ++it) {
+        const Client& client = it->second;
+        OutputQueue queue;
+        queue.connectionId = it->first;
+        queue.ip = client.ip;
+        queue.bytes = client.queuedBytes();
+        queue.peakBytes = client.peakBytes;
+        queue.droppedMessages = client.droppedMessages;
+        queues.push_back(queue);
+    }
+}
+
+void ConnectionWorker::addConnection(qintptr connectionId, qintptr socketDescriptor)
+{
+    QTcpSocket* clientSocket = new QTcpSocket(this);
+    if (!clientSocket->setSocketDescriptor(socketDescriptor)) {
+        Logger::info() << "Failed to accept connection: " + clientSocket->errorString();
+        delete clientSocket;
+        return;
+    }
+
+    QMutexLocker locker(&clientsMutex_);
+    Client& client = clients_[connectionId];
+    client.socket = clientSocket;
+    client.ip = clientSocket->peerAddress().toString();
+    client.binaryInput = false;
+    client.binaryOutput = false;
+    client.peakBytes = 0;
+    client.droppedMessages = 0;
+    client.pendingDropped = 0;
+    client.dropping = false;
+    client.aborting = false;
+    client.heldBytes = 0;
+    client.unsentBytes = 0;
+    locker.unlock();
+    connectionIds_[clientSocket] = connectionId;
+
+    connect(clientSocket, SIGNAL(disconnected()), this, SLOT(onDisconnected()));
+    connect(clientSocket, SIGNAL(readyRead()), this, SLOT(onReadyRead()));
+    connect(clientSocket, SIGNAL(bytesWritten(qint64)), this, SLOT(onBytesWritten(qint64)));
+
+    emit connectionOpened(connectionId, client.ip);
+}
+
+void ConnectionWorker::write(qintptr connectionId, const QByteArray& data, const QByteArray& binary)
+{
+    QMutexLocker locker(&clientsMutex_);
+    auto it = clients_.find(connectionId);
+    if (it != clients_.end()) {
+        QByteArray frame = binary;
+        enqueue(connectionId, it->second, data, binary, frame);
+    }
+}
+
+void ConnectionWorker::writeToMany(const QVector<qintptr>& connectionIds, const QByteArray& data, const QByteArray& binary)
+{
+    // a message without binary encoding is wrapped once for all binary connections
+    QByteArray frame = binary;
+    QMutexLocker locker(&clientsMutex_);
+    for (int i = 0; i < connectionIds.size(); ++i) {
+        auto it = clients_.find(connectionIds[i]);
+        if (it != clients_.end()) {
+            enqueue(connectionIds[i], it->second, data, binary, frame);
+        }
+    }
+}
+
+void ConnectionWorker::writeStream(qintptr connectionId, const ReplyStreamPtr& stream)
+{
+    QMutexLocker locker(&clientsMutex_);
+    auto it = clients_.find(connectionId);
+    if (it == clients_.end() || it->second.aborting) {
+        return;
+    }
+    Client& client = it->second;
+    if (client.binaryOutput) {
+        // a frame starts with its size, so the reply is built at once
+        QByteArray frame;
+        enqueue(connectionId, client, stream->readAll(), QByteArray(), frame);
+    } else if (client.stream) {
+        Held held;
+        held.stream = stream;
+        client.held.push_back(held);
+    } else {
+        client.stream = stream;
+        writeChunks(client);
+    }
+}
+
+void ConnectionWorker::writeOrHold(Client& client, const QByteArray& data)
+{
+    if (client.stream) {
+        Held held;
+        held.data = data;
+        client.held.push_back(held);
+        client.heldBytes += data.size();
+    } else {
+        writeToSocket(client, data);
+    }
+}
+
+void ConnectionWorker::writeToSocket(Client& client, const QByteArray& data)
+{
+    qint64 written = client.socket->write(data);
+    if (written > 0) {
+        client.unsentBytes += written;
+    }
+}
+
+void ConnectionWorker::writeChunks(Client& client)
+{
+    static Counter* chunks = Metrics::instance().counter("atom_engine_stream_chunks_total", "Chunks of streamed replies written to sockets");
+    // the rest waits for bytesWritten(), so the event loop serves other connections between chunks
+    while (client.stream && client.socket->bytesToWrite() < outputLimits_.chunkSize) {
+        client.stream->nextChunk(outputLimits_.chunkSize, chunk_);
+        writeToSocket(client, chunk_);
+        chunks->add();
+        if (!client.stream->atEnd()) {
+            continue;
+        }
+        client.stream.reset();
+        while (!client.held.empty() && !client.stream) {
+            Held& held = client.held.front();
+            if (held.stream) {
+                client.stream = held.stream;
+            } else {
+                writeToSocket(client, held.data);
+                client.heldBytes -= held.data.size();
+            }
+            client.held.pop_front();
+        }
+    }
+}
+
+void ConnectionWorker::enqueue(qintptr connectionId, Client& client, const QByteArray& data, const QByteArray& binary, QByteArray& frame)
+{
+    if (client.aborting) {
+        return;
+    }
+    qint64 queued = client.queuedBytes();
+    int size = client.binaryOutput && !binary.isEmpty() ? binary.size() : data.size();
+    // a single message is always accepted by an empty queue, however large it is
+    bool overflow = outputLimits_.highWaterMark > 0 && queued > 0 && queued + size > outputLimits_.highWaterMark;
+    if (overflow || client.pendingDropped > 0) {
+        if (outputLimits_.policy == OutputLimits::Disconnect) {
+            Logger::warning() << "Output queue of client descr = " + QString::number(connectionId) + " ip = " + client.ip
+                                 + " exceeded " + QString::number(outputLimits_.highWaterMark) + " bytes, disconnecting";
+            static Counter* slowDisconnects = Metrics::instance().counter("atom_engine_output_disconnects_total", "Clients disconnected because their output queue was full");
+            slowDisconnects->add();
+            client.aborting = true;
+            // disconnected() must not be emitted while clients_ is iterated
+            QMetaObject::invokeMethod(this, "abortConnection", Qt::QueuedConnection, Q_ARG(qintptr, connectionId));
+            return;
+        }
+        if (!client.dropping) {
+            client.dropping = true;
+            Logger::warning() << "Output queue of client descr = " + QString::number(connectionId) + " ip = " + client.ip
+                                 + " exceeded " + QString::number(outputLimits_.highWaterMark) + " bytes, dropping messages";
+        }
+        static Counter* droppedMessages = Metrics::instance().counter("atom_engine_output_dropped_messages_total", "Messages dropped because the output queue of a client was full");
+        droppedMessages->add();
+        ++client.droppedMessages;
+        if (outputLimits_.policy == OutputLimits::Coalesce) {
+            ++client.pendingDropped;
+        }
+        return;
+    }
+
+    if (!client.binaryOutput) {
+        writeOrHold(client, data);
+    } else {
+        if (frame.isEmpty()) {
+            frame = BinaryProtocol::encodeJson(data);
+        }
+        writeOrHold(client, frame);
+    }
+    client.dropping = false;
+    client.peakBytes = std::max(client.peakBytes, queued + size);
+}
+
+void ConnectionWorker::setBinaryOutput(qintptr connectionId)
+{
+    auto it = clients_.find(connectionId);
+    if (it != clients_.end()) {
+        it->second.binaryOutput = true;
+    }
+}
+
+void ConnectionWorker::closeConnection(qintptr connectionId)
+{
+    auto it = clients_.find(connectionId);
+    if (it != clients_.end()) {
+        it->second.socket->close();
+    }
+}
+
+void ConnectionWorker::abortConnection(qintptr connectionId)
+{
+    auto it = clients_.find(connectionId);
+    if (it != clients_.end()) {
+        // close() would wait for the queue the peer does not read
+        it->second.socket->abort();
+    }
+}
+
+void ConnectionWorker::closeAll()
+{
+    std::vector<QTcpSocket*> sockets;
+    for (auto it = clients_.begin(); it != clients_.end(); ++it) {
+        sockets.push_back(it->second.socket);
+    }
+    for (size_t i = 0; i < sockets.size(); ++i) {
+        sockets[i]->close();
+    }
+}
+
+void ConnectionWorker::onDisconnected()
+{
+    QTcpSocket* clientSocket = (QTcpSocket*)sender();
+    auto itId = connectionIds_.find(clientSocket);
+    if (itId == connectionIds_.end()) {
+        return;
+    }
+    qintptr connectionId = itId->second;
+    connectionIds_.erase(itId);
+
+    QString clientIp;
+    QMutexLocker locker(&clientsMutex_);
+    auto it = clients_.find(connectionId);
+    if (it != clients_.end()) {
+        clientIp = it->second.ip;
+        clients_.erase(it);
+    }
+    locker.unlock();
+    clientSocket->deleteLater();
+
+    emit connectionClosed(connectionId, clientIp);
+}
+
+void ConnectionWorker::onBytesWritten(qint64 bytes)
+{
+    QTcpSocket* clientSocket = (QTcpSocket*)sender();
+    auto itId = connectionIds_.find(clientSocket);
+    if (itId == connectionIds_.end()) {
+        return;
+    }
+    QMutexLocker locker(&clientsMutex_);
+    auto it = clients_.find(itId->second);
+    if (it == clients_.end()) {
+        return;
+    }
+    Client& client = it->second;
+    client.unsentBytes = std::max<qint64>(0, client.unsentBytes - bytes);
+    writeChunks(client);
+    if (client.pendingDropped == 0 || client.queuedBytes() > outputLimits_.highWaterMark / 2) {
+        return;
+    }
+    // one reply stands for all dropped events, the client gets them with init and its last seq
+    QByteArray rep = "{\"reply\": \"events_dropped\", \"count\": " + QByteArray::number(client.pendingDropped) + "}\n";
+    client.pendingDropped = 0;
+    Logger::info() << "Output queue of client descr = " + QString::number(itId->second) + " ip = " + client.ip + " drained";
+    writeOrHold(client, client.binaryOutput ? BinaryProtocol::encodeJson(rep) : rep);
+}
+
+void ConnectionWorker::onReadyRead()
+{
+    static Histogram* readDuration = Metrics::instance().histogram("atom_engine_read_duration_us", "Time of reading, framing and parsing the input of a connection");
+    static Histogram* inputBuffer = Metrics::instance().histogram("atom_engine_input_buffer_bytes", "Bytes of an incomplete request left in the input buffer after a read");
+    static Counter* readBytes = Metrics::instance().counter("atom_engine_read_bytes_total", "Bytes read from clients");
+    static Counter* parseErrors = Metrics::instance().counter("atom_engine_request_parse_errors_total", "Requests which are not a JSON object or a valid binary frame");
+    MetricsTimer timer(readDuration);
+
+    QTcpSocket* clientSocket = (QTcpSocket*)sender();
+    auto itId = connectionIds_.find(clientSocket);
+    if (itId == connectionIds_.end()) {
+        return;
+    }
+    qintptr connectionId = itId->second;
+    Client& client = clients_[connectionId];
+    LineFramer& framer = client.framer;
+
+    QByteArray data = clientSocket->readAll();
+    readBytes->add(data.size());
+    framer.append(data);
+
+    if (framer.size() > maxRequestSize_) {
+        framer.clear();
+        emit requestTooLarge(connectionId, client.ip);
+        return;
+    }
+
+    Logger& commandLog = Logger::debug();
+    Requests requests;
+    bool framed = false;
+    QByteArray message;
+    while (client.binaryInput ? framer.nextFrame(message) : framer.next(message)) {
+        framed = true;
+        if (message.length() == 0) {
+            continue;
+        }
+        Request request;
+        bool parsed = false;
+        if (client.binaryInput) {
+            parsed = BinaryProtocol::decodeRequest(message, request);
+            if (commandLog.isSampled()) {
+                commandLog << QString("client descr = ") + QString::number(connectionId) + QString(" binary ") + Commands::name(request.command) + " " + QString::fromLatin1(message.toHex()) + "\n";
+            }
+        } else {
+            if (commandLog.isSampled()) {
+                commandLog << QString("client descr = ") + QString::number(connectionId) + QString(" ") + QString::fromUtf8(message) + "\n";
+            }
+            parsed = RequestParser::parse(message, request);
+        }
+        if (parsed) {
+            if (!client.binaryInput && request.command == Commands::Init) {
+                // the rest of the stream is frames
+                client.binaryInput = request.binaryProtocol;
+            }
+            requests.append(request);
+        } else {
+            parseErrors->add();
+        }
+    }
+    inputBuffer->record(framer.size());
+    if (!framed) {
+        return;
+    }
+
+    emit requestsReceived(connectionId, client.ip, requests);
+}
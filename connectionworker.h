@@ -0,0 +1,149 @@
+// Copyright 2018 AtomicSwap Solutions Ltd. All rights reserved.
+// Use of this source code is governed by Microsoft Reference Source
+// License (MS-RSL) that can be found in the LICENSE file.
+
+#ifndef CONNECTIONWORKER_H
+#define CONNECTIONWORKER_H
+
+#include <QObject>
+#include <QTcpSocket>
+#include <QJsonObject>
+#include <QVector>
+#include <QMutex>
+#include <deque>
+#include <map>
+#include <vector>
+#include "lineframer.h"
+#include "request.h"
+#include "replystream.h"
+
+// What a worker does with messages for a connection whose socket already
+// buffers more than highWaterMark bytes which the peer did not read.
+struct OutputLimits {
+    enum Policy {
+        // the messages are lost
+        Drop,
+        // the messages are dropped until the queue drains to half of the mark, then
+        // one "events_dropped" reply tells the client to resync with its last seq
+        Coalesce,
+        // the connection is aborted, the client reconnects and resyncs
+        Disconnect
+    };
+
+    OutputLimits();
+    static bool parsePolicy(const QString& name, Policy& policy);
+
+    // 0 means unlimited
+    qint64 highWaterMark;
+    Policy policy;
+    // a ReplyStream is written in chunks of about this size, the next one when
+    // less than a chunk is left in the socket
+    int chunkSize;
+};
+
+struct OutputQueue {
+    qintptr connectionId;
+    QString ip;
+    // written by the server but not by the socket yet
+    qint64 bytes;
+    qint64 peakBytes;
+    long long droppedMessages;
+};
+using OutputQueues = std::vector<OutputQueue>;
+
+// Owns a shard of client sockets. A worker lives either in the main thread
+// (single threaded mode) or in its own thread with its own event loop. It does
+// socket I/O, request framing and JSON parsing, all order and trade state is
+// handled by AtomEngineServer which receives parsed requests through signals.
+// send() and close() may be called from any thread. Messages are sent with an
+// optional binary encoding which is used for the connections that negotiated
+// the binary protocol. Output to a peer which does not read is bounded by
+// OutputLimits. A large reply is sent as a ReplyStream, written chunk by chunk
+// as the socket drains.
+class ConnectionWorker : public QObject
+{
+    Q_OBJECT
+public:
+    ConnectionWorker(long long maxRequestSize, const OutputLimits& outputLimits);
+    ~ConnectionWorker();
+
+    void send(qintptr connectionId, const QByteArray& data, const QByteArray& binary = QByteArray());
+    void send(const QVector<qintptr>& connectionIds, const QByteArray& data, const QByteArray& binary = QByteArray());
+    // the messages sent after the stream wait until all of it is written
+    void send(qintptr connectionId, const ReplyStreamPtr& stream);
+    void close(qintptr connectionId);
+    // messages sent after this call are binary frames
+    void switchToBinary(qintptr connectionId);
+    // output queues of all connections, may be called from any thread
+    void outputQueues(OutputQueues& queues) const;
+public slots:
+    void addConnection(qintptr connectionId, qintptr socketDescriptor);
+    void write(qintptr connectionId, const QByteArray& data, const QByteArray& binary);
+    void writeToMany(const QVector<qintptr>& connectionIds, const QByteArray& data, const QByteArray& binary);
+    void writeStream(qintptr connectionId, const ReplyStreamPtr& stream);
+    void setBinaryOutput(qintptr connectionId);
+    void closeConnection(qintptr connectionId);
+    void abortConnection(qintptr connectionId);
+    void closeAll();
+signals:
+    void connectionOpened(qintptr connectionId, const QString& ip);
+    void connectionClosed(qintptr connectionId, const QString& ip);
+    void requestsReceived(qintptr connectionId, const QString& ip, const Requests& requests);
+    void requestTooLarge(qintptr connectionId, const QString& ip);
+private slots:
+    void onReadyRead();
+    void onDisconnected();
+    void onBytesWritten(qint64 bytes);
+private:
+    // a message or a stream which waits for the stream before it
+    struct Held {
+        QByteArray data;
+        ReplyStreamPtr stream;
+    };
+    struct Client {
+        QTcpSocket* socket;
+        QString ip;
+        LineFramer framer;
+        // requests after the binary init are frames
+        bool binaryInput;
+        bool binaryOutput;
+        qint64 peakBytes;
+        long long droppedMessages;
+        // dropped by the Coalesce policy since the last events_dropped reply
+        long long pendingDropped;
+        // the last message was dropped, a warning is logged once per episode
+        bool dropping;
+        // aborted by the Disconnect policy, the abort is queued
+        bool aborting;
+        // the reply being written in chunks, output after it is held
+        ReplyStreamPtr stream;
+        std::deque<Held> held;
+        qint64 heldBytes;
+        // given to the socket and not written by it yet, counted here because
+        // outputQueues() must not call the socket from another thread
+        qint64 unsentBytes;
+
+        qint64 queuedBytes() const { return unsentBytes + heldBytes; }
+    };
+    using Clients = std::map<qintptr, Client>;
+    using ConnectionIds = std::map<QTcpSocket*, qintptr>;
+
+    void enqueue(qintptr connectionId, Client& client, const QByteArray& data, const QByteArray& binary, QByteArray& frame);
+    // writes data to the socket or holds it while a stream is written
+    void writeOrHold(Client& client, const QByteArray& data);
+    void writeToSocket(Client& client, const QByteArray& data);
+    // chunks of the stream while the socket has room, then the held output
+    void writeChunks(Client& client);
+
+    Clients clients_;
+    ConnectionIds connectionIds_;
+    long long maxRequestSize_;
+    OutputLimits outputLimits_;
+    // guards clients_ against outputQueues(), only the worker thread changes it,
+    // outputQueues() reads the counters of a client and never its socket
+    mutable QMutex clientsMutex_;
+    // the chunk of a stream being encoded, its allocation is reused for all streams
+    QByteArray chunk_;
+};
+
+#endif // CONNECTIONWORKER_H
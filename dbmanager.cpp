@@ -1,16 +1,29 @@
 #include "dbmanager.h"
 #include "logger.h"
 #include "info.h"
+#include "dbwriter.h"
+#include "metrics.h"
 #include <QVariant>
+#include <QSqlError>
+#include <algorithm>
 
-DBManager::DBManager()
+namespace {
+    Histogram* callDuration(const char* method)
+    {
+        return Metrics::instance().histogram("atom_engine_db_call_duration_us", "Time spent in DBManager calls, including waiting for a sync commit",
+                                             QString("method=\"") + method + "\"");
+    }
+}
+
+DBManager::DBManager() :
+    writer(nullptr)
 {
 
 }
 
 DBManager::~DBManager()
 {
-
+    shutdown();
 }
 
 DBManager& DBManager::instance()
@@ -19,207 +32,305 @@ DBManager& DBManager::instance()
     return dbManager;
 }
 
-bool DBManager::init(const QString& dbName)
+bool DBManager::init(const DBSettings& settings)
 {
     Logger::info() << "Database initialization ...";
-    Logger::info() << "DB name = " + dbName;
+    Logger::info() << "DB name = " + settings.name;
 
     db = QSqlDatabase::addDatabase("QSQLITE");
-    db.setDatabaseName(dbName);
+    db.setDatabaseName(settings.name);
     bool res = db.open();
 
     if (!res) {
         Logger::info() << "Failed to open database";
+    } else if (!migrate()) {
+        res = false;
     } else {
-        queryAddToOrders.prepare("INSERT INTO orders (id, sendCur, sendCount, getCur, getCount, getAddress, hash) " \
-                                 "VALUES (:id, :sendCur, :sendCount, :getCur, :getCount, :getAddress, :hash)");
-
-        queryAddToTrades.prepare("INSERT INTO trades (orderId, sendCur, sendCount, getCur, getCount, getAddress, orderHash," \
-                                 "id, initiatorAddress, secretHash, contractInitiator, contractParticipant, initiatorContractTransaction, " \
-                                 "participantContractTransaction, initiatorRedemptionTransaction, participantRedemptionTransaction," \
-                                 "initiatorCommissionPaid, participantCommissionPaid," \
-                                 "refundedInit, refundedPart, refundTimeInit, refundTimePart, hash) " \
-                                 "VALUES (:orderId, :sendCur, :sendCount, :getCur, :getCount, :getAddress, :orderHash," \
-                                 ":id, :initiatorAddress, :secretHash, :contractInitiator, :contractParticipant, :initiatorContractTransaction, " \
-                                 ":participantContractTransaction, :initiatorRedemptionTransaction, :participantRedemptionTransaction," \
-                                 ":initiatorCommissionPaid, :participantCommissionPaid," \
-                                 ":refundedInit, :refundedPart, :refundTimeInit, :refundTimePart, :hash)");
-
-        queryAddToBL.prepare("INSERT INTO black_list (ip) VALUES (:ip)");
-
-        queryDeleteFromOrders.prepare("DELETE FROM orders WHERE id=:id");
-
-        queryDeleteFromTrades.prepare("DELETE FROM trades WHERE id=:id");
-
-        queryUpdateTrade.prepare("UPDATE SET orderId=:orderId, sendCur=:sendCur, sendCount=:sendCount, getCur=:getCur, getCount=:getCount, getAddress=:getAddress, orderHash=:orderHash, " \
-                                 "initiatorAddress=:initiatorAddress, secretHash=:secretHash, contractInitiator=:contractInitiator, " \
-                                 "contractParticipant=:contractParticipant, initiatorContractTransaction=:initiatorContractTransaction, participantContractTransaction=:participantContractTransaction, " \
-                                 "initiatorRedemptionTransaction=:initiatorRedemptionTransaction, participantRedemptionTransaction=:participantRedemptionTransaction, " \
-                                 "initiatorCommissionPaid=:initiatorCommissionPaid, participantCommissionPaid=:participantCommissionPaid," \
-                                 "refundedInit=:refundedInit, refundedPart=:refundedPart, refundTimeInit=:refundTimeInit, refundTimePart=:refundTimePart, hash=:hash " \
-                                 "WHERE id=:id");
+        DBWriter::configure(db, settings);
+
+        Logger::info() << "DB group commit window in ms = " + QString::number(settings.flushIntervalMs) + ", max batch = " + QString::number(settings.groupCommitMaxBatch) + ", sync commit = " + (settings.syncCommit ? "true" : "false");
+        if (!settings.snapshotFile.isEmpty()) {
+            Logger::info() << "Snapshot file = " + settings.snapshotFile + ", journal file = " + settings.journalFile + ", snapshot interval in sec = " + QString::number(settings.snapshotIntervalSec);
+        }
+        Logger::info() << "DB journal mode = " + settings.journalMode + ", synchronous = " + settings.synchronous + ", cache size in KiB = " + QString::number(settings.cacheSizeKb) + ", mmap size in bytes = " + QString::number(settings.mmapSizeBytes);
+        writer = new DBWriter(settings);
+        res = writer->open();
+    }
 
-        queryLoadOrders.prepare("SELECT * FROM orders");
+    return res;
+}
 
-        queryLoadTrades.prepare("SELECT * FROM trades");
+bool DBManager::migrate()
+{
+    QSqlQuery query(db);
+    if (!query.exec("PRAGMA table_info(black_list)")) {
+        Logger::info() << "Failed to read black list columns: " + query.lastError().text();
+        return false;
+    }
+    bool exists = false;
+    while (query.next()) {
+        if (query.value(1).toString() == "expires_at") {
+            return true;
+        }
+        exists = true;
+    }
+    if (!exists) {
+        return true;
+    }
+    // entries of older versions never expire
+    if (!query.exec("ALTER TABLE black_list ADD COLUMN expires_at INTEGER NOT NULL DEFAULT 0")) {
+        Logger::info() << "Failed to add black list expiry: " + query.lastError().text();
+        return false;
+    }
+    Logger::info() << "Added expires_at to black_list";
+    return true;
+}
 
-        queryLoadBL.prepare("SELECT * FROM black_list");
+void DBManager::shutdown()
+{
+    if (writer) {
+        Logger::info() << "Database queue depth on shutdown = " + QString::number(writer->queueDepth());
+        writer->stop();
+        delete writer;
+        writer = nullptr;
     }
+}
 
-    return res;
+int DBManager::queueDepth() const
+{
+    return writer ? writer->queueDepth() : 0;
 }
 
 void DBManager::addToOrders(OrderInfoPtr order)
 {
-    queryAddToOrders.bindValue(":id", order->orderId_);
-    queryAddToOrders.bindValue(":sendCur", order->sendCur_);
-    queryAddToOrders.bindValue(":sendCount", order->sendCount_);
-    queryAddToOrders.bindValue(":getCur", order->getCur_);
-    queryAddToOrders.bindValue(":getCount", order->getCount_);
-    queryAddToOrders.bindValue(":getAddress", order->getAddress_);
-    queryAddToOrders.bindValue(":hash", order->getHash());
-    queryAddToOrders.exec();
+    static Histogram* duration = callDuration("addToOrders");
+    MetricsTimer timer(duration);
+    if (writer) {
+        DBMutation mutation;
+        mutation.type = DBMutation::AddOrder;
+        mutation.order = order;
+        writer->enqueue(mutation);
+    }
 }
 
 void DBManager::addToTrades(TradeInfoPtr trade)
 {
-    queryAddToTrades.bindValue(":orderId", trade->order_->orderId_);
-    queryAddToTrades.bindValue(":sendCur", trade->order_->sendCur_);
-    queryAddToTrades.bindValue(":sendCount", trade->order_->sendCount_);
-    queryAddToTrades.bindValue(":getCur", trade->order_->getCur_);
-    queryAddToTrades.bindValue(":getCount", trade->order_->getCount_);
-    queryAddToTrades.bindValue(":getAddress", trade->order_->getAddress_);
-    queryAddToTrades.bindValue(":orderHash", trade->order_->getHash());
-
-    queryAddToTrades.bindValue(":id", trade->tradeId_);
-    queryAddToTrades.bindValue(":initiatorAddress", trade->initiatorAddress_);
-    queryAddToTrades.bindValue(":secretHash", trade->secretHash_);
-    queryAddToTrades.bindValue(":contractInitiator", trade->contractInitiator_);
-    queryAddToTrades.bindValue(":contractParticipant", trade->contractParticipant_);
-    queryAddToTrades.bindValue(":initiatorContractTransaction", trade->initiatorContractTransaction_);
-    queryAddToTrades.bindValue(":participantContractTransaction", trade->participantContractTransaction_);
-    queryAddToTrades.bindValue(":initiatorRedemptionTransaction", trade->initiatorRedemptionTransaction_);
-    queryAddToTrades.bindValue(":participantRedemptionTransaction", trade->participantRedemptionTransaction_);
-    queryAddToTrades.bindValue(":initiatorCommissionPaid", trade->initiatorCommissionPaid_);
-    queryAddToTrades.bindValue(":participantCommissionPaid", trade->participantCommissionPaid_);
-    queryAddToTrades.bindValue(":refundedInit", trade->refundedInit_);
-    queryAddToTrades.bindValue(":refundedPart", trade->refundedPart_);
-    queryAddToTrades.bindValue(":refundTimeInit", trade->refundTimeInit_);
-    queryAddToTrades.bindValue(":refundTimePart", trade->refundTimePart_);
-    queryAddToTrades.bindValue(":hash", trade->getHash());
+    static Histogram* duration = callDuration("addToTrades");
+    MetricsTimer timer(duration);
+    if (writer) {
+        DBMutations mutations(2);
+        mutations[0].type = DBMutation::AddTrade;
+        // the trade is changed by the server thread later, the writer gets its own copy
+        mutations[0].trade = TradeInfo::create(*trade);
+        // otherwise a restart would put the order back into the book
+        mutations[1].type = DBMutation::DeleteOrder;
+        mutations[1].id = trade->order_->orderId_;
+        writer->enqueue(mutations);
+    }
+}
 
-    queryAddToTrades.exec();
+void DBManager::addToBlackList(const QString& blackListIP, long long expiresAt)
+{
+    static Histogram* duration = callDuration("addToBlackList");
+    MetricsTimer timer(duration);
+    if (writer) {
+        DBMutation mutation;
+        mutation.type = DBMutation::AddToBlackList;
+        mutation.ip = blackListIP;
+        mutation.id = expiresAt;
+        writer->enqueue(mutation);
+    }
 }
 
-void DBManager::addToBlackList(const QString& blackListIP)
+void DBManager::removeFromBlackList(const QString& blackListIP)
 {
-    queryAddToBL.bindValue(":ip", blackListIP);
-    queryAddToBL.exec();
+    static Histogram* duration = callDuration("removeFromBlackList");
+    MetricsTimer timer(duration);
+    if (writer) {
+        DBMutation mutation;
+        mutation.type = DBMutation::RemoveFromBlackList;
+        mutation.ip = blackListIP;
+        writer->enqueue(mutation);
+    }
 }
 
 void DBManager::deleteFromOrders(long long orderId)
 {
-    queryDeleteFromOrders.bindValue(":id", orderId);
-    queryDeleteFromOrders.exec();
+    static Histogram* duration = callDuration("deleteFromOrders");
+    MetricsTimer timer(duration);
+    if (writer) {
+        DBMutation mutation;
+        mutation.type = DBMutation::DeleteOrder;
+        mutation.id = orderId;
+        writer->enqueue(mutation);
+    }
 }
 
 void DBManager::deleteFromTrades(long long tradeId)
 {
-    queryDeleteFromTrades.bindValue(":id", tradeId);
-    queryDeleteFromTrades.exec();
+    static Histogram* duration = callDuration("deleteFromTrades");
+    MetricsTimer timer(duration);
+    if (writer) {
+        DBMutation mutation;
+        mutation.type = DBMutation::DeleteTrade;
+        mutation.id = tradeId;
+        writer->enqueue(mutation);
+    }
 }
 
 void DBManager::updateTrade(TradeInfoPtr trade)
 {
-    queryUpdateTrade.bindValue(":orderId", trade->order_->orderId_);
-    queryUpdateTrade.bindValue(":sendCur", trade->order_->sendCur_);
-    queryUpdateTrade.bindValue(":sendCount", trade->order_->sendCount_);
-    queryUpdateTrade.bindValue(":getCur", trade->order_->getCur_);
-    queryUpdateTrade.bindValue(":getCount", trade->order_->getCount_);
-    queryUpdateTrade.bindValue(":getAddress", trade->order_->getAddress_);
-    queryUpdateTrade.bindValue(":orderHash", trade->order_->getHash());
-
-    queryUpdateTrade.bindValue(":id", trade->tradeId_);
-    queryUpdateTrade.bindValue(":initiatorAddress", trade->initiatorAddress_);
-    queryUpdateTrade.bindValue(":secretHash", trade->secretHash_);
-    queryUpdateTrade.bindValue(":contractInitiator", trade->contractInitiator_);
-    queryUpdateTrade.bindValue(":contractParticipant", trade->contractParticipant_);
-    queryUpdateTrade.bindValue(":initiatorContractTransaction", trade->initiatorContractTransaction_);
-    queryUpdateTrade.bindValue(":participantContractTransaction", trade->participantContractTransaction_);
-    queryUpdateTrade.bindValue(":initiatorRedemptionTransaction", trade->initiatorRedemptionTransaction_);
-    queryUpdateTrade.bindValue(":participantRedemptionTransaction", trade->participantRedemptionTransaction_);
-    queryUpdateTrade.bindValue(":initiatorCommissionPaid", trade->initiatorCommissionPaid_);
-    queryUpdateTrade.bindValue(":participantCommissionPaid", trade->participantCommissionPaid_);
-    queryUpdateTrade.bindValue(":refundedInit", trade->refundedInit_);
-    queryUpdateTrade.bindValue(":refundedPart", trade->refundedPart_);
-    queryUpdateTrade.bindValue(":refundTimeInit", trade->refundTimeInit_);
-    queryUpdateTrade.bindValue(":refundTimePart", trade->refundTimePart_);
-    queryUpdateTrade.bindValue(":hash", trade->getHash());
-
-    queryUpdateTrade.exec();
+    static Histogram* duration = callDuration("updateTrade");
+    MetricsTimer timer(duration);
+    if (writer) {
+        DBMutation mutation;
+        mutation.type = DBMutation::UpdateTrade;
+        mutation.trade = TradeInfo::create(*trade);
+        writer->enqueue(mutation);
+    }
+}
+
+void DBManager::replay(const DBMutations& mutations)
+{
+    static Histogram* duration = callDuration("replay");
+    MetricsTimer timer(duration);
+    if (writer) {
+        for (size_t i = 0; i < mutations.size(); ++i) {
+            writer->enqueue(mutations[i]);
+        }
+    }
+}
+
+void DBManager::startSnapshots(SnapshotStatePtr state, qint64 journalSize)
+{
+    static Histogram* duration = callDuration("startSnapshots");
+    MetricsTimer timer(duration);
+    if (writer) {
+        DBMutation mutation;
+        mutation.type = DBMutation::Checkpoint;
+        mutation.id = journalSize;
+        mutation.snapshot = state;
+        writer->enqueue(mutation);
+    }
 }
 
 void DBManager::loadOrders(Orders& orders)
 {
-    queryLoadOrders.exec();
+    static Histogram* duration = callDuration("loadOrders");
+    MetricsTimer timer(duration);
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    if (!query.exec("SELECT id, sendCur, sendCount, getCur, getCount, getAddress, hash FROM orders ORDER BY id")) {
+        Logger::info() << "Failed to load orders: " + query.lastError().text();
+        return;
+    }
 
-    while (queryLoadOrders.next())
+    while (query.next())
     {
-        long long id = queryLoadOrders.value(0).toLongLong();
-        OrderInfoPtr order = std::make_shared<OrderInfo>();
+        long long id = query.value(0).toLongLong();
+        OrderInfoPtr order = OrderInfo::create();
         order->orderId_ = id;
-        order->sendCur_ = queryLoadOrders.value(1).toString();
-        order->sendCount_ = queryLoadOrders.value(2).toLongLong();
-        order->getCur_ = queryLoadOrders.value(3).toString();
-        order->getCount_ = queryLoadOrders.value(4).toLongLong();
-        order->getAddress_ = queryLoadOrders.value(5).toString();
-        order->setHash(queryLoadOrders.value(6).toString());
-        orders[id] = order;
+        order->sendCur_ = CurrencyCode::fromString(query.value(1).toString());
+        order->sendCount_ = query.value(2).toLongLong();
+        order->getCur_ = CurrencyCode::fromString(query.value(3).toString());
+        order->getCount_ = query.value(4).toLongLong();
+        order->getAddress_ = query.value(5).toString();
+        order->setHash(query.value(6).toString());
+        if (!order->hasPrice() || !order->hasValidCurrencies()) {
+            Logger::warning() << "Skipped order " + QString::number(id) + " without positive counts or valid currency codes";
+            continue;
+        }
+        // rows are ordered by id so every order goes to the end of the map
+        orders.emplace_hint(orders.end(), id, order);
     }
 }
 
-void DBManager::loadTrades(Trades& trades)
+void DBManager::loadTrades(const Orders& orders, Trades& trades)
 {
-    queryLoadTrades.exec();
+    static Histogram* duration = callDuration("loadTrades");
+    MetricsTimer timer(duration);
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    if (!query.exec("SELECT orderId, sendCur, sendCount, getCur, getCount, getAddress, orderHash, " \
+                    "id, initiatorAddress, secretHash, contractInitiator, contractParticipant, initiatorContractTransaction, " \
+                    "participantContractTransaction, initiatorRedemptionTransaction, participantRedemptionTransaction, " \
+                    "initiatorCommissionPaid, participantCommissionPaid, " \
+                    "refundedInit, refundedPart, refundTimeInit, refundTimePart, hash " \
+                    "FROM trades ORDER BY id")) {
+        Logger::info() << "Failed to load trades: " + query.lastError().text();
+        return;
+    }
 
-    while (queryLoadTrades.next())
+    while (query.next())
     {
-        long long id = queryLoadTrades.value(7).toLongLong();
-        TradeInfoPtr trade = std::make_shared<TradeInfo>();
-        trade->order_ = std::make_shared<OrderInfo>();
-        trade->order_->orderId_ = queryLoadTrades.value(0).toLongLong();
-        trade->order_->sendCur_ = queryLoadTrades.value(1).toString();
-        trade->order_->sendCount_ = queryLoadTrades.value(2).toLongLong();
-        trade->order_->getCur_ = queryLoadTrades.value(3).toString();
-        trade->order_->getCount_ = queryLoadTrades.value(4).toLongLong();
-        trade->order_->getAddress_ = queryLoadTrades.value(5).toString();
-        trade->order_->setHash(queryLoadTrades.value(6).toString());
+        long long id = query.value(7).toLongLong();
+        TradeInfoPtr trade = TradeInfo::create();
+        long long orderId = query.value(0).toLongLong();
+        auto itOrder = orders.find(orderId);
+        if (itOrder != orders.end()) {
+            trade->order_ = itOrder->second;
+        } else {
+            trade->order_ = OrderInfo::create();
+            trade->order_->orderId_ = orderId;
+            trade->order_->sendCur_ = CurrencyCode::fromString(query.value(1).toString());
+            trade->order_->sendCount_ = query.value(2).toLongLong();
+            trade->order_->getCur_ = CurrencyCode::fromString(query.value(3).toString());
+            trade->order_->getCount_ = query.value(4).toLongLong();
+            trade->order_->getAddress_ = query.value(5).toString();
+            trade->order_->setHash(query.value(6).toString());
+        }
         trade->tradeId_ = id;
-        trade->initiatorAddress_ = queryLoadTrades.value(8).toString();
-        trade->secretHash_ = queryLoadTrades.value(9).toString();
-        trade->contractInitiator_ = queryLoadTrades.value(10).toString();
-        trade->contractParticipant_ = queryLoadTrades.value(11).toString();
-        trade->initiatorContractTransaction_ = queryLoadTrades.value(12).toString();
-        trade->participantContractTransaction_ = queryLoadTrades.value(13).toString();
-        trade->initiatorRedemptionTransaction_ = queryLoadTrades.value(14).toString();
-        trade->participantRedemptionTransaction_ = queryLoadTrades.value(15).toString();
-        trade->initiatorCommissionPaid_ = queryLoadTrades.value(16).toBool();
-        trade->participantCommissionPaid_ = queryLoadTrades.value(17).toBool();
-        trade->refundedInit_ = queryLoadTrades.value(18).toBool();
-        trade->refundedPart_ = queryLoadTrades.value(19).toBool();
-        trade->refundTimeInit_ = queryLoadTrades.value(20).toLongLong();
-        trade->refundTimePart_ = queryLoadTrades.value(21).toLongLong();
-        trade->setHash(queryLoadTrades.value(22).toString());
-        trades[id] = trade;
-    }
-}
-
-void DBManager::loadBlackList(BlackList& blackList)
-{
-    queryLoadBL.exec();
-
-    while (queryLoadBL.next())
+        trade->initiatorAddress_ = query.value(8).toString();
+        trade->secretHash_ = query.value(9).toString();
+        trade->contractInitiator_ = query.value(10).toString();
+        trade->contractParticipant_ = query.value(11).toString();
+        trade->initiatorContractTransaction_ = query.value(12).toString();
+        trade->participantContractTransaction_ = query.value(13).toString();
+        trade->initiatorRedemptionTransaction_ = query.value(14).toString();
+        trade->participantRedemptionTransaction_ = query.value(15).toString();
+        trade->initiatorCommissionPaid_ = query.value(16).toBool();
+        trade->participantCommissionPaid_ = query.value(17).toBool();
+        trade->refundedInit_ = query.value(18).toBool();
+        trade->refundedPart_ = query.value(19).toBool();
+        trade->refundTimeInit_ = query.value(20).toLongLong();
+        trade->refundTimePart_ = query.value(21).toLongLong();
+        trade->setHash(query.value(22).toString());
+        trades.emplace_hint(trades.end(), id, trade);
+    }
+}
+
+void DBManager::loadBlackList(BlackListEntries& blackList)
+{
+    static Histogram* duration = callDuration("loadBlackList");
+    MetricsTimer timer(duration);
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    if (!query.exec("SELECT ip, expires_at FROM black_list ORDER BY ip")) {
+        Logger::info() << "Failed to load black list: " + query.lastError().text();
+        return;
+    }
+
+    while (query.next())
     {
-        blackList.insert(queryLoadBL.value(0).toString());
+        blackList.emplace_hint(blackList.end(), query.value(0).toString(), query.value(1).toLongLong());
+    }
+}
+
+void DBManager::loadMaxIds(long long& orderId, long long& tradeId)
+{
+    static Histogram* duration = callDuration("loadMaxIds");
+    MetricsTimer timer(duration);
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+
+    // an order taken by a trade lives on in the trades table only
+    orderId = 0;
+    if (query.exec("SELECT MAX(id) FROM orders") && query.next()) {
+        orderId = query.value(0).toLongLong();
+    }
+    tradeId = 0;
+    if (query.exec("SELECT MAX(id), MAX(orderId) FROM trades") && query.next()) {
+        tradeId = query.value(0).toLongLong();
+        orderId = std::max(orderId, query.value(1).toLongLong());
     }
 }
@@ -4,8 +4,10 @@
 #include <QString>
 #include "QtSql/QSqlDatabase"
 #include <map>
+#include <memory>
 #include <set>
 #include "QSqlQuery"
+#include "dbwriter.h"
 
 struct OrderInfo;
 using OrderInfoPtr = std::shared_ptr<OrderInfo>;
@@ -15,37 +17,41 @@ struct TradeInfo;
 using TradeInfoPtr = std::shared_ptr<TradeInfo>;
 using Trades = std::map<long long, TradeInfoPtr>;
 
-using BlackList = std::set<QString>;
+// entry -> expiry time in seconds since epoch, 0 never expires
+using BlackListEntries = std::map<QString, long long>;
 
 class DBManager {
 public:
     static DBManager& instance();
-    bool init(const QString& dbName);
+    bool init(const DBSettings& settings);
+    void shutdown();
+    int queueDepth() const;
     void addToOrders(OrderInfoPtr order);
+    // the order taken by the trade is deleted in the same transaction
     void addToTrades(TradeInfoPtr trade);
-    void addToBlackList(const QString& blackListIP);
+    void addToBlackList(const QString& blackListIP, long long expiresAt);
+    void removeFromBlackList(const QString& blackListIP);
     void deleteFromOrders(long long orderId);
     void deleteFromTrades(long long tradeId);
     void updateTrade(TradeInfoPtr trade);
     void loadOrders(Orders& orders);
-    void loadTrades(Trades& trades);
-    void loadBlackList(BlackList& blackList);
+    // a trade whose order is in orders shares its record
+    void loadTrades(const Orders& orders, Trades& trades);
+    void loadBlackList(BlackListEntries& blackList);
+    void loadMaxIds(long long& orderId, long long& tradeId);
+    // writes mutations replayed from the journal again, they may be missing from the database
+    void replay(const DBMutations& mutations);
+    // journalSize is the valid size of the replayed journal, 0 writes a new snapshot of the state
+    void startSnapshots(SnapshotStatePtr state, qint64 journalSize);
 private:
+    bool migrate();
     DBManager();
     ~DBManager();
     DBManager(const DBManager&);
     DBManager& operator = (const DBManager&);
 private:
     QSqlDatabase db;
-    QSqlQuery queryAddToOrders;
-    QSqlQuery queryAddToTrades;
-    QSqlQuery queryAddToBL;
-    QSqlQuery queryDeleteFromOrders;
-    QSqlQuery queryDeleteFromTrades;
-    QSqlQuery queryUpdateTrade;
-    QSqlQuery queryLoadOrders;
-    QSqlQuery queryLoadTrades;
-    QSqlQuery queryLoadBL;
+    DBWriter* writer;
 };
 
 #endif // DBMANAGER_H
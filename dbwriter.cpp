@@ -0,0 +1,420 @@
+// Copyright 2018 AtomicSwap Solutions Ltd. All rights reserved.
+// Use of this source code is governed by Microsoft Reference Source
+// License (MS-RSL) that can be found in the LICENSE file.
+
+#include "dbwriter.h"
+#include "logger.h"
+#include "info.h"
+#include "snapshot.h"
+#include "metrics.h"
+#include <QElapsedTimer>
+#include <QSqlError>
+#include <QVariant>
+#include <QStringList>
+
+namespace {
+    const QString writerConnectionName = "writer";
+    const QStringList journalModes = {"DELETE", "TRUNCATE", "PERSIST", "MEMORY", "WAL", "OFF"};
+    const QStringList synchronousLevels = {"OFF", "NORMAL", "FULL", "EXTRA"};
+
+    // statement of every DBMutation::Type, in the order of the enum
+    const char* const statementNames[] = {"addToOrders", "addToTrades", "addToBL", "deleteFromOrders", "deleteFromTrades", "updateTrade", "checkpoint", "deleteFromBL"};
+
+    Histogram* statementDuration(DBMutation::Type type)
+    {
+        static const std::vector<Histogram*> durations = [] {
+            std::vector<Histogram*> histograms;
+            for (const char* name : statementNames) {
+                histograms.push_back(Metrics::instance().histogram("atom_engine_db_statement_duration_us", "Time of binding and executing a prepared statement",
+                                                                   QString("statement=\"") + name + "\""));
+            }
+            return histograms;
+        }();
+        return durations[type];
+    }
+}
+
+DBStatements::DBStatements(const QSqlDatabase& db) :
+    addToOrders_(db),
+    addToTrades_(db),
+    addToBL_(db),
+    deleteFromBL_(db),
+    deleteFromOrders_(db),
+    deleteFromTrades_(db),
+    updateTrade_(db)
+{
+    addToOrders_.prepare("INSERT OR REPLACE INTO orders (id, sendCur, sendCount, getCur, getCount, getAddress, hash) " \
+                         "VALUES (:id, :sendCur, :sendCount, :getCur, :getCount, :getAddress, :hash)");
+
+    addToTrades_.prepare("INSERT OR REPLACE INTO trades (orderId, sendCur, sendCount, getCur, getCount, getAddress, orderHash," \
+                         "id, initiatorAddress, secretHash, contractInitiator, contractParticipant, initiatorContractTransaction, " \
+                         "participantContractTransaction, initiatorRedemptionTransaction, participantRedemptionTransaction," \
+                         "initiatorCommissionPaid, participantCommissionPaid," \
+                         "refundedInit, refundedPart, refundTimeInit, refundTimePart, hash) " \
+                         "VALUES (:orderId, :sendCur, :sendCount, :getCur, :getCount, :getAddress, :orderHash," \
+                         ":id, :initiatorAddress, :secretHash, :contractInitiator, :contractParticipant, :initiatorContractTransaction, " \
+                         ":participantContractTransaction, :initiatorRedemptionTransaction, :participantRedemptionTransaction," \
+                         ":initiatorCommissionPaid, :participantCommissionPaid," \
+                         ":refundedInit, :refundedPart, :refundTimeInit, :refundTimePart, :hash)");
+
+    addToBL_.prepare("INSERT INTO black_list (ip, expires_at) VALUES (:ip, :expiresAt)");
+
+    deleteFromBL_.prepare("DELETE FROM black_list WHERE ip=:ip");
+
+    deleteFromOrders_.prepare("DELETE FROM orders WHERE id=:id");
+
+    deleteFromTrades_.prepare("DELETE FROM trades WHERE id=:id");
+
+    updateTrade_.prepare("UPDATE trades SET orderId=:orderId, sendCur=:sendCur, sendCount=:sendCount, getCur=:getCur, getCount=:getCount, getAddress=:getAddress, orderHash=:orderHash, " \
+                         "initiatorAddress=:initiatorAddress, secretHash=:secretHash, contractInitiator=:contractInitiator, " \
+                         "contractParticipant=:contractParticipant, initiatorContractTransaction=:initiatorContractTransaction, participantContractTransaction=:participantContractTransaction, " \
+                         "initiatorRedemptionTransaction=:initiatorRedemptionTransaction, participantRedemptionTransaction=:participantRedemptionTransaction, " \
+                         "initiatorCommissionPaid=:initiatorCommissionPaid, participantCommissionPaid=:participantCommissionPaid," \
+                         "refundedInit=:refundedInit, refundedPart=:refundedPart, refundTimeInit=:refundTimeInit, refundTimePart=:refundTimePart, hash=:hash " \
+                         "WHERE id=:id");
+}
+
+void DBStatements::apply(const DBMutation& mutation)
+{
+    MetricsTimer timer(statementDuration(mutation.type));
+    switch (mutation.type) {
+    case DBMutation::AddOrder: {
+        const OrderInfoPtr& order = mutation.order;
+        QSqlQuery& query = addToOrders_;
+        query.bindValue(":id", order->orderId_);
+        query.bindValue(":sendCur", order->sendCur_.toString());
+        query.bindValue(":sendCount", order->sendCount_);
+        query.bindValue(":getCur", order->getCur_.toString());
+        query.bindValue(":getCount", order->getCount_);
+        query.bindValue(":getAddress", order->getAddress_);
+        query.bindValue(":hash", order->getHash());
+        query.exec();
+        break;
+    }
+    case DBMutation::AddTrade:
+        bindTrade(addToTrades_, mutation.trade);
+        addToTrades_.exec();
+        break;
+    case DBMutation::AddToBlackList:
+        // replaces a renewed entry, and makes replaying the journal idempotent
+        deleteFromBL_.bindValue(":ip", mutation.ip);
+        deleteFromBL_.exec();
+        addToBL_.bindValue(":ip", mutation.ip);
+        addToBL_.bindValue(":expiresAt", mutation.id);
+        addToBL_.exec();
+        break;
+    case DBMutation::RemoveFromBlackList:
+        deleteFromBL_.bindValue(":ip", mutation.ip);
+        deleteFromBL_.exec();
+        break;
+    case DBMutation::DeleteOrder:
+        deleteFromOrders_.bindValue(":id", mutation.id);
+        deleteFromOrders_.exec();
+        break;
+    case DBMutation::DeleteTrade:
+        deleteFromTrades_.bindValue(":id", mutation.id);
+        deleteFromTrades_.exec();
+        break;
+    case DBMutation::UpdateTrade:
+        bindTrade(updateTrade_, mutation.trade);
+        updateTrade_.exec();
+        break;
+    case DBMutation::Checkpoint:
+        break;
+    }
+}
+
+void DBStatements::bindTrade(QSqlQuery& query, const TradeInfoPtr& trade)
+{
+    query.bindValue(":orderId", trade->order_->orderId_);
+    query.bindValue(":sendCur", trade->order_->sendCur_.toString());
+    query.bindValue(":sendCount", trade->order_->sendCount_);
+    query.bindValue(":getCur", trade->order_->getCur_.toString());
+    query.bindValue(":getCount", trade->order_->getCount_);
+    query.bindValue(":getAddress", trade->order_->getAddress_);
+    query.bindValue(":orderHash", trade->order_->getHash());
+
+    query.bindValue(":id", trade->tradeId_);
+    query.bindValue(":initiatorAddress", trade->initiatorAddress_);
+    query.bindValue(":secretHash", trade->secretHash_.toString());
+    query.bindValue(":contractInitiator", trade->contractInitiator_.toString());
+    query.bindValue(":contractParticipant", trade->contractParticipant_.toString());
+    query.bindValue(":initiatorContractTransaction", trade->initiatorContractTransaction_.toString());
+    query.bindValue(":participantContractTransaction", trade->participantContractTransaction_.toString());
+    query.bindValue(":initiatorRedemptionTransaction", trade->initiatorRedemptionTransaction_.toString());
+    query.bindValue(":participantRedemptionTransaction", trade->participantRedemptionTransaction_.toString());
+    query.bindValue(":initiatorCommissionPaid", trade->initiatorCommissionPaid_);
+    query.bindValue(":participantCommissionPaid", trade->participantCommissionPaid_);
+    query.bindValue(":refundedInit", trade->refundedInit_);
+    query.bindValue(":refundedPart", trade->refundedPart_);
+    query.bindValue(":refundTimeInit", trade->refundTimeInit_);
+    query.bindValue(":refundTimePart", trade->refundTimePart_);
+    query.bindValue(":hash", trade->getHash());
+}
+
+DBWriter::DBWriter(const DBSettings& settings) :
+    settings_(settings),
+    state_(Starting),
+    stopping_(false),
+    enqueued_(0),
+    committed_(0),
+    queueDepth_(0),
+    journal_(new Journal())
+{
+    setObjectName("database writer");
+}
+
+DBWriter::~DBWriter()
+{
+    stop();
+}
+
+bool DBWriter::open()
+{
+    start();
+    QMutexLocker locker(&mutex_);
+    while (state_ == Starting) {
+        commitCondition_.wait(&mutex_);
+    }
+    return state_ == Opened;
+}
+
+void DBWriter::enqueue(const DBMutation& mutation)
+{
+    QMutexLocker locker(&mutex_);
+    if (state_ != Opened || stopping_) {
+        return;
+    }
+    bool wasEmpty = queue_.empty();
+    queue_.push_back(mutation);
+    unsigned long long ticket = ++enqueued_;
+    ++queueDepth_;
+    if (wasEmpty || (int)queue_.size() >= settings_.groupCommitMaxBatch) {
+        queueCondition_.wakeOne();
+    }
+    if (settings_.syncCommit) {
+        while (committed_ < ticket && state_ == Opened) {
+            commitCondition_.wait(&mutex_);
+        }
+    }
+}
+
+void DBWriter::enqueue(const DBMutations& mutations)
+{
+    QMutexLocker locker(&mutex_);
+    if (state_ != Opened || stopping_ || mutations.empty()) {
+        return;
+    }
+    // the writer takes the whole queue at once, so they can't be split between batches
+    bool wasEmpty = queue_.empty();
+    queue_.insert(queue_.end(), mutations.begin(), mutations.end());
+    enqueued_ += mutations.size();
+    unsigned long long ticket = enqueued_;
+    queueDepth_ += mutations.size();
+    if (wasEmpty || (int)queue_.size() >= settings_.groupCommitMaxBatch) {
+        queueCondition_.wakeOne();
+    }
+    if (settings_.syncCommit) {
+        while (committed_ < ticket && state_ == Opened) {
+            commitCondition_.wait(&mutex_);
+        }
+    }
+}
+
+void DBWriter::stop()
+{
+    {
+        QMutexLocker locker(&mutex_);
+        stopping_ = true;
+        queueCondition_.wakeOne();
+    }
+    wait();
+}
+
+void DBWriter::run()
+{
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", writerConnectionName);
+        db.setDatabaseName(settings_.name);
+        bool opened = db.open();
+        if (opened) {
+            configure(db, settings_);
+        }
+
+        {
+            QMutexLocker locker(&mutex_);
+            state_ = opened ? Opened : Failed;
+            commitCondition_.wakeAll();
+        }
+
+        if (opened) {
+            DBStatements statements(db);
+
+            QMutexLocker locker(&mutex_);
+            while (true) {
+                while (queue_.empty() && !stopping_) {
+                    queueCondition_.wait(&mutex_);
+                }
+                if (queue_.empty()) {
+                    break;
+                }
+
+                // group commit: let the mutations which arrive during the window share the transaction
+                if (!stopping_ && !settings_.syncCommit && settings_.flushIntervalMs > 0) {
+                    QElapsedTimer timer;
+                    timer.start();
+                    qint64 remaining = settings_.flushIntervalMs;
+                    while (!stopping_ && remaining > 0 && (int)queue_.size() < settings_.groupCommitMaxBatch) {
+                        queueCondition_.wait(&mutex_, remaining);
+                        remaining = settings_.flushIntervalMs - timer.elapsed();
+                    }
+                }
+
+                DBMutations batch;
+                batch.swap(queue_);
+                locker.unlock();
+
+                write(db, statements, batch);
+
+                locker.relock();
+                committed_ += batch.size();
+                queueDepth_ -= batch.size();
+                commitCondition_.wakeAll();
+            }
+            if (image_ && !journal_->isEmpty()) {
+                writeSnapshot();
+            }
+            journal_->close();
+            Logger::info() << "Database writer stopped, mutations written = " + QString::number(committed_);
+        } else {
+            Logger::info() << "Failed to open database for writing";
+        }
+        db.close();
+    }
+    QSqlDatabase::removeDatabase(writerConnectionName);
+}
+
+void DBWriter::write(QSqlDatabase& db, DBStatements& statements, const DBMutations& batch)
+{
+    // a checkpoint splits the batch, the mutations before it are committed first
+    size_t begin = 0;
+    while (begin < batch.size()) {
+        size_t end = begin;
+        while (end < batch.size() && batch[end].type != DBMutation::Checkpoint) {
+            ++end;
+        }
+        commit(db, statements, batch, begin, end);
+        if (end < batch.size()) {
+            checkpoint(batch[end]);
+            ++end;
+        }
+        begin = end;
+    }
+
+    if (image_ && settings_.snapshotIntervalSec > 0 && !journal_->isEmpty() &&
+        snapshotTimer_.elapsed() >= settings_.snapshotIntervalSec * 1000LL) {
+        writeSnapshot();
+    }
+}
+
+void DBWriter::commit(QSqlDatabase& db, DBStatements& statements, const DBMutations& batch, size_t begin, size_t end)
+{
+    if (begin == end) {
+        return;
+    }
+
+    if (image_) {
+        for (size_t i = begin; i < end; ++i) {
+            Snapshot::apply(*image_, batch[i]);
+            journal_->append(batch[i]);
+        }
+        // written ahead of the commit, so the journal never misses a committed mutation
+        if (!journal_->flush()) {
+            disableSnapshots("failed to write the journal " + settings_.journalFile);
+        }
+    }
+
+    static Histogram* commitDuration = Metrics::instance().histogram("atom_engine_db_commit_duration_us", "Time of a group commit transaction, from begin to commit");
+    static Histogram* batchSize = Metrics::instance().histogram("atom_engine_db_commit_mutations", "Mutations written by a group commit transaction");
+    batchSize->record(end - begin);
+    MetricsTimer timer(commitDuration);
+    db.transaction();
+    for (size_t i = begin; i < end; ++i) {
+        statements.apply(batch[i]);
+    }
+    if (!db.commit()) {
+        Logger::info() << "Database commit failed: " + db.lastError().text();
+        db.rollback();
+    }
+}
+
+void DBWriter::checkpoint(const DBMutation& mutation)
+{
+    if (settings_.snapshotFile.isEmpty() || settings_.journalFile.isEmpty() || !mutation.snapshot) {
+        return;
+    }
+    image_ = mutation.snapshot;
+    snapshotTimer_.start();
+    if (mutation.id > 0) {
+        // the state is the snapshot on disk plus the journal which was replayed, keep appending to it
+        if (!journal_->open(settings_.journalFile, image_->generation, mutation.id)) {
+            disableSnapshots("failed to open the journal " + settings_.journalFile);
+        }
+    } else {
+        writeSnapshot();
+    }
+}
+
+void DBWriter::writeSnapshot()
+{
+    QElapsedTimer timer;
+    timer.start();
+    ++image_->generation;
+    if (!Snapshot::write(settings_.snapshotFile, *image_)) {
+        disableSnapshots("failed to write the snapshot " + settings_.snapshotFile);
+        return;
+    }
+    // a journal of the previous generation is ignored on loading, even if it is not truncated yet
+    if (!journal_->open(settings_.journalFile, image_->generation)) {
+        disableSnapshots("failed to open the journal " + settings_.journalFile);
+        return;
+    }
+    snapshotTimer_.restart();
+    Logger::info() << "Snapshot " + QString::number(image_->generation) + " was written in " + QString::number(timer.elapsed()) + " ms, orders = " + QString::number(image_->orders.size()) + ", trades = " + QString::number(image_->trades.size());
+}
+
+void DBWriter::disableSnapshots(const QString& reason)
+{
+    Logger::info() << "Snapshots are disabled: " + reason;
+    image_.reset();
+    journal_->close();
+    // the database is the only complete copy from now on, the next start must not load a stale snapshot
+    QFile::remove(settings_.snapshotFile);
+}
+
+void DBWriter::configure(QSqlDatabase& db, const DBSettings& settings)
+{
+    QSqlQuery query(db);
+
+    QString journalMode = settings.journalMode.toUpper();
+    if (journalModes.contains(journalMode)) {
+        query.exec("PRAGMA journal_mode=" + journalMode);
+    } else {
+        Logger::info() << "Unknown database journal mode " + settings.journalMode + ", using the SQLite default";
+    }
+
+    QString synchronous = settings.synchronous.toUpper();
+    if (synchronousLevels.contains(synchronous)) {
+        query.exec("PRAGMA synchronous=" + synchronous);
+    } else {
+        Logger::info() << "Unknown database synchronous level " + settings.synchronous + ", using the SQLite default";
+    }
+
+    if (settings.cacheSizeKb > 0) {
+        // negative cache_size is in KiB instead of pages
+        query.exec("PRAGMA cache_size=-" + QString::number(settings.cacheSizeKb));
+    }
+    if (settings.mmapSizeBytes >= 0) {
+        query.exec("PRAGMA mmap_size=" + QString::number(settings.mmapSizeBytes));
+    }
+}
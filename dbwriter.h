@@ -0,0 +1,161 @@
+// Copyright 2018 AtomicSwap Solutions Ltd. All rights reserved.
+// Use of this source code is governed by Microsoft Reference Source
+// License (MS-RSL) that can be found in the LICENSE file.
+
+#ifndef DBWRITER_H
+#define DBWRITER_H
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QElapsedTimer>
+#include <QString>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+struct OrderInfo;
+using OrderInfoPtr = std::shared_ptr<OrderInfo>;
+
+struct TradeInfo;
+using TradeInfoPtr = std::shared_ptr<TradeInfo>;
+
+struct SnapshotState;
+using SnapshotStatePtr = std::shared_ptr<SnapshotState>;
+
+class Journal;
+
+struct DBMutation {
+    enum Type {
+        AddOrder,
+        AddTrade,
+        AddToBlackList,
+        DeleteOrder,
+        DeleteTrade,
+        UpdateTrade,
+        // hands the loaded state to the writer, it is persisted as a snapshot from now on
+        Checkpoint,
+        RemoveFromBlackList
+    };
+
+    Type type;
+    OrderInfoPtr order;
+    TradeInfoPtr trade;
+    // order or trade id, expiry of a black list entry, journal size of a Checkpoint
+    long long id;
+    // black list entry
+    QString ip;
+    SnapshotStatePtr snapshot;
+};
+using DBMutations = std::vector<DBMutation>;
+
+struct DBSettings {
+    DBSettings() :
+        flushIntervalMs(50),
+        syncCommit(false),
+        groupCommitMaxBatch(1000),
+        journalMode("WAL"),
+        synchronous("NORMAL"),
+        cacheSizeKb(8192),
+        mmapSizeBytes(0),
+        snapshotIntervalSec(300)
+    {}
+
+    QString name;
+    // group commit window, mutations which arrive within it share one transaction
+    int flushIntervalMs;
+    // wait until the mutation is committed instead of returning as soon as it is queued
+    bool syncCommit;
+    // a batch is committed before the window ends once it has this many mutations
+    int groupCommitMaxBatch;
+    QString journalMode;
+    QString synchronous;
+    long long cacheSizeKb;
+    long long mmapSizeBytes;
+    // snapshot of the persisted state and the journal of mutations since it, empty names disable them
+    QString snapshotFile;
+    QString journalFile;
+    // a snapshot is written when the journal is not empty and this time passed since the last one, 0 writes it on shutdown only
+    int snapshotIntervalSec;
+};
+
+// Prepared statements of the writer on one database connection. apply() runs
+// the statements of a mutation, the caller owns the transaction.
+class DBStatements
+{
+public:
+    explicit DBStatements(const QSqlDatabase& db);
+
+    void apply(const DBMutation& mutation);
+private:
+    void bindTrade(QSqlQuery& query, const TradeInfoPtr& trade);
+private:
+    QSqlQuery addToOrders_;
+    QSqlQuery addToTrades_;
+    QSqlQuery addToBL_;
+    QSqlQuery deleteFromBL_;
+    QSqlQuery deleteFromOrders_;
+    QSqlQuery deleteFromTrades_;
+    QSqlQuery updateTrade_;
+};
+
+// Applies mutations queued by the server thread on its own thread and database
+// connection. Mutations which arrive within flushIntervalMs of the first
+// pending one are written in one transaction. With syncCommit enqueue() returns
+// only when the mutation is committed.
+//
+// After a Checkpoint the writer keeps its own copy of the persisted state. Every
+// transaction is written to the journal before it is committed, the state is
+// written to the snapshot file periodically and on stop, and then the journal
+// starts over.
+class DBWriter : public QThread
+{
+public:
+    explicit DBWriter(const DBSettings& settings);
+    ~DBWriter();
+
+    // journal mode, synchronous level and cache sizes, unknown values are logged and skipped
+    static void configure(QSqlDatabase& db, const DBSettings& settings);
+
+    bool open();
+    void enqueue(const DBMutation& mutation);
+    // the mutations are committed in one transaction
+    void enqueue(const DBMutations& mutations);
+    void stop();
+    int queueDepth() const { return queueDepth_; }
+protected:
+    void run() override;
+private:
+    void write(QSqlDatabase& db, DBStatements& statements, const DBMutations& batch);
+    void commit(QSqlDatabase& db, DBStatements& statements, const DBMutations& batch, size_t begin, size_t end);
+    void checkpoint(const DBMutation& mutation);
+    void writeSnapshot();
+    void disableSnapshots(const QString& reason);
+private:
+    enum State {
+        Starting,
+        Opened,
+        Failed
+    };
+
+    DBSettings settings_;
+
+    QMutex mutex_;
+    QWaitCondition queueCondition_;
+    QWaitCondition commitCondition_;
+    DBMutations queue_;
+    State state_;
+    bool stopping_;
+    unsigned long long enqueued_;
+    unsigned long long committed_;
+    std::atomic<int> queueDepth_;
+
+    // used by the writer thread only
+    SnapshotStatePtr image_;
+    std::unique_ptr<Journal> journal_;
+    QElapsedTimer snapshotTimer_;
+};
+
+#endif // DBWRITER_H
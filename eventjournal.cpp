@@ -0,0 +1,73 @@
+// Copyright 2018 AtomicSwap Solutions Ltd. All rights reserved.
+// Use of this source code is governed by Microsoft Reference Source
+// License (MS-RSL) that can be found in the LICENSE file.
+
+#include "eventjournal.h"
+#include <QDateTime>
+
+EventJournal::EventJournal() :
+    epoch_(QDateTime::currentMSecsSinceEpoch()),
+    lastSeq_(0),
+    bytes_(0),
+    maxEvents_(100000),
+    maxBytes_(64 * 1024 * 1024)
+{
+}
+
+void EventJournal::setLimits(size_t maxEvents, long long maxBytes)
+{
+    maxEvents_ = maxEvents;
+    maxBytes_ = maxBytes;
+}
+
+long long EventJournal::nextSeq()
+{
+    return ++lastSeq_;
+}
+
+void EventJournal::append(long long seq, const QByteArray& json)
+{
+    Event event;
+    event.seq = seq;
+    event.json = json;
+    event.isPrivate = false;
+    push(event);
+}
+
+void EventJournal::appendPrivate(long long seq, const QByteArray& json, const QString& firstAddr, const QString& secondAddr)
+{
+    Event event;
+    event.seq = seq;
+    event.json = json;
+    event.firstAddr = firstAddr;
+    event.secondAddr = secondAddr;
+    event.isPrivate = true;
+    push(event);
+}
+
+void EventJournal::push(Event& event)
+{
+    // the json is shared with the message which was sent, so it costs no copy
+    bytes_ += event.json.size();
+    events_.push_back(event);
+    while (!events_.empty() && (events_.size() > maxEvents_ || bytes_ > maxBytes_)) {
+        bytes_ -= events_.front().json.size();
+        events_.pop_front();
+    }
+}
+
+bool EventJournal::since(long long seq, Events& events) const
+{
+    if (seq > lastSeq_ || seq < 0) {
+        return false;
+    }
+    long long firstSeq = events_.empty() ? lastSeq_ + 1 : events_.front().seq;
+    if (seq + 1 < firstSeq) {
+        return false;
+    }
+    // seqs are consecutive, so the first missed event is found by offset
+    for (size_t i = seq + 1 - firstSeq; i < events_.size(); ++i) {
+        events.push_back(&events_[i]);
+    }
+    return true;
+}
@@ -0,0 +1,55 @@
+// Copyright 2018 AtomicSwap Solutions Ltd. All rights reserved.
+// Use of this source code is governed by Microsoft Reference Source
+// License (MS-RSL) that can be found in the LICENSE file.
+
+#ifndef EVENTJOURNAL_H
+#define EVENTJOURNAL_H
+
+#include <QByteArray>
+#include <QString>
+#include <deque>
+#include <vector>
+
+// Recent order, trade and presence events in sequence order, bounded by count
+// and size. Every event message carries its "seq", a client which reconnects
+// with the last seq it saw gets the newer events instead of the whole state.
+// Sequence numbers start over with every run, the epoch tells runs apart.
+class EventJournal
+{
+public:
+    struct Event {
+        long long seq;
+        // the message as it was sent, with its '\n'
+        QByteArray json;
+        // a trade event is replayed only to the owners of these addresses, other events to everyone
+        QString firstAddr;
+        QString secondAddr;
+        bool isPrivate;
+    };
+    using Events = std::vector<const Event*>;
+
+    EventJournal();
+
+    void setLimits(size_t maxEvents, long long maxBytes);
+    long long epoch() const { return epoch_; }
+    long long lastSeq() const { return lastSeq_; }
+
+    // the seq for the next event, it must be appended before the following call
+    long long nextSeq();
+    void append(long long seq, const QByteArray& json);
+    void appendPrivate(long long seq, const QByteArray& json, const QString& firstAddr, const QString& secondAddr);
+
+    // events after seq, false when some of them are already dropped or seq is from the future
+    bool since(long long seq, Events& events) const;
+private:
+    void push(Event& event);
+private:
+    std::deque<Event> events_;
+    long long epoch_;
+    long long lastSeq_;
+    long long bytes_;
+    size_t maxEvents_;
+    long long maxBytes_;
+};
+
+#endif // EVENTJOURNAL_H
@@ -3,120 +3,174 @@
 // License (MS-RSL) that can be found in the LICENSE file.
 
 #include "info.h"
-#include <QVariant>
 #include <QCryptographicHash>
+#include <QMutex>
+#include <cstring>
+#include <map>
+#include "slabpool.h"
+
+namespace {
+    // codes are a few letters, requests can't fill the table with long names
+    const int maxCurrencyLength = 16;
+    // index 0 is the empty code
+    const int maxCurrencies = 4096;
+
+    QMutex currenciesMutex;
+    std::map<QString, quint16> currencyIndexes;
+    // a text is written under the mutex before its index is handed out and
+    // never changes after that, so it is read without the mutex
+    QString currencyTexts[maxCurrencies];
+}
 
-OrderInfo::OrderInfo(long long orderId, const QJsonObject& order) :
-    orderId_(orderId)
+CurrencyCode CurrencyCode::fromString(const QString& text)
 {
-    sendCur_ = order["sendCur"].toString();
-    sendCount_ = order["sendCount"].toVariant().toLongLong();
-    getCur_ = order["getCur"].toString();
-    getCount_ = order["getCount"].toVariant().toLongLong();
-    getAddress_ = order["getAddr"].toString();
+    if (text.isEmpty()) {
+        return CurrencyCode();
+    }
+    if (text.size() > maxCurrencyLength) {
+        return CurrencyCode(invalidIndex);
+    }
+    QMutexLocker locker(&currenciesMutex);
+    auto it = currencyIndexes.find(text);
+    if (it != currencyIndexes.end()) {
+        return CurrencyCode(it->second);
+    }
+    quint16 index = quint16(currencyIndexes.size() + 1);
+    if (index >= maxCurrencies) {
+        return CurrencyCode(invalidIndex);
+    }
+    currencyTexts[index] = text;
+    currencyIndexes.emplace(text, index);
+    return CurrencyCode(index);
 }
 
-QString OrderInfo::getJson() const
+const QString& CurrencyCode::toString() const
 {
-    QString res = "{\"sendCur\": \"" + sendCur_ + "\", \"getCur\": \"" + getCur_ + "\", \"sendCount\": " + QString::number(sendCount_) + ", \"getCount\": " + QString::number(getCount_) + ", \"getAddr\": \"" + getAddress_ + "\", \"id\": " + QString::number(orderId_) + "}";
-    return res;
+    return currencyTexts[isValid() ? index_ : 0];
 }
 
-void OrderInfo::sign(const QString& key)
+QDataStream& operator << (QDataStream& out, const CompactString& text)
 {
-    if (key != "") {
-        keyHash_ = QString(QCryptographicHash::hash(key.toUtf8(), QCryptographicHash::Md5).toHex());
-    } else {
-        keyHash_ = "";
+    return out << text.toString();
+}
+
+QDataStream& operator >> (QDataStream& in, CompactString& text)
+{
+    QString value;
+    in >> value;
+    text = value;
+    return in;
+}
+
+void KeyHash::sign(const QString& key)
+{
+    isSet_ = key != "";
+    if (isSet_) {
+        QByteArray digest = QCryptographicHash::hash(key.toUtf8(), QCryptographicHash::Md5);
+        std::memcpy(digest_, digest.constData(), sizeof(digest_));
     }
 }
 
-bool OrderInfo::checkKey(const QString& key)
+bool KeyHash::check(const QString& key) const
 {
-    if (keyHash_ == "") {
+    if (!isSet_) {
         return true;
     }
-
     if (key == "") {
         return false;
     }
-
-    QString keyHash = QString(QCryptographicHash::hash(key.toUtf8(), QCryptographicHash::Md5).toHex());
-    return keyHash_ == keyHash ? true : false;
+    QByteArray digest = QCryptographicHash::hash(key.toUtf8(), QCryptographicHash::Md5);
+    return std::memcmp(digest_, digest.constData(), sizeof(digest_)) == 0;
 }
 
-QString TradeInfo::getJson() const
+QString KeyHash::toHex() const
 {
-    QString paidInit = "false";
-    if (initiatorCommissionPaid_) {
-        paidInit = "true";
+    if (!isSet_) {
+        return "";
     }
+    return QString::fromLatin1(QByteArray::fromRawData(reinterpret_cast<const char*>(digest_), sizeof(digest_)).toHex());
+}
 
-    QString paidPart = "false";
-    if (participantCommissionPaid_) {
-        paidPart = "true";
+void KeyHash::setHex(const QString& hex)
+{
+    isSet_ = hex != "";
+    if (isSet_) {
+        // a hash which is not an MD5 hex text is set but matches no key, like before
+        QByteArray digest = QByteArray::fromHex(hex.toLatin1());
+        std::memset(digest_, 0, sizeof(digest_));
+        if (digest.size() == int(sizeof(digest_))) {
+            std::memcpy(digest_, digest.constData(), sizeof(digest_));
+        }
     }
+}
 
-    QString refundedInitStr = "false";
-    if (refundedInit_) {
-        refundedInitStr = "true";
-    }
-    QString refundedPartStr = "false";
-    if (refundedPart_) {
-        refundedPartStr = "true";
-    }
+OrderInfoPtr OrderInfo::create()
+{
+    return std::allocate_shared<OrderInfo>(PoolAllocator<OrderInfo>());
+}
 
-    QString res = "{" \
-                    "\"id\": " + QString::number(tradeId_) + ", " \
-                    "\"refundedInit\": " + refundedInitStr + ", " \
-                    "\"refundedPart\": " + refundedPartStr + ", " \
-                    "\"refundTimeInit\": " + QString::number(refundTimeInit_) + ", " \
-                    "\"refundTimePart\": " + QString::number(refundTimePart_) + ", " \
-                    "\"order\": " + order_->getJson() + ", " \
-                    "\"initiatorAddr\": \"" + initiatorAddress_ + "\", " \
-                    "\"secretHash\": \"" + secretHash_ + "\", " \
-                    "\"contractInitiator\": \"" + contractInitiator_ + "\", " \
-                    "\"contractParticipant\": \"" + contractParticipant_ + "\", " \
-                    "\"initiatorContractTransaction\": \"" + initiatorContractTransaction_ + "\", " \
-                    "\"participantContractTransaction\": \"" + participantContractTransaction_ + "\", " \
-                    "\"initiatorRedemptionTransaction\": \"" + initiatorRedemptionTransaction_ + "\", " \
-                    "\"participantRedemptionTransaction\": \"" + participantRedemptionTransaction_ + "\", " \
-                    "\"commissionInitiatorPaid\": " + paidInit + ", " \
-                    "\"commissionParticipantPaid\": " + paidPart + "}";
-    return res;
-}
-
-void TradeInfo::sign(const QString& key)
-{
-    if (key != "") {
-        keyHash_ = QString(QCryptographicHash::hash(key.toUtf8(), QCryptographicHash::Md5).toHex());
-    } else {
-        keyHash_ = "";
-    }
+TradeInfoPtr TradeInfo::create()
+{
+    return std::allocate_shared<TradeInfo>(PoolAllocator<TradeInfo>());
 }
 
-bool TradeInfo::checkKey(const QString& key)
+TradeInfoPtr TradeInfo::create(long long tradeId, OrderInfoPtr order, const QString& initiatorAddress)
 {
-    if (keyHash_ == "") {
-        return true;
+    return std::allocate_shared<TradeInfo>(PoolAllocator<TradeInfo>(), tradeId, order, initiatorAddress);
+}
+
+TradeInfoPtr TradeInfo::create(const TradeInfo& trade)
+{
+    return std::allocate_shared<TradeInfo>(PoolAllocator<TradeInfo>(), trade);
+}
+
+const QByteArray& OrderInfo::getJson() const
+{
+    if (json_.isEmpty()) {
+        json_ = "{\"sendCur\": \"" + sendCur_.toString().toUtf8() + "\", \"getCur\": \"" + getCur_.toString().toUtf8() + "\", \"sendCount\": " + QByteArray::number(sendCount_) + ", \"getCount\": " + QByteArray::number(getCount_) + ", \"getAddr\": \"" + getAddress_.toUtf8() + "\", \"id\": " + QByteArray::number(orderId_) + "}";
     }
+    return json_;
+}
 
-    if (key == "") {
-        return false;
+const QByteArray& TradeInfo::getJson() const
+{
+    if (!json_.isEmpty()) {
+        return json_;
     }
 
-    QString keyHash = QString(QCryptographicHash::hash(key.toUtf8(), QCryptographicHash::Md5).toHex());
-    return keyHash_ == keyHash ? true : false;
+    const char* paidInit = initiatorCommissionPaid_ ? "true" : "false";
+    const char* paidPart = participantCommissionPaid_ ? "true" : "false";
+    const char* refundedInitStr = refundedInit_ ? "true" : "false";
+    const char* refundedPartStr = refundedPart_ ? "true" : "false";
+
+    json_ = "{" \
+            "\"id\": " + QByteArray::number(tradeId_) + ", " \
+            "\"refundedInit\": " + refundedInitStr + ", " \
+            "\"refundedPart\": " + refundedPartStr + ", " \
+            "\"refundTimeInit\": " + QByteArray::number(refundTimeInit_) + ", " \
+            "\"refundTimePart\": " + QByteArray::number(refundTimePart_) + ", " \
+            "\"order\": " + order_->getJson() + ", " \
+            "\"initiatorAddr\": \"" + initiatorAddress_.toUtf8() + "\", " \
+            "\"secretHash\": \"" + secretHash_.utf8() + "\", " \
+            "\"contractInitiator\": \"" + contractInitiator_.utf8() + "\", " \
+            "\"contractParticipant\": \"" + contractParticipant_.utf8() + "\", " \
+            "\"initiatorContractTransaction\": \"" + initiatorContractTransaction_.utf8() + "\", " \
+            "\"participantContractTransaction\": \"" + participantContractTransaction_.utf8() + "\", " \
+            "\"initiatorRedemptionTransaction\": \"" + initiatorRedemptionTransaction_.utf8() + "\", " \
+            "\"participantRedemptionTransaction\": \"" + participantRedemptionTransaction_.utf8() + "\", " \
+            "\"commissionInitiatorPaid\": " + paidInit + ", " \
+            "\"commissionParticipantPaid\": " + paidPart + "}";
+    return json_;
 }
 
-bool TradeInfo::checkOrderKey(const QString& key)
+bool TradeInfo::checkOrderKey(const QString& key) const
 {
     return order_->checkKey(key);
 }
 
 bool TradeInfo::isComplited() const
 {
-    if (!initiatorRedemptionTransaction_.isNull() && !initiatorRedemptionTransaction_.isEmpty() && !participantRedemptionTransaction_.isNull() && !participantRedemptionTransaction_.isEmpty()) {
+    if (!initiatorRedemptionTransaction_.isEmpty() && !participantRedemptionTransaction_.isEmpty()) {
         return true;
     }
     if (refundedInit_ && refundedPart_) {
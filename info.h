@@ -7,29 +7,108 @@
 
 #include <memory>
 #include <QString>
-#include <QJsonObject>
+#include <QByteArray>
+#include <QDataStream>
 
 struct OrderInfo;
 typedef std::shared_ptr<OrderInfo> OrderInfoPtr;
 
+struct TradeInfo;
+typedef std::shared_ptr<TradeInfo> TradeInfoPtr;
+
+// A currency code of an order: the index of the code in a process-wide table
+// of the codes seen so far, two bytes in every order instead of a QString.
+class CurrencyCode
+{
+public:
+    // the empty code
+    CurrencyCode() : index_(0) {}
+
+    // a text which is too long or beyond the limit of distinct codes gives an
+    // invalid code, so requests can't grow the table forever
+    static CurrencyCode fromString(const QString& text);
+
+    bool isValid() const { return index_ != invalidIndex; }
+    // a null string for the empty and for an invalid code
+    const QString& toString() const;
+
+    bool operator == (const CurrencyCode& other) const { return index_ == other.index_; }
+    bool operator != (const CurrencyCode& other) const { return index_ != other.index_; }
+private:
+    static const quint16 invalidIndex = 0xffff;
+
+    explicit CurrencyCode(quint16 index) : index_(index) {}
+
+    quint16 index_;
+};
+
+// UTF-8 text of a field which is only stored and sent, like a secret hash or
+// a transaction id. These are ASCII, so they take half the memory of a QString.
+class CompactString
+{
+public:
+    CompactString() {}
+    CompactString(const QString& text) : utf8_(text.toUtf8()) {}
+    CompactString(const char* text) : utf8_(text) {}
+
+    // a null string for a null text, so the database gets NULL as before
+    QString toString() const { return QString::fromUtf8(utf8_); }
+    const QByteArray& utf8() const { return utf8_; }
+    bool isEmpty() const { return utf8_.isEmpty(); }
+private:
+    QByteArray utf8_;
+};
+
+// streamed as a QString, the snapshot format does not depend on the layout
+QDataStream& operator << (QDataStream& out, const CompactString& text);
+QDataStream& operator >> (QDataStream& in, CompactString& text);
+
+// MD5 of the key an order or trade is signed with, 16 bytes instead of the
+// QString of its hex text. Keys are checked by comparing the digests.
+class KeyHash
+{
+public:
+    KeyHash() : isSet_(false) {}
+
+    // not set for an empty key, then every key matches
+    void sign(const QString& key);
+    bool check(const QString& key) const;
+    // lowercase hex like the database stores it, empty when not set
+    QString toHex() const;
+    void setHex(const QString& hex);
+private:
+    unsigned char digest_[16];
+    bool isSet_;
+};
+
+// Orders and trades come from slab pools by create(), see slabpool.h.
 struct OrderInfo {
     OrderInfo() {}
-    OrderInfo(long long orderId, const QJsonObject& order);
+
+    static OrderInfoPtr create();
+
     long long orderId_;
-    QString sendCur_;
     long long sendCount_;
-    QString getCur_;
     long long getCount_;
     QString getAddress_;
+    CurrencyCode sendCur_;
+    CurrencyCode getCur_;
 
-    QString getJson() const;
-    void sign(const QString& key);
-    bool checkKey(const QString& key);
+    // the order book sorts by getCount_ / sendCount_, an order without positive counts has no price
+    bool hasPrice() const { return sendCount_ > 0 && getCount_ > 0; }
+    bool hasValidCurrencies() const { return sendCur_.isValid() && getCur_.isValid(); }
 
-    const QString& getHash() const { return keyHash_; }
-    void setHash(const QString& keyHash) { keyHash_ = keyHash; }
+    // UTF-8 encoded, built on first use, invalidateJson() after a field is changed
+    const QByteArray& getJson() const;
+    void invalidateJson() { json_.clear(); }
+    void sign(const QString& key) { keyHash_.sign(key); }
+    bool checkKey(const QString& key) const { return keyHash_.check(key); }
+
+    QString getHash() const { return keyHash_.toHex(); }
+    void setHash(const QString& keyHash) { keyHash_.setHex(keyHash); }
 private:
-    QString keyHash_;
+    KeyHash keyHash_;
+    mutable QByteArray json_;
 };
 
 struct TradeInfo {
@@ -46,21 +125,26 @@ struct TradeInfo {
         refundTimePart_(0)
     {}
 
+    static TradeInfoPtr create();
+    static TradeInfoPtr create(long long tradeId, OrderInfoPtr order, const QString& initiatorAddress);
+    // a copy for another thread, the strings are shared until one side changes them
+    static TradeInfoPtr create(const TradeInfo& trade);
+
     long long tradeId_;
 
     OrderInfoPtr order_;
     QString initiatorAddress_;
 
-    QString secretHash_;
+    CompactString secretHash_;
 
-    QString contractInitiator_;
-    QString contractParticipant_;
+    CompactString contractInitiator_;
+    CompactString contractParticipant_;
 
-    QString initiatorContractTransaction_;
-    QString participantContractTransaction_;
+    CompactString initiatorContractTransaction_;
+    CompactString participantContractTransaction_;
 
-    QString initiatorRedemptionTransaction_;
-    QString participantRedemptionTransaction_;
+    CompactString initiatorRedemptionTransaction_;
+    CompactString participantRedemptionTransaction_;
 
     bool initiatorCommissionPaid_;
     bool participantCommissionPaid_;
@@ -70,17 +154,20 @@ struct TradeInfo {
     long long refundTimeInit_;
     long long refundTimePart_;
 
-    QString getJson() const;
-    void sign(const QString& key);
-    bool checkKey(const QString& key);
-    bool checkOrderKey(const QString& key);
+    // UTF-8 encoded, built on first use, invalidateJson() after a field is changed
+    const QByteArray& getJson() const;
+    void invalidateJson() { json_.clear(); }
+    void sign(const QString& key) { keyHash_.sign(key); }
+    bool checkKey(const QString& key) const { return keyHash_.check(key); }
+    bool checkOrderKey(const QString& key) const;
 
-    const QString& getHash() const { return keyHash_; }
-    void setHash(const QString& keyHash) { keyHash_ = keyHash; }
+    QString getHash() const { return keyHash_.toHex(); }
+    void setHash(const QString& keyHash) { keyHash_.setHex(keyHash); }
 
     bool isComplited() const;
 private:
-    QString keyHash_;
+    KeyHash keyHash_;
+    mutable QByteArray json_;
 };
 
 #endif // INFO_H
@@ -0,0 +1,78 @@
+// Copyright 2018 AtomicSwap Solutions Ltd. All rights reserved.
+// Use of this source code is governed by Microsoft Reference Source
+// License (MS-RSL) that can be found in the LICENSE file.
+
+#ifndef IPKEY_H
+#define IPKEY_H
+
+#include <QHostAddress>
+#include <QString>
+#include <cstddef>
+
+// A client address as 128 bits, IPv4 addresses are IPv4-mapped IPv6. It is
+// parsed once per connection, so per request tables compare two integers
+// instead of hashing strings.
+struct IpKey {
+    quint64 high;
+    quint64 low;
+
+    IpKey() : high(0), low(0) {}
+
+    static IpKey fromString(const QString& ip)
+    {
+        return fromAddress(QHostAddress(ip));
+    }
+
+    static IpKey fromAddress(const QHostAddress& address)
+    {
+        Q_IPV6ADDR bytes = address.toIPv6Address();
+        return fromIPv6(&bytes[0]);
+    }
+
+    static IpKey fromIPv6(const quint8* bytes)
+    {
+        IpKey key;
+        for (int i = 0; i < 8; ++i) {
+            key.high = key.high << 8 | bytes[i];
+            key.low = key.low << 8 | bytes[i + 8];
+        }
+        return key;
+    }
+
+    static IpKey fromIPv4(quint32 address)
+    {
+        IpKey key;
+        key.low = Q_UINT64_C(0xffff00000000) | address;
+        return key;
+    }
+
+    // the first length bits, the rest is zero
+    IpKey prefix(int length) const
+    {
+        IpKey key;
+        if (length >= 64) {
+            key.high = high;
+            key.low = length >= 128 ? low : low & ~(~Q_UINT64_C(0) >> (length - 64));
+        } else if (length > 0) {
+            key.high = high & ~(~Q_UINT64_C(0) >> length);
+        }
+        return key;
+    }
+
+    bool operator==(const IpKey& other) const { return high == other.high && low == other.low; }
+    bool operator!=(const IpKey& other) const { return !(*this == other); }
+};
+
+struct IpKeyHash {
+    size_t operator()(const IpKey& key) const
+    {
+        // the low half differs between IPv4 clients, the mix spreads it over all bits
+        quint64 h = key.low ^ (key.high * 0x9e3779b97f4a7c15ULL);
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        return static_cast<size_t>(h);
+    }
+};
+
+#endif // IPKEY_H
@@ -0,0 +1,473 @@
+// Copyright 2018 AtomicSwap Solutions Ltd. All rights reserved.
+// Use of this source code is governed by Microsoft Reference Source
+// License (MS-RSL) that can be found in the LICENSE file.
+
+#include "jsonreader.h"
+#include <QtGlobal>
+
+namespace {
+    const quint64 ones = Q_UINT64_C(0x0101010101010101);
+    const quint64 highBits = Q_UINT64_C(0x8080808080808080);
+    // deeper skipped values are rejected, requests never nest that much
+    const int maxSkipDepth = 64;
+
+    // a byte of chunk equals c
+    inline bool hasByte(quint64 chunk, char c)
+    {
+        quint64 x = chunk ^ (ones * quint8(c));
+        return ((x - ones) & ~x & highBits) != 0;
+    }
+
+    void appendUtf8(QByteArray& result, uint code)
+    {
+        if (code < 0x80) {
+            result += char(code);
+        } else if (code < 0x800) {
+            result += char(0xc0 | (code >> 6));
+            result += char(0x80 | (code & 0x3f));
+        } else if (code < 0x10000) {
+            result += char(0xe0 | (code >> 12));
+            result += char(0x80 | ((code >> 6) & 0x3f));
+            result += char(0x80 | (code & 0x3f));
+        } else {
+            result += char(0xf0 | (code >> 18));
+            result += char(0x80 | ((code >> 12) & 0x3f));
+            result += char(0x80 | ((code >> 6) & 0x3f));
+            result += char(0x80 | (code & 0x3f));
+        }
+    }
+
+    bool readHex4(const char* p, uint& code)
+    {
+        code = 0;
+        for (int i = 0; i < 4; ++i) {
+            char c = p[i];
+            code <<= 4;
+            if (c >= '0' && c <= '9') {
+                code |= uint(c - '0');
+            } else if (c >= 'a' && c <= 'f') {
+                code |= uint(c - 'a' + 10);
+            } else if (c >= 'A' && c <= 'F') {
+                code |= uint(c - 'A' + 10);
+            } else {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // like QVariant(double).toLongLong()
+    long long toInteger(const QByteArray& number, bool integral)
+    {
+        bool ok = false;
+        if (integral) {
+            long long value = number.toLongLong(&ok);
+            if (ok) {
+                return value;
+            }
+        }
+        double value = number.toDouble(&ok);
+        return ok ? qRound64(value) : 0;
+    }
+}
+
+JsonReader::JsonReader(const char* data, int size) :
+    pos_(data),
+    end_(data + size),
+    error_(false)
+{
+}
+
+JsonReader::JsonReader(const QByteArray& data) :
+    JsonReader(data.constData(), data.size())
+{
+}
+
+void JsonReader::skipWhitespace()
+{
+    while (pos_ < end_ && (*pos_ == ' ' || *pos_ == '\n' || *pos_ == '\r' || *pos_ == '\t')) {
+        ++pos_;
+    }
+}
+
+char JsonReader::peek()
+{
+    skipWhitespace();
+    return pos_ < end_ ? *pos_ : '\0';
+}
+
+bool JsonReader::fail()
+{
+    error_ = true;
+    pos_ = end_;
+    return false;
+}
+
+bool JsonReader::expect(char c)
+{
+    skipWhitespace();
+    if (pos_ == end_ || *pos_ != c) {
+        return fail();
+    }
+    ++pos_;
+    return true;
+}
+
+bool JsonReader::beginObject()
+{
+    if (error_ || !expect('{')) {
+        return false;
+    }
+    first_.push_back(true);
+    return true;
+}
+
+bool JsonReader::beginArray()
+{
+    if (error_ || !expect('[')) {
+        return false;
+    }
+    first_.push_back(true);
+    return true;
+}
+
+bool JsonReader::nextItem(char close)
+{
+    if (error_ || first_.empty()) {
+        return fail();
+    }
+    skipWhitespace();
+    if (pos_ < end_ && *pos_ == close) {
+        ++pos_;
+        first_.pop_back();
+        return false;
+    }
+    if (!first_.back() && !expect(',')) {
+        return false;
+    }
+    first_.back() = false;
+    return true;
+}
+
+bool JsonReader::nextMember(Name& name)
+{
+    if (!nextItem('}')) {
+        return false;
+    }
+    skipWhitespace();
+    const char* begin;
+    const char* end;
+    bool escaped;
+    if (pos_ == end_ || *pos_ != '"' || !readRawString(begin, end, escaped) || !expect(':')) {
+        return fail();
+    }
+    name.data = begin;
+    name.size = int(end - begin);
+    return true;
+}
+
+bool JsonReader::nextElement()
+{
+    return nextItem(']');
+}
+
+const char* JsonReader::findStringEnd(bool& escaped) const
+{
+    const char* p = pos_ + 1;
+    escaped = false;
+    while (true) {
+        while (end_ - p >= 8) {
+            quint64 chunk;
+            std::memcpy(&chunk, p, 8);
+            if (hasByte(chunk, '"') || hasByte(chunk, '\\')) {
+                break;
+            }
+            p += 8;
+        }
+        while (p < end_ && *p != '"' && *p != '\\') {
+            ++p;
+        }
+        if (p >= end_) {
+            return nullptr;
+        }
+        if (*p == '"') {
+            return p;
+        }
+        escaped = true;
+        p += 2;
+    }
+}
+
+bool JsonReader::readRawString(const char*& begin, const char*& end, bool& escaped)
+{
+    const char* quote = findStringEnd(escaped);
+    if (!quote) {
+        return fail();
+    }
+    begin = pos_ + 1;
+    end = quote;
+    pos_ = quote + 1;
+    return true;
+}
+
+bool JsonReader::unescape(const char* begin, const char* end, QByteArray& result) const
+{
+    result.reserve(int(end - begin));
+    for (const char* p = begin; p < end; ++p) {
+        if (*p != '\\') {
+            result += *p;
+            continue;
+        }
+        ++p;
+        switch (*p) {
+        case '"': result += '"'; break;
+        case '\\': result += '\\'; break;
+        case '/': result += '/'; break;
+        case 'b': result += '\b'; break;
+        case 'f': result += '\f'; break;
+        case 'n': result += '\n'; break;
+        case 'r': result += '\r'; break;
+        case 't': result += '\t'; break;
+        case 'u': {
+            uint code;
+            if (end - p < 5 || !readHex4(p + 1, code)) {
+                return false;
+            }
+            p += 4;
+            // a surrogate pair is one code point
+            uint low;
+            if (code >= 0xd800 && code < 0xdc00 && end - p >= 7 && p[1] == '\\' && p[2] == 'u' &&
+                    readHex4(p + 3, low) && low >= 0xdc00 && low < 0xe000) {
+                code = 0x10000 + ((code - 0xd800) << 10) + (low - 0xdc00);
+                p += 6;
+            }
+            appendUtf8(result, code);
+            break;
+        }
+        default:
+            return false;
+        }
+    }
+    return true;
+}
+
+bool JsonReader::scanNumber(const char*& begin, const char*& end)
+{
+    begin = pos_;
+    const char* p = pos_;
+    if (p < end_ && *p == '-') {
+        ++p;
+    }
+    const char* digits = p;
+    while (p < end_ && *p >= '0' && *p <= '9') {
+        ++p;
+    }
+    if (p == digits) {
+        return fail();
+    }
+    if (p < end_ && *p == '.') {
+        digits = ++p;
+        while (p < end_ && *p >= '0' && *p <= '9') {
+            ++p;
+        }
+        if (p == digits) {
+            return fail();
+        }
+    }
+    if (p < end_ && (*p == 'e' || *p == 'E')) {
+        ++p;
+        if (p < end_ && (*p == '+' || *p == '-')) {
+            ++p;
+        }
+        digits = p;
+        while (p < end_ && *p >= '0' && *p <= '9') {
+            ++p;
+        }
+        if (p == digits) {
+            return fail();
+        }
+    }
+    end = p;
+    pos_ = p;
+    return true;
+}
+
+bool JsonReader::skipLiteral(const char* literal, int size)
+{
+    if (end_ - pos_ < size || std::memcmp(pos_, literal, size) != 0) {
+        return fail();
+    }
+    pos_ += size;
+    return true;
+}
+
+bool JsonReader::skipContainer()
+{
+    char closing[maxSkipDepth];
+    int depth = 0;
+    while (pos_ < end_) {
+        char c = *pos_;
+        if (c == '"') {
+            const char* begin;
+            const char* end;
+            bool escaped;
+            if (!readRawString(begin, end, escaped)) {
+                return false;
+            }
+            continue;
+        }
+        if (c == '{' || c == '[') {
+            if (depth == maxSkipDepth) {
+                return fail();
+            }
+            closing[depth++] = c == '{' ? '}' : ']';
+        } else if (c == '}' || c == ']') {
+            if (depth == 0 || closing[depth - 1] != c) {
+                return fail();
+            }
+            if (--depth == 0) {
+                ++pos_;
+                return true;
+            }
+        }
+        ++pos_;
+    }
+    return fail();
+}
+
+bool JsonReader::skipValue()
+{
+    if (error_) {
+        return false;
+    }
+    skipWhitespace();
+    if (pos_ == end_) {
+        return fail();
+    }
+    const char* begin;
+    const char* end;
+    bool escaped;
+    switch (*pos_) {
+    case '"':
+        return readRawString(begin, end, escaped);
+    case '{':
+    case '[':
+        return skipContainer();
+    case 't':
+        return skipLiteral("true", 4);
+    case 'f':
+        return skipLiteral("false", 5);
+    case 'n':
+        return skipLiteral("null", 4);
+    default:
+        return scanNumber(begin, end);
+    }
+}
+
+bool JsonReader::readString(QString& value)
+{
+    value = QString();
+    if (error_) {
+        return false;
+    }
+    skipWhitespace();
+    if (pos_ == end_ || *pos_ != '"') {
+        return skipValue();
+    }
+    const char* begin;
+    const char* end;
+    bool escaped;
+    if (!readRawString(begin, end, escaped)) {
+        return false;
+    }
+    if (!escaped) {
+        value = QString::fromUtf8(begin, int(end - begin));
+        return true;
+    }
+    QByteArray utf8;
+    if (!unescape(begin, end, utf8)) {
+        return fail();
+    }
+    value = QString::fromUtf8(utf8);
+    return true;
+}
+
+bool JsonReader::readRawString(Name& value)
+{
+    value = Name();
+    if (error_) {
+        return false;
+    }
+    skipWhitespace();
+    if (pos_ == end_ || *pos_ != '"') {
+        return skipValue();
+    }
+    const char* begin;
+    const char* end;
+    bool escaped;
+    if (!readRawString(begin, end, escaped)) {
+        return false;
+    }
+    value.data = begin;
+    value.size = int(end - begin);
+    return true;
+}
+
+bool JsonReader::readInteger(long long& value)
+{
+    value = 0;
+    if (error_) {
+        return false;
+    }
+    skipWhitespace();
+    if (pos_ == end_) {
+        return fail();
+    }
+    const char* begin;
+    const char* end;
+    char c = *pos_;
+    if (c == '"') {
+        QString text;
+        if (!readString(text)) {
+            return false;
+        }
+        value = text.toLongLong();
+        return true;
+    }
+    if (c == '-' || (c >= '0' && c <= '9')) {
+        if (!scanNumber(begin, end)) {
+            return false;
+        }
+        QByteArray number = QByteArray::fromRawData(begin, int(end - begin));
+        bool integral = std::memchr(begin, '.', end - begin) == nullptr && std::memchr(begin, 'e', end - begin) == nullptr
+                && std::memchr(begin, 'E', end - begin) == nullptr;
+        value = toInteger(number, integral);
+        return true;
+    }
+    if (c == 't') {
+        value = 1;
+    }
+    return skipValue();
+}
+
+bool JsonReader::readBool(bool& value)
+{
+    value = false;
+    if (error_) {
+        return false;
+    }
+    skipWhitespace();
+    if (pos_ < end_ && *pos_ == 't') {
+        value = true;
+    }
+    return skipValue();
+}
+
+bool JsonReader::atEnd()
+{
+    if (error_ || !first_.empty()) {
+        return false;
+    }
+    skipWhitespace();
+    return pos_ == end_;
+}
@@ -0,0 +1,98 @@
+// Copyright 2018 AtomicSwap Solutions Ltd. All rights reserved.
+// Use of this source code is governed by Microsoft Reference Source
+// License (MS-RSL) that can be found in the LICENSE file.
+
+#ifndef JSONREADER_H
+#define JSONREADER_H
+
+#include <QByteArray>
+#include <QString>
+#include <cstring>
+#include <vector>
+
+// Pull parser over JSON text which builds no document. The caller walks the
+// structure it expects and reads the values it needs straight into its own
+// types, every other value is skipped without allocating:
+//
+//   reader.beginObject();
+//   while (reader.nextMember(name)) {
+//       if (name == "id") reader.readInteger(id); else reader.skipValue();
+//   }
+//   bool ok = reader.atEnd();
+//
+// Any syntax error stops the reader, the calls after it return false and
+// hasError() is true. Skipped values are checked for balanced brackets and
+// terminated strings only. Strings are scanned eight bytes at a time for the
+// closing quote and for escapes.
+class JsonReader
+{
+public:
+    // a member name as it is in the text, escapes are not decoded
+    struct Name {
+        Name() : data(nullptr), size(0) {}
+
+        const char* data;
+        int size;
+
+        template<int N>
+        bool operator == (const char (&literal)[N]) const
+        {
+            return size == N - 1 && std::memcmp(data, literal, N - 1) == 0;
+        }
+        template<int N>
+        bool operator != (const char (&literal)[N]) const
+        {
+            return !(*this == literal);
+        }
+    };
+
+    JsonReader(const char* data, int size);
+    explicit JsonReader(const QByteArray& data);
+
+    // the next value is an object or an array, it is not taken
+    bool isNextObject() { return peek() == '{'; }
+    bool isNextArray() { return peek() == '['; }
+
+    bool beginObject();
+    // false at the end of the object
+    bool nextMember(Name& name);
+    bool beginArray();
+    // false at the end of the array
+    bool nextElement();
+
+    // the read functions take the value in any case, a value of another type
+    // leaves the result as QJsonValue conversions would: a null string, 0 or false
+    bool readString(QString& value);
+    // a string as it is in the text, for comparing with literals without a QString
+    bool readRawString(Name& value);
+    // numbers and strings which hold a number, like QJsonValue::toVariant().toLongLong()
+    bool readInteger(long long& value);
+    // true only for the literal true
+    bool readBool(bool& value);
+    bool skipValue();
+
+    // only whitespace is left after the value which was read
+    bool atEnd();
+    bool hasError() const { return error_; }
+private:
+    char peek();
+    void skipWhitespace();
+    bool expect(char c);
+    bool fail();
+    bool nextItem(char close);
+    // the closing quote of the string which starts at pos_, nullptr when it is not terminated
+    const char* findStringEnd(bool& escaped) const;
+    bool readRawString(const char*& begin, const char*& end, bool& escaped);
+    bool unescape(const char* begin, const char* end, QByteArray& result) const;
+    bool scanNumber(const char*& begin, const char*& end);
+    bool skipLiteral(const char* literal, int size);
+    bool skipContainer();
+private:
+    const char* pos_;
+    const char* end_;
+    bool error_;
+    // per open object or array, true until its first item is read
+    std::vector<bool> first_;
+};
+
+#endif // JSONREADER_H
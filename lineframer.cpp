@@ -0,0 +1,67 @@
+// Copyright 2018 AtomicSwap Solutions Ltd. All rights reserved.
+// Use of this source code is governed by Microsoft Reference Source
+// License (MS-RSL) that can be found in the LICENSE file.
+
+#include "lineframer.h"
+#include <QtEndian>
+#include <cstring>
+
+LineFramer::LineFramer() :
+    start_(0),
+    scan_(0)
+{
+}
+
+void LineFramer::append(const QByteArray& data)
+{
+    if (start_ == buffer_.size()) {
+        // everything is consumed, an empty buffer shares the appended data without copying it
+        buffer_.clear();
+        start_ = 0;
+        scan_ = 0;
+    } else if (start_ > 0 && start_ >= buffer_.size() - start_) {
+        buffer_.remove(0, start_);
+        scan_ -= start_;
+        start_ = 0;
+    }
+    buffer_.append(data);
+}
+
+bool LineFramer::next(QByteArray& line)
+{
+    const char* data = buffer_.constData();
+    const void* newline = std::memchr(data + scan_, '\n', buffer_.size() - scan_);
+    if (!newline) {
+        scan_ = buffer_.size();
+        return false;
+    }
+    int end = static_cast<const char*>(newline) - data;
+    line = QByteArray::fromRawData(data + start_, end - start_);
+    start_ = end + 1;
+    scan_ = start_;
+    return true;
+}
+
+bool LineFramer::nextFrame(QByteArray& frame)
+{
+    const int sizeLength = 4;
+    if (size() < sizeLength) {
+        return false;
+    }
+    const char* data = buffer_.constData() + start_;
+    quint32 frameSize = qFromBigEndian<quint32>(reinterpret_cast<const uchar*>(data));
+    if (quint32(size() - sizeLength) < frameSize) {
+        return false;
+    }
+    frame = QByteArray::fromRawData(data + sizeLength, frameSize);
+    start_ += sizeLength + frameSize;
+    scan_ = start_;
+    return true;
+}
+
+void LineFramer::clear()
+{
+    buffer_.clear();
+    start_ = 0;
+    scan_ = 0;
+}
@@ -0,0 +1,36 @@
+// Copyright 2018 AtomicSwap Solutions Ltd. All rights reserved.
+// Use of this source code is governed by Microsoft Reference Source
+// License (MS-RSL) that can be found in the LICENSE file.
+
+#ifndef LINEFRAMER_H
+#define LINEFRAMER_H
+
+#include <QByteArray>
+
+// Splits a connection's byte stream into '\n' terminated lines. Every byte is
+// scanned once: the scan resumes where the previous one stopped, complete lines
+// are returned as views into the buffer, and consumed bytes are dropped only
+// when they are at least half of the buffer. Connections which switched to the
+// binary protocol take length-prefixed frames from the same buffer.
+class LineFramer
+{
+public:
+    LineFramer();
+
+    void append(const QByteArray& data);
+    // the next complete line without '\n', it refers to the buffer and is valid until the next append()
+    bool next(QByteArray& line);
+    // the payload of the next complete frame which starts with its quint32 big endian size, valid like a line
+    bool nextFrame(QByteArray& frame);
+    // bytes which are not returned by next() yet
+    int size() const { return buffer_.size() - start_; }
+    void clear();
+private:
+    QByteArray buffer_;
+    // the first byte which is not returned by next()
+    int start_;
+    // bytes before it are scanned and have no '\n' after start_
+    int scan_;
+};
+
+#endif // LINEFRAMER_H
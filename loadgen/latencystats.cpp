@@ -0,0 +1,24 @@
+// Copyright 2018 AtomicSwap Solutions Ltd. All rights reserved.
+// Use of this source code is governed by Microsoft Reference Source
+// License (MS-RSL) that can be found in the LICENSE file.
+
+#include "latencystats.h"
+#include <algorithm>
+#include <cmath>
+
+void LatencyStats::merge(const LatencyStats& other)
+{
+    samples.insert(samples.end(), other.samples.begin(), other.samples.end());
+    failed += other.failed;
+    timedOut += other.timedOut;
+}
+
+long long LatencyStats::percentile(double p)
+{
+    if (samples.empty()) {
+        return 0;
+    }
+    std::sort(samples.begin(), samples.end());
+    size_t rank = size_t(std::ceil(p * samples.size()));
+    return samples[rank > 0 ? rank - 1 : 0];
+}
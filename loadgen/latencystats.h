@@ -0,0 +1,33 @@
+// Copyright 2018 AtomicSwap Solutions Ltd. All rights reserved.
+// Use of this source code is governed by Microsoft Reference Source
+// License (MS-RSL) that can be found in the LICENSE file.
+
+#ifndef LATENCYSTATS_H
+#define LATENCYSTATS_H
+
+#include <QString>
+#include <map>
+#include <vector>
+
+// Round trip times of one command in microseconds. Every sample is kept, so
+// the percentiles are exact, a run of millions of requests needs a few MB.
+struct LatencyStats {
+    LatencyStats() :
+        failed(0),
+        timedOut(0)
+    {}
+
+    void add(long long micros) { samples.push_back(micros); }
+    void merge(const LatencyStats& other);
+    // sorts the samples, p in [0, 1]
+    long long percentile(double p);
+
+    std::vector<long long> samples;
+    // answered with a failure, like create_trade_failed for an order taken by someone else
+    long long failed;
+    // not answered when the run ended
+    long long timedOut;
+};
+using CommandStats = std::map<QString, LatencyStats>;
+
+#endif // LATENCYSTATS_H
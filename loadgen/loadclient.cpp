@@ -0,0 +1,179 @@
+// Copyright 2018 AtomicSwap Solutions Ltd. All rights reserved.
+// Use of this source code is governed by Microsoft Reference Source
+// License (MS-RSL) that can be found in the LICENSE file.
+
+#include "loadclient.h"
+#include <QJsonArray>
+#include <QJsonDocument>
+#include "loadgenerator.h"
+
+LoadClient::LoadClient(LoadGenerator* generator, int id, const QString& sendCur, const QString& getCur) :
+    nextDueNs(0),
+    generator_(generator),
+    id_(id),
+    key_("loadgen-key-" + QString::number(id)),
+    addr_("loadgen-addr-" + QString::number(id)),
+    sendCur_(sendCur),
+    getCur_(getCur),
+    ready_(false)
+{
+    connect(&socket_, SIGNAL(connected()), this, SLOT(onConnected()));
+    connect(&socket_, SIGNAL(readyRead()), this, SLOT(onReadyRead()));
+    connect(&socket_, SIGNAL(disconnected()), this, SLOT(onDisconnected()));
+}
+
+void LoadClient::connectToServer(const QString& host, quint16 port)
+{
+    socket_.connectToHost(host, port);
+}
+
+void LoadClient::sendNext(const QString& command)
+{
+    if (command == "init") {
+        sendInit();
+    } else if (command == "create_trade") {
+        if (!sendCreateTrade()) {
+            sendCreateOrder();
+        }
+    } else if (command == "update_trade") {
+        if (!sendUpdateTrade()) {
+            sendCreateOrder();
+        }
+    } else {
+        sendCreateOrder();
+    }
+}
+
+void LoadClient::finish(CommandStats& stats)
+{
+    for (auto it = pending_.begin(); it != pending_.end(); ++it) {
+        stats[it->first].timedOut += it->second.size();
+    }
+    pending_.clear();
+    socket_.abort();
+}
+
+void LoadClient::onConnected()
+{
+    socket_.setSocketOption(QAbstractSocket::LowDelayOption, 1);
+    sendInit();
+    QJsonObject subscribe;
+    subscribe.insert("command", QString("subscribe"));
+    subscribe.insert("sendCur", sendCur_);
+    subscribe.insert("getCur", getCur_);
+    socket_.write(QJsonDocument(subscribe).toJson(QJsonDocument::Compact) + "\n");
+}
+
+void LoadClient::onReadyRead()
+{
+    framer_.append(socket_.readAll());
+    QByteArray line;
+    while (framer_.next(line)) {
+        QJsonDocument doc = QJsonDocument::fromJson(line);
+        if (doc.isObject()) {
+            handleReply(doc.object());
+        }
+    }
+}
+
+void LoadClient::onDisconnected()
+{
+    ready_ = false;
+    generator_->clientDisconnected(id_);
+}
+
+void LoadClient::send(const QString& command, const QJsonObject& request)
+{
+    pending_[command].push_back(generator_->nowNs());
+    socket_.write(QJsonDocument(request).toJson(QJsonDocument::Compact) + "\n");
+}
+
+void LoadClient::sendInit()
+{
+    QJsonObject cur;
+    cur.insert("cur", getCur_);
+    cur.insert("addrs", QJsonArray() << addr_);
+    QJsonObject request;
+    request.insert("command", QString("init"));
+    request.insert("curs", QJsonArray() << cur);
+    send("init", request);
+}
+
+void LoadClient::sendCreateOrder()
+{
+    QJsonObject order;
+    order.insert("sendCur", sendCur_);
+    order.insert("getCur", getCur_);
+    order.insert("sendCount", 100000 + id_);
+    order.insert("getCount", 200000 + id_);
+    order.insert("getAddr", addr_);
+    QJsonObject request;
+    request.insert("command", QString("create_order"));
+    request.insert("key", key_);
+    request.insert("order", order);
+    send("create_order", request);
+}
+
+bool LoadClient::sendCreateTrade()
+{
+    long long orderId = generator_->takeOrder(id_);
+    if (orderId == 0) {
+        return false;
+    }
+    QJsonObject request;
+    request.insert("command", QString("create_trade"));
+    request.insert("key", key_);
+    request.insert("orderId", orderId);
+    request.insert("address", addr_);
+    send("create_trade", request);
+    return true;
+}
+
+bool LoadClient::sendUpdateTrade()
+{
+    if (trades_.empty()) {
+        return false;
+    }
+    QJsonObject trade = trades_.front();
+    trades_.pop_front();
+    trade.insert("secretHash", "loadgen-secret-" + QString::number(id_));
+    trade.insert("contractInitiator", QString("loadgen-contract"));
+    QJsonObject request;
+    request.insert("command", QString("update_trade"));
+    request.insert("key", key_);
+    request.insert("trade", trade);
+    send("update_trade", request);
+    return true;
+}
+
+void LoadClient::handleReply(const QJsonObject& reply)
+{
+    QString type = reply["reply"].toString();
+    if (type == "init_success") {
+        complete("init", false);
+        ready_ = true;
+    } else if (type == "create_order_success") {
+        complete("create_order", false);
+        generator_->addOrder(id_, reply["order"].toObject()["id"].toVariant().toLongLong());
+    } else if (type == "create_trade_success") {
+        complete("create_trade", false);
+        trades_.push_back(reply["trade"].toObject());
+    } else if (type == "create_trade_failed") {
+        complete("create_trade", true);
+    } else if (type == "update_trade_success") {
+        complete("update_trade", false);
+    } else if (type == "events_dropped") {
+        generator_->eventsDropped(reply["count"].toVariant().toLongLong());
+    }
+}
+
+void LoadClient::complete(const QString& command, bool failed)
+{
+    auto it = pending_.find(command);
+    if (it == pending_.end() || it->second.empty()) {
+        return;
+    }
+    long long sentNs = it->second.front();
+    it->second.pop_front();
+    generator_->record(command, (generator_->nowNs() - sentNs) / 1000, failed);
+}
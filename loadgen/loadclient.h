@@ -0,0 +1,64 @@
+// Copyright 2018 AtomicSwap Solutions Ltd. All rights reserved.
+// Use of this source code is governed by Microsoft Reference Source
+// License (MS-RSL) that can be found in the LICENSE file.
+
+#ifndef LOADCLIENT_H
+#define LOADCLIENT_H
+
+#include <QJsonObject>
+#include <QObject>
+#include <QTcpSocket>
+#include <deque>
+#include <map>
+#include "lineframer.h"
+#include "latencystats.h"
+
+class LoadGenerator;
+
+// One simulated Tritium client: it sends init with its address, subscribes
+// to its currency pair and then sends the command its generator picks
+// whenever it is due. Replies are matched to requests by their type, the
+// server answers the requests of a connection in order.
+class LoadClient : public QObject
+{
+    Q_OBJECT
+public:
+    LoadClient(LoadGenerator* generator, int id, const QString& sendCur, const QString& getCur);
+
+    void connectToServer(const QString& host, quint16 port);
+    // init is answered
+    bool isReady() const { return ready_; }
+    void sendNext(const QString& command);
+    // requests without a reply are counted as timed out
+    void finish(CommandStats& stats);
+
+    long long nextDueNs;
+private slots:
+    void onConnected();
+    void onReadyRead();
+    void onDisconnected();
+private:
+    void send(const QString& command, const QJsonObject& request);
+    void sendInit();
+    void sendCreateOrder();
+    bool sendCreateTrade();
+    bool sendUpdateTrade();
+    void handleReply(const QJsonObject& reply);
+    void complete(const QString& command, bool failed);
+private:
+    LoadGenerator* generator_;
+    int id_;
+    QString key_;
+    QString addr_;
+    QString sendCur_;
+    QString getCur_;
+    QTcpSocket socket_;
+    LineFramer framer_;
+    bool ready_;
+    // send times of the requests which wait for a reply, by command
+    std::map<QString, std::deque<long long>> pending_;
+    // trades created by this client, the server accepts one update per trade
+    std::deque<QJsonObject> trades_;
+};
+
+#endif // LOADCLIENT_H
@@ -0,0 +1,25 @@
+QT -= gui
+QT += network
+
+CONFIG += c++11 console
+CONFIG -= app_bundle
+
+TARGET = atom-engine-loadgen
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+INCLUDEPATH += ..
+
+SOURCES += main.cpp \
+    latencystats.cpp \
+    loadclient.cpp \
+    loadgenerator.cpp \
+    loadrunner.cpp \
+    ../lineframer.cpp
+
+HEADERS += \
+    latencystats.h \
+    loadclient.h \
+    loadgenerator.h \
+    loadrunner.h \
+    ../lineframer.h
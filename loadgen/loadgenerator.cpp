@@ -0,0 +1,167 @@
+// Copyright 2018 AtomicSwap Solutions Ltd. All rights reserved.
+// Use of this source code is governed by Microsoft Reference Source
+// License (MS-RSL) that can be found in the LICENSE file.
+
+#include "loadgenerator.h"
+#include "loadclient.h"
+#include <algorithm>
+
+namespace {
+    const int tickMs = 5;
+    const long long nsPerSec = 1000000000LL;
+}
+
+bool LoadSettings::parseMix(const QString& mix)
+{
+    const QStringList known = {"init", "create_order", "create_trade", "update_trade"};
+    commands.clear();
+    weights.clear();
+    QStringList parts = mix.split(',', QString::SkipEmptyParts);
+    for (int i = 0; i < parts.size(); ++i) {
+        QStringList pair = parts[i].split('=');
+        bool ok = false;
+        int weight = pair.size() == 2 ? pair[1].toInt(&ok) : 0;
+        if (!ok || weight < 0 || !known.contains(pair[0])) {
+            return false;
+        }
+        commands.append(pair[0]);
+        weights.push_back(weight);
+    }
+    return !commands.isEmpty();
+}
+
+LoadGenerator::LoadGenerator(const LoadSettings& settings, int index) :
+    settings_(settings),
+    index_(index),
+    clientsCount_(settings.clients / settings.threads + (index < settings.clients % settings.threads ? 1 : 0)),
+    random_(index + 1),
+    arrivals_(settings.ratePerClient),
+    mix_(settings.weights.begin(), settings.weights.end()),
+    sending_(false),
+    peakConnected_(0),
+    disconnected_(0),
+    eventsDropped_(0)
+{
+    connect(&tick_, SIGNAL(timeout()), this, SLOT(onTick()));
+}
+
+LoadGenerator::~LoadGenerator()
+{
+}
+
+void LoadGenerator::record(const QString& command, long long micros, bool failed)
+{
+    LatencyStats& stats = stats_[command];
+    stats.add(micros);
+    if (failed) {
+        ++stats.failed;
+    }
+}
+
+void LoadGenerator::addOrder(int clientId, long long orderId)
+{
+    Order order;
+    order.clientId = clientId;
+    order.id = orderId;
+    orders_.push_back(order);
+}
+
+long long LoadGenerator::takeOrder(int clientId)
+{
+    // the newest orders, like a client which trades what it just saw
+    for (size_t i = orders_.size(); i > 0; --i) {
+        if (orders_[i - 1].clientId != clientId) {
+            long long id = orders_[i - 1].id;
+            orders_.erase(orders_.begin() + (i - 1));
+            return id;
+        }
+    }
+    return 0;
+}
+
+void LoadGenerator::clientDisconnected(int clientId)
+{
+    Q_UNUSED(clientId);
+    if (sending_) {
+        ++disconnected_;
+    }
+}
+
+void LoadGenerator::start()
+{
+    clock_.start();
+    clients_.reserve(clientsCount_);
+    sending_ = true;
+    tick_.start(tickMs);
+}
+
+void LoadGenerator::resetStats()
+{
+    stats_.clear();
+    eventsDropped_ = 0;
+    disconnected_ = 0;
+}
+
+void LoadGenerator::stop()
+{
+    sending_ = false;
+}
+
+void LoadGenerator::finish()
+{
+    tick_.stop();
+    for (size_t i = 0; i < clients_.size(); ++i) {
+        clients_[i]->finish(stats_);
+    }
+    clients_.clear();
+}
+
+void LoadGenerator::onTick()
+{
+    long long now = nowNs();
+    // this thread's share of the connection rate
+    long long allowed = now * settings_.connectRate / settings_.threads / nsPerSec + 1;
+    while (sending_ && int(clients_.size()) < clientsCount_ && (long long)clients_.size() < allowed) {
+        int id = index_ + int(clients_.size()) * settings_.threads;
+        int pair = id % settings_.pairs;
+        // half of the clients sell, so that the pairs have both sides
+        QString first = "CUR" + QString::number(pair * 2);
+        QString second = "CUR" + QString::number(pair * 2 + 1);
+        bool sells = (id / settings_.pairs) % 2 == 0;
+        LoadClient* client = new LoadClient(this, id, sells ? first : second, sells ? second : first);
+        client->nextDueNs = now + nextInterval();
+        client->connectToServer(settings_.host, settings_.port);
+        clients_.emplace_back(client);
+    }
+
+    int connected = 0;
+    for (size_t i = 0; i < clients_.size(); ++i) {
+        LoadClient* client = clients_[i].get();
+        if (!client->isReady()) {
+            continue;
+        }
+        ++connected;
+        if (!sending_) {
+            continue;
+        }
+        if (now - client->nextDueNs > nsPerSec) {
+            // it was not ready when it was due, a late start is not a burst
+            client->nextDueNs = now;
+        }
+        while (client->nextDueNs <= now) {
+            client->sendNext(pickCommand());
+            client->nextDueNs += nextInterval();
+        }
+    }
+    peakConnected_ = std::max(peakConnected_, connected);
+}
+
+long long LoadGenerator::nextInterval()
+{
+    return (long long)(arrivals_(random_) * nsPerSec);
+}
+
+QString LoadGenerator::pickCommand()
+{
+    return settings_.commands[mix_(random_)];
+}
@@ -0,0 +1,105 @@
+// Copyright 2018 AtomicSwap Solutions Ltd. All rights reserved.
+// Use of this source code is governed by Microsoft Reference Source
+// License (MS-RSL) that can be found in the LICENSE file.
+
+#ifndef LOADGENERATOR_H
+#define LOADGENERATOR_H
+
+#include <QElapsedTimer>
+#include <QObject>
+#include <QStringList>
+#include <QTimer>
+#include <memory>
+#include <random>
+#include <vector>
+#include "latencystats.h"
+
+class LoadClient;
+
+struct LoadSettings {
+    LoadSettings() :
+        host("127.0.0.1"),
+        port(0),
+        clients(1000),
+        threads(1),
+        ratePerClient(1.0),
+        connectRate(500),
+        pairs(4)
+    {}
+
+    // "init=5,create_order=40,create_trade=30,update_trade=25"
+    bool parseMix(const QString& mix);
+
+    QString host;
+    quint16 port;
+    int clients;
+    int threads;
+    // requests per second of one client, arrivals are random with this mean
+    double ratePerClient;
+    // connections opened per second by all threads
+    int connectRate;
+    // clients are spread over this many currency pairs
+    int pairs;
+    QStringList commands;
+    std::vector<int> weights;
+};
+
+// The clients of one thread. A tick timer opens connections at the configured
+// rate and sends the requests which are due, orders created by the clients
+// are pooled so that other clients can trade them.
+class LoadGenerator : public QObject
+{
+    Q_OBJECT
+public:
+    LoadGenerator(const LoadSettings& settings, int index);
+    ~LoadGenerator();
+
+    long long nowNs() const { return clock_.nsecsElapsed(); }
+    void record(const QString& command, long long micros, bool failed);
+    void addOrder(int clientId, long long orderId);
+    // an order of another client, 0 when there is none
+    long long takeOrder(int clientId);
+    void eventsDropped(long long count) { eventsDropped_ += count; }
+    void clientDisconnected(int clientId);
+
+    // valid after finish()
+    const CommandStats& stats() const { return stats_; }
+    int peakConnectedCount() const { return peakConnected_; }
+    long long disconnectedCount() const { return disconnected_; }
+    long long eventsDroppedCount() const { return eventsDropped_; }
+public slots:
+    void start();
+    // the samples so far are the warm-up
+    void resetStats();
+    // no new requests, the replies to the sent ones are still recorded
+    void stop();
+    void finish();
+private slots:
+    void onTick();
+private:
+    long long nextInterval();
+    QString pickCommand();
+private:
+    struct Order {
+        int clientId;
+        long long id;
+    };
+
+    LoadSettings settings_;
+    int index_;
+    int clientsCount_;
+    std::vector<std::unique_ptr<LoadClient>> clients_;
+    std::vector<Order> orders_;
+    QTimer tick_;
+    QElapsedTimer clock_;
+    std::mt19937_64 random_;
+    std::exponential_distribution<double> arrivals_;
+    std::discrete_distribution<int> mix_;
+    bool sending_;
+    int peakConnected_;
+    long long disconnected_;
+    long long eventsDropped_;
+    CommandStats stats_;
+};
+
+#endif // LOADGENERATOR_H
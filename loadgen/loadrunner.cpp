@@ -0,0 +1,113 @@
+// Copyright 2018 AtomicSwap Solutions Ltd. All rights reserved.
+// Use of this source code is governed by Microsoft Reference Source
+// License (MS-RSL) that can be found in the LICENSE file.
+
+#include "loadrunner.h"
+#include <QCoreApplication>
+#include <QTextStream>
+#include <QTimer>
+
+LoadRunner::LoadRunner(const LoadSettings& settings, int warmupSec, int durationSec, int graceMs) :
+    settings_(settings),
+    warmupSec_(warmupSec),
+    durationSec_(durationSec),
+    graceMs_(graceMs),
+    measuredNs_(0)
+{
+    for (int i = 0; i < settings.threads; ++i) {
+        LoadGenerator* generator = new LoadGenerator(settings, i);
+        QThread* thread = new QThread();
+        thread->setObjectName("load generator " + QString::number(i));
+        generator->moveToThread(thread);
+        thread->start();
+        generators_.push_back(generator);
+        threads_.push_back(thread);
+    }
+}
+
+LoadRunner::~LoadRunner()
+{
+    for (size_t i = 0; i < threads_.size(); ++i) {
+        threads_[i]->quit();
+        threads_[i]->wait();
+        delete threads_[i];
+    }
+    for (size_t i = 0; i < generators_.size(); ++i) {
+        delete generators_[i];
+    }
+}
+
+void LoadRunner::start()
+{
+    for (size_t i = 0; i < generators_.size(); ++i) {
+        QMetaObject::invokeMethod(generators_[i], "start", Qt::QueuedConnection);
+    }
+    QTimer::singleShot(warmupSec_ * 1000, this, SLOT(onWarmedUp()));
+}
+
+void LoadRunner::invokeAll(const char* method)
+{
+    for (size_t i = 0; i < generators_.size(); ++i) {
+        QMetaObject::invokeMethod(generators_[i], method, Qt::BlockingQueuedConnection);
+    }
+}
+
+void LoadRunner::onWarmedUp()
+{
+    invokeAll("resetStats");
+    measured_.start();
+    QTimer::singleShot(durationSec_ * 1000, this, SLOT(onElapsed()));
+}
+
+void LoadRunner::onElapsed()
+{
+    invokeAll("stop");
+    measuredNs_ = measured_.nsecsElapsed();
+    QTimer::singleShot(graceMs_, this, SLOT(onDrained()));
+}
+
+void LoadRunner::onDrained()
+{
+    invokeAll("finish");
+    QCoreApplication::quit();
+}
+
+void LoadRunner::report() const
+{
+    CommandStats total;
+    int connected = 0;
+    long long disconnected = 0;
+    long long eventsDropped = 0;
+    for (size_t i = 0; i < generators_.size(); ++i) {
+        const CommandStats& stats = generators_[i]->stats();
+        for (auto it = stats.begin(); it != stats.end(); ++it) {
+            total[it->first].merge(it->second);
+        }
+        connected += generators_[i]->peakConnectedCount();
+        disconnected += generators_[i]->disconnectedCount();
+        eventsDropped += generators_[i]->eventsDroppedCount();
+    }
+
+    double seconds = measuredNs_ / 1e9;
+    QTextStream out(stdout);
+    out << "clients connected " << connected << " of " << settings_.clients
+        << ", disconnected by the server " << disconnected
+        << ", events dropped " << eventsDropped << "\n";
+    out << "measured " << QString::number(seconds, 'f', 1) << " s\n\n";
+    out << QString("%1 %2 %3 %4 %5 %6 %7 %8 %9\n")
+           .arg("command", -14).arg("count", 10).arg("per sec", 10)
+           .arg("p50 ms", 9).arg("p99 ms", 9).arg("p999 ms", 9).arg("max ms", 9)
+           .arg("failed", 8).arg("timeout", 8);
+    long long allCount = 0;
+    for (auto it = total.begin(); it != total.end(); ++it) {
+        LatencyStats& stats = it->second;
+        long long count = stats.samples.size();
+        allCount += count;
+        out << QString("%1 %2 %3 %4 %5 %6 %7 %8 %9\n")
+               .arg(it->first, -14).arg(count, 10).arg(count / seconds, 10, 'f', 0)
+               .arg(stats.percentile(0.5) / 1000.0, 9, 'f', 2).arg(stats.percentile(0.99) / 1000.0, 9, 'f', 2)
+               .arg(stats.percentile(0.999) / 1000.0, 9, 'f', 2).arg(stats.percentile(1.0) / 1000.0, 9, 'f', 2)
+               .arg(stats.failed, 8).arg(stats.timedOut, 8);
+    }
+    out << "\ntotal " << allCount << " requests, " << QString::number(allCount / seconds, 'f', 0) << " per sec\n";
+}
@@ -0,0 +1,43 @@
+// Copyright 2018 AtomicSwap Solutions Ltd. All rights reserved.
+// Use of this source code is governed by Microsoft Reference Source
+// License (MS-RSL) that can be found in the LICENSE file.
+
+#ifndef LOADRUNNER_H
+#define LOADRUNNER_H
+
+#include <QElapsedTimer>
+#include <QObject>
+#include <QThread>
+#include <vector>
+#include "loadgenerator.h"
+
+// Runs the generators in their threads: warm-up, measured run, then a grace
+// period for the replies which are still on their way. The report has the
+// throughput and the latency percentiles of every command.
+class LoadRunner : public QObject
+{
+    Q_OBJECT
+public:
+    LoadRunner(const LoadSettings& settings, int warmupSec, int durationSec, int graceMs);
+    ~LoadRunner();
+
+    void start();
+    void report() const;
+private slots:
+    void onWarmedUp();
+    void onElapsed();
+    void onDrained();
+private:
+    void invokeAll(const char* method);
+private:
+    LoadSettings settings_;
+    int warmupSec_;
+    int durationSec_;
+    int graceMs_;
+    std::vector<LoadGenerator*> generators_;
+    std::vector<QThread*> threads_;
+    QElapsedTimer measured_;
+    long long measuredNs_;
+};
+
+#endif // LOADRUNNER_H
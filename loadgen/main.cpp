@@ -0,0 +1,72 @@
+// Copyright 2018 AtomicSwap Solutions Ltd. All rights reserved.
+// Use of this source code is governed by Microsoft Reference Source
+// License (MS-RSL) that can be found in the LICENSE file.
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QTextStream>
+#include <algorithm>
+#include "loadrunner.h"
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+
+    QCommandLineParser parser;
+    // all clients share one address, the server should run with security/requests_count = 0
+    parser.setApplicationDescription("Drives a running atom-engine with simulated clients and reports latency per command.\n"
+                                     "All clients come from one IP, so run the server without the request rate limit.");
+    parser.addHelpOption();
+    QCommandLineOption hostOption("host", "Server address.", "host", "127.0.0.1");
+    QCommandLineOption portOption("port", "Server port.", "port");
+    QCommandLineOption clientsOption("clients", "Simulated clients.", "count", "1000");
+    QCommandLineOption threadsOption("threads", "Generator threads.", "count", "4");
+    QCommandLineOption rateOption("rate", "Requests per second of one client.", "rate", "1");
+    QCommandLineOption connectRateOption("connect-rate", "New connections per second.", "rate", "500");
+    QCommandLineOption pairsOption("pairs", "Currency pairs the clients are spread over.", "count", "4");
+    QCommandLineOption mixOption("mix", "Command weights.", "mix", "init=5,create_order=40,create_trade=30,update_trade=25");
+    QCommandLineOption warmupOption("warmup", "Seconds before the measurement starts.", "sec", "5");
+    QCommandLineOption durationOption("duration", "Measured seconds.", "sec", "30");
+    QCommandLineOption graceOption("grace", "Milliseconds to wait for replies after the run.", "ms", "2000");
+    parser.addOption(hostOption);
+    parser.addOption(portOption);
+    parser.addOption(clientsOption);
+    parser.addOption(threadsOption);
+    parser.addOption(rateOption);
+    parser.addOption(connectRateOption);
+    parser.addOption(pairsOption);
+    parser.addOption(mixOption);
+    parser.addOption(warmupOption);
+    parser.addOption(durationOption);
+    parser.addOption(graceOption);
+    parser.process(a);
+
+    QTextStream err(stderr);
+    LoadSettings settings;
+    settings.host = parser.value(hostOption);
+    settings.port = parser.value(portOption).toUShort();
+    settings.clients = parser.value(clientsOption).toInt();
+    settings.threads = parser.value(threadsOption).toInt();
+    settings.ratePerClient = parser.value(rateOption).toDouble();
+    settings.connectRate = parser.value(connectRateOption).toInt();
+    settings.pairs = parser.value(pairsOption).toInt();
+    if (settings.port == 0) {
+        err << "Need the port of a running server, see --help\n";
+        return 1;
+    }
+    if (settings.clients <= 0 || settings.threads <= 0 || settings.ratePerClient <= 0 || settings.connectRate <= 0 || settings.pairs <= 0) {
+        err << "Clients, threads, rates and pairs must be positive\n";
+        return 1;
+    }
+    if (!settings.parseMix(parser.value(mixOption))) {
+        err << "Bad mix " << parser.value(mixOption) << ", commands are init, create_order, create_trade and update_trade\n";
+        return 1;
+    }
+    settings.threads = std::min(settings.threads, settings.clients);
+
+    LoadRunner runner(settings, parser.value(warmupOption).toInt(), parser.value(durationOption).toInt(), parser.value(graceOption).toInt());
+    runner.start();
+    a.exec();
+    runner.report();
+    return 0;
+}
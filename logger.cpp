@@ -4,42 +4,320 @@
 
 #include "logger.h"
 #include <QDebug>
-#include <QTextStream>
 #include <QDateTime>
-#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QMutex>
+#include <QThread>
+#include <QWaitCondition>
+#include <algorithm>
+#include <memory>
 
 namespace {
     const QString loggerFileName = "info.log";
+    // a power of two
+    const size_t ringCapacity = 1 << 16;
+    // a process which does not call Logger::configure() by then logs with the default settings
+    const unsigned long configureWaitMs = 1000;
+
+    std::atomic<int> minLevel(Logger::Debug);
+    std::atomic<int> debugSampling(1);
+
+    struct Record {
+        qint64 time;
+        QString text;
+    };
+
+    // Bounded multi-producer queue, every cell has a sequence number which tells
+    // whether it is free for the producer of this round or filled for the consumer.
+    class RingBuffer
+    {
+    public:
+        RingBuffer() :
+            cells_(new Cell[ringCapacity]),
+            enqueuePos_(0),
+            dequeuePos_(0)
+        {
+            for (size_t i = 0; i < ringCapacity; ++i) {
+                cells_[i].sequence.store(i, std::memory_order_relaxed);
+            }
+        }
+
+        bool push(Record& record)
+        {
+            size_t pos = enqueuePos_.load(std::memory_order_relaxed);
+            Cell* cell;
+            while (true) {
+                cell = &cells_[pos & (ringCapacity - 1)];
+                size_t sequence = cell->sequence.load(std::memory_order_acquire);
+                intptr_t diff = intptr_t(sequence) - intptr_t(pos);
+                if (diff == 0) {
+                    if (enqueuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                        break;
+                    }
+                } else if (diff < 0) {
+                    return false;
+                } else {
+                    pos = enqueuePos_.load(std::memory_order_relaxed);
+                }
+            }
+            cell->record.time = record.time;
+            cell->record.text.swap(record.text);
+            cell->sequence.store(pos + 1, std::memory_order_release);
+            return true;
+        }
+
+        // the writer thread is the only consumer
+        bool pop(Record& record)
+        {
+            Cell& cell = cells_[dequeuePos_ & (ringCapacity - 1)];
+            size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            if (intptr_t(sequence) - intptr_t(dequeuePos_ + 1) < 0) {
+                return false;
+            }
+            record.time = cell.record.time;
+            record.text.swap(cell.record.text);
+            cell.record.text.clear();
+            cell.sequence.store(dequeuePos_ + ringCapacity, std::memory_order_release);
+            ++dequeuePos_;
+            return true;
+        }
+    private:
+        struct Cell {
+            std::atomic<size_t> sequence;
+            Record record;
+        };
+
+        std::unique_ptr<Cell[]> cells_;
+        std::atomic<size_t> enqueuePos_;
+        size_t dequeuePos_;
+    };
+
+    class LogWriter : public QThread
+    {
+    public:
+        LogWriter() :
+            stopping_(false),
+            dropped_(0),
+            configured_(false),
+            lastSecond_(-1)
+        {
+            setObjectName("logger");
+            start();
+        }
+
+        ~LogWriter()
+        {
+            {
+                QMutexLocker locker(&mutex_);
+                stopping_ = true;
+                wakeup_.wakeOne();
+            }
+            wait();
+        }
+
+        void push(Record& record)
+        {
+            if (!ring_.push(record)) {
+                ++dropped_;
+            }
+        }
+
+        void configure(const Logger::Settings& settings)
+        {
+            QMutexLocker locker(&mutex_);
+            settings_ = settings;
+            configured_ = true;
+            wakeup_.wakeOne();
+        }
+    protected:
+        void run() override
+        {
+            Logger::Settings settings;
+            {
+                // records logged before configure() wait in the ring until the log is opened
+                QMutexLocker locker(&mutex_);
+                QElapsedTimer timer;
+                timer.start();
+                while (!configured_ && !stopping_ && quint64(timer.elapsed()) < configureWaitMs) {
+                    wakeup_.wait(&mutex_, configureWaitMs - timer.elapsed());
+                }
+                settings = settings_;
+            }
+            // every run starts a new log, the previous one becomes info.log.1
+            rotate(settings.maxFiles);
+            file_.setFileName(loggerFileName);
+            file_.open(QIODevice::WriteOnly | QIODevice::Text);
+
+            while (true) {
+                {
+                    QMutexLocker locker(&mutex_);
+                    settings = settings_;
+                }
+                bool written = drain(settings);
+                if (stopping_) {
+                    break;
+                }
+                if (!written) {
+                    // configure() and the destructor wake the writer before the timeout
+                    QMutexLocker locker(&mutex_);
+                    if (!stopping_) {
+                        wakeup_.wait(&mutex_, std::max(1, settings_.flushIntervalMs));
+                    }
+                }
+            }
+            drain(settings);
+            file_.close();
+        }
+    private:
+        bool drain(const Logger::Settings& settings)
+        {
+            QByteArray batch;
+            Record record;
+            while (ring_.pop(record)) {
+                format(record, settings, batch);
+            }
+            unsigned long long dropped = dropped_.exchange(0);
+            if (dropped > 0) {
+                record.time = QDateTime::currentMSecsSinceEpoch();
+                record.text = QString::number(dropped) + " log records were dropped, the log buffer was full";
+                format(record, settings, batch);
+            }
+            if (batch.isEmpty()) {
+                return false;
+            }
+
+            if (file_.isOpen()) {
+                file_.write(batch);
+                file_.flush();
+                if (settings.maxFileSize > 0 && file_.size() > settings.maxFileSize) {
+                    file_.close();
+                    rotate(settings.maxFiles);
+                    file_.open(QIODevice::WriteOnly | QIODevice::Text);
+                }
+            }
+            return true;
+        }
+
+        void format(const Record& record, const Logger::Settings& settings, QByteArray& batch)
+        {
+            // the time is formatted once a second
+            qint64 second = record.time / 1000;
+            if (second != lastSecond_) {
+                lastSecond_ = second;
+                timeStr_ = "[" + QDateTime::fromMSecsSinceEpoch(record.time).toString("dd.MM.yyyy hh:mm:ss").toUtf8() + "] ";
+            }
+            if (settings.console) {
+                qDebug().noquote() << record.text;
+            }
+            batch += timeStr_;
+            batch += record.text.toUtf8();
+            batch += '\n';
+        }
+
+        void rotate(int maxFiles)
+        {
+            if (maxFiles <= 0) {
+                QFile::remove(loggerFileName);
+                return;
+            }
+            QFile::remove(loggerFileName + "." + QString::number(maxFiles));
+            for (int i = maxFiles - 1; i >= 1; --i) {
+                QFile::rename(loggerFileName + "." + QString::number(i), loggerFileName + "." + QString::number(i + 1));
+            }
+            QFile::rename(loggerFileName, loggerFileName + ".1");
+        }
+    private:
+        RingBuffer ring_;
+        std::atomic<bool> stopping_;
+        std::atomic<unsigned long long> dropped_;
+
+        QMutex mutex_;
+        QWaitCondition wakeup_;
+        Logger::Settings settings_;
+        bool configured_;
+
+        // used by the writer thread only
+        QFile file_;
+        qint64 lastSecond_;
+        QByteArray timeStr_;
+    };
+
+    LogWriter& writer()
+    {
+        static LogWriter logWriter;
+        return logWriter;
+    }
 }
 
-Logger::Logger() :
-    file(nullptr)
+Logger::Logger(Level level) :
+    level_(level),
+    sampleCounter_(0)
 {
-    file = new QFile;
-    file->setFileName(loggerFileName);
-    file->open(QIODevice::WriteOnly | QIODevice::Text);
+    writer();
 }
 
-Logger::~Logger()
+Logger& Logger::debug()
 {
-    if (file) {
-        file->close();
-        delete file;
-    }
+    static Logger logger(Debug);
+    return logger;
 }
 
 Logger& Logger::info()
 {
-    static Logger logger;
+    static Logger logger(Info);
+    return logger;
+}
+
+Logger& Logger::warning()
+{
+    static Logger logger(Warning);
     return logger;
 }
 
+void Logger::configure(const Settings& settings)
+{
+    minLevel = settings.level;
+    debugSampling = settings.debugSampling > 1 ? settings.debugSampling : 1;
+    writer().configure(settings);
+}
+
+bool Logger::parseLevel(const QString& name, Level& level)
+{
+    QString lowerName = name.toLower();
+    if (lowerName == "debug") {
+        level = Debug;
+    } else if (lowerName == "info") {
+        level = Info;
+    } else if (lowerName == "warning") {
+        level = Warning;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool Logger::isEnabled() const
+{
+    return level_ >= minLevel.load(std::memory_order_relaxed);
+}
+
+bool Logger::isSampled()
+{
+    if (!isEnabled()) {
+        return false;
+    }
+    int sampling = debugSampling.load(std::memory_order_relaxed);
+    return level_ != Debug || sampling <= 1 || sampleCounter_.fetch_add(1, std::memory_order_relaxed) % sampling == 0;
+}
+
 void Logger::operator << (const QString& str)
 {
-    int pos = str.lastIndexOf("\n");
-    qDebug().noquote() << str.left(pos);
-    if (file) {
-        QTextStream out(file);
-        out << "[" << QDateTime::currentDateTime().toString("dd.MM.yyyy hh:mm:ss") << "] " << str.left(pos) << endl;
+    if (!isEnabled()) {
+        return;
     }
+    Record record;
+    record.time = QDateTime::currentMSecsSinceEpoch();
+    record.text = str.left(str.lastIndexOf("\n"));
+    writer().push(record);
 }
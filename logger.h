@@ -6,18 +6,63 @@
 #define LOGGER_H
 
 #include <QString>
-#include <QFile>
+#include <atomic>
 
+// Records are put into a lock-free ring buffer and written to info.log (and the
+// console) by a background thread, so logging never waits for the disk. When
+// the buffer is full new records are dropped and the number of dropped records
+// is logged later.
 class Logger
 {
 public:
+    enum Level {
+        Debug,
+        Info,
+        Warning
+    };
+
+    struct Settings {
+        Settings() :
+            level(Debug),
+            debugSampling(1),
+            maxFileSize(0),
+            maxFiles(5),
+            console(true),
+            flushIntervalMs(20)
+        {}
+
+        // records below the level are skipped
+        Level level;
+        // one of every debugSampling debug records passes isSampled()
+        int debugSampling;
+        // info.log is rotated to info.log.1 .. info.log.<maxFiles> when it is larger, 0 disables rotation
+        long long maxFileSize;
+        int maxFiles;
+        bool console;
+        // how long the writer waits for new records when the buffer is empty
+        int flushIntervalMs;
+    };
+
+    static Logger& debug();
     static Logger& info();
+    static Logger& warning();
+
+    static void configure(const Settings& settings);
+    // "debug", "info" or "warning", returns false for an unknown name
+    static bool parseLevel(const QString& name, Level& level);
+
+    bool isEnabled() const;
+    // like isEnabled() but counts the calls, use it for frequent debug records
+    // so that only every debugSampling-th of them is built and logged
+    bool isSampled();
     void operator << (const QString& str);
 private:
-    Logger();
-    ~Logger();
+    explicit Logger(Level level);
+    Logger(const Logger&);
+    Logger& operator = (const Logger&);
 private:
-    QFile* file;
+    Level level_;
+    std::atomic<unsigned> sampleCounter_;
 };
 
 #endif // LOGGER_H
@@ -4,12 +4,15 @@
 
 #include <QCoreApplication>
 #include "atomengineserver.h"
+#include "terminationwatcher.h"
 #include <string>
 #include <sstream>
 
 int main(int argc, char *argv[])
 {
     QCoreApplication a(argc, argv);
+    TerminationWatcher terminationWatcher;
+    terminationWatcher.watch();
 
     AtomEngineServer atomEngineServer;
     if (atomEngineServer.run()) {
@@ -0,0 +1,220 @@
+// Copyright 2018 AtomicSwap Solutions Ltd. All rights reserved.
+// Use of this source code is governed by Microsoft Reference Source
+// License (MS-RSL) that can be found in the LICENSE file.
+
+#include "metrics.h"
+#include <QtAlgorithms>
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    std::atomic<int> nextShard(0);
+
+    const double quantiles[] = {0.5, 0.9, 0.99, 0.999};
+
+    QByteArray seriesName(const QString& name, const QString& labels)
+    {
+        return labels.isEmpty() ? name.toUtf8() : (name + "{" + labels + "}").toUtf8();
+    }
+
+    QByteArray quantileSeriesName(const QString& name, const QString& labels, double quantile)
+    {
+        QString quantileLabel = "quantile=\"" + QString::number(quantile) + "\"";
+        return (name + "{" + (labels.isEmpty() ? quantileLabel : labels + "," + quantileLabel) + "}").toUtf8();
+    }
+}
+
+int MetricsShards::current()
+{
+    thread_local int shard = nextShard.fetch_add(1, std::memory_order_relaxed) % shardsCount;
+    return shard;
+}
+
+Counter::Counter()
+{
+    for (int i = 0; i < MetricsShards::shardsCount; ++i) {
+        shards_[i].value.store(0, std::memory_order_relaxed);
+    }
+}
+
+long long Counter::value() const
+{
+    long long total = 0;
+    for (int i = 0; i < MetricsShards::shardsCount; ++i) {
+        total += shards_[i].value.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+Histogram::Shard::Shard() :
+    sum(0)
+{
+    for (int i = 0; i < bucketsCount; ++i) {
+        buckets[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+Histogram::Histogram() :
+    shards_(new Shard[MetricsShards::shardsCount])
+{
+}
+
+void Histogram::record(long long value)
+{
+    if (value < 0) {
+        value = 0;
+    }
+    Shard& shard = shards_[MetricsShards::current()];
+    shard.buckets[bucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+    shard.sum.fetch_add(value, std::memory_order_relaxed);
+}
+
+void Histogram::snapshot(Snapshot& result) const
+{
+    result.buckets.assign(bucketsCount, 0);
+    result.count = 0;
+    result.sum = 0;
+    for (int shard = 0; shard < MetricsShards::shardsCount; ++shard) {
+        for (int i = 0; i < bucketsCount; ++i) {
+            long long count = shards_[shard].buckets[i].load(std::memory_order_relaxed);
+            result.buckets[i] += count;
+            result.count += count;
+        }
+        result.sum += shards_[shard].sum.load(std::memory_order_relaxed);
+    }
+}
+
+long long Histogram::Snapshot::quantile(double q) const
+{
+    if (count == 0) {
+        return 0;
+    }
+    long long rank = std::max(1LL, (long long)std::ceil(q * count));
+    long long seen = 0;
+    for (size_t i = 0; i < buckets.size(); ++i) {
+        seen += buckets[i];
+        if (seen >= rank) {
+            return bucketUpperBound(int(i));
+        }
+    }
+    return bucketUpperBound(bucketsCount - 1);
+}
+
+int Histogram::bucketIndex(long long value)
+{
+    if (value < subBuckets) {
+        return int(value);
+    }
+    int exponent = 63 - int(qCountLeadingZeroBits(quint64(value)));
+    if (exponent > maxExponent) {
+        return bucketsCount - 1;
+    }
+    int shift = exponent - subBucketBits;
+    return subBuckets + shift * subBuckets + int((value >> shift) & (subBuckets - 1));
+}
+
+long long Histogram::bucketUpperBound(int index)
+{
+    if (index < subBuckets) {
+        return index;
+    }
+    int shift = (index - subBuckets) / subBuckets;
+    long long lower = (long long)(subBuckets + index % subBuckets) << shift;
+    return lower + (1LL << shift) - 1;
+}
+
+Metrics& Metrics::instance()
+{
+    static Metrics metrics;
+    return metrics;
+}
+
+Metrics::Metrics()
+{
+}
+
+Metrics::Family& Metrics::family(const QString& name, const QString& help, Type type)
+{
+    auto it = families_.find(name);
+    if (it == families_.end()) {
+        it = families_.insert(std::make_pair(name, Family())).first;
+        it->second.type = type;
+        it->second.help = help;
+    }
+    Q_ASSERT(it->second.type == type);
+    return it->second;
+}
+
+Counter* Metrics::counter(const QString& name, const QString& help, const QString& labels)
+{
+    QMutexLocker locker(&mutex_);
+    Family& metricFamily = family(name, help, CounterType);
+    auto it = metricFamily.series.find(labels);
+    if (it != metricFamily.series.end()) {
+        return counters_[it->second].get();
+    }
+    counters_.emplace_back(new Counter());
+    metricFamily.series[labels] = counters_.size() - 1;
+    return counters_.back().get();
+}
+
+Gauge* Metrics::gauge(const QString& name, const QString& help, const QString& labels)
+{
+    QMutexLocker locker(&mutex_);
+    Family& metricFamily = family(name, help, GaugeType);
+    auto it = metricFamily.series.find(labels);
+    if (it != metricFamily.series.end()) {
+        return gauges_[it->second].get();
+    }
+    gauges_.emplace_back(new Gauge());
+    metricFamily.series[labels] = gauges_.size() - 1;
+    return gauges_.back().get();
+}
+
+Histogram* Metrics::histogram(const QString& name, const QString& help, const QString& labels)
+{
+    QMutexLocker locker(&mutex_);
+    Family& metricFamily = family(name, help, HistogramType);
+    auto it = metricFamily.series.find(labels);
+    if (it != metricFamily.series.end()) {
+        return histograms_[it->second].get();
+    }
+    histograms_.emplace_back(new Histogram());
+    metricFamily.series[labels] = histograms_.size() - 1;
+    return histograms_.back().get();
+}
+
+QByteArray Metrics::render() const
+{
+    QMutexLocker locker(&mutex_);
+    QByteArray text;
+    text.reserve(16 * 1024);
+    Histogram::Snapshot snapshot;
+    for (auto itFamily = families_.begin(); itFamily != families_.end(); ++itFamily) {
+        const QString& name = itFamily->first;
+        const Family& metricFamily = itFamily->second;
+        const char* type = metricFamily.type == CounterType ? "counter" : metricFamily.type == GaugeType ? "gauge" : "summary";
+        text += "# HELP " + name.toUtf8() + " " + metricFamily.help.toUtf8() + "\n";
+        text += "# TYPE " + name.toUtf8() + " " + type + "\n";
+        for (auto it = metricFamily.series.begin(); it != metricFamily.series.end(); ++it) {
+            const QString& labels = it->first;
+            switch (metricFamily.type) {
+            case CounterType:
+                text += seriesName(name, labels) + " " + QByteArray::number(counters_[it->second]->value()) + "\n";
+                break;
+            case GaugeType:
+                text += seriesName(name, labels) + " " + QByteArray::number(gauges_[it->second]->value()) + "\n";
+                break;
+            case HistogramType:
+                histograms_[it->second]->snapshot(snapshot);
+                for (double quantile : quantiles) {
+                    text += quantileSeriesName(name, labels, quantile) + " " + QByteArray::number(snapshot.quantile(quantile)) + "\n";
+                }
+                text += seriesName(name + "_sum", labels) + " " + QByteArray::number(snapshot.sum) + "\n";
+                text += seriesName(name + "_count", labels) + " " + QByteArray::number(snapshot.count) + "\n";
+                break;
+            }
+        }
+    }
+    return text;
+}
@@ -0,0 +1,155 @@
+// Copyright 2018 AtomicSwap Solutions Ltd. All rights reserved.
+// Use of this source code is governed by Microsoft Reference Source
+// License (MS-RSL) that can be found in the LICENSE file.
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QString>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <vector>
+
+// Every thread which records a metric gets one of shardsCount shards, so the
+// engine, the connection workers and the database writer do not share cache
+// lines. Recording is a relaxed atomic add on the thread's own shard, the
+// shards are summed when the metrics are rendered.
+namespace MetricsShards {
+    const int shardsCount = 8;
+    int current();
+}
+
+class Counter
+{
+public:
+    Counter();
+
+    void add(long long value = 1)
+    {
+        shards_[MetricsShards::current()].value.fetch_add(value, std::memory_order_relaxed);
+    }
+    long long value() const;
+private:
+    // a cache line apart, so shards of different threads never share a line
+    struct Shard {
+        std::atomic<long long> value;
+        char padding[64 - sizeof(std::atomic<long long>)];
+    };
+    Shard shards_[MetricsShards::shardsCount];
+};
+
+// A value which is set when the metrics are collected, like a queue depth.
+class Gauge
+{
+public:
+    Gauge() : value_(0) {}
+
+    void set(long long value) { value_.store(value, std::memory_order_relaxed); }
+    long long value() const { return value_.load(std::memory_order_relaxed); }
+private:
+    std::atomic<long long> value_;
+};
+
+// Log-linear histogram of non-negative values in the spirit of HdrHistogram:
+// values below subBuckets are exact, above that every power of two is split
+// into subBuckets buckets, so a quantile is within 1 / subBuckets of the
+// recorded value. Rendered as a summary with quantiles, sum and count.
+class Histogram
+{
+public:
+    static const int subBucketBits = 3;
+    static const int subBuckets = 1 << subBucketBits;
+    // values up to 2^maxExponent, larger ones are counted in the last bucket
+    static const int maxExponent = 40;
+    static const int bucketsCount = subBuckets + (maxExponent - subBucketBits + 1) * subBuckets;
+
+    Histogram();
+
+    void record(long long value);
+
+    struct Snapshot {
+        std::vector<long long> buckets;
+        long long count;
+        long long sum;
+
+        // the upper bound of the bucket which holds the quantile
+        long long quantile(double q) const;
+    };
+    void snapshot(Snapshot& result) const;
+private:
+    static int bucketIndex(long long value);
+    static long long bucketUpperBound(int index);
+private:
+    struct Shard {
+        Shard();
+        std::atomic<long long> buckets[bucketsCount];
+        std::atomic<long long> sum;
+    };
+    std::unique_ptr<Shard[]> shards_;
+};
+
+// Records the microseconds between its construction and destruction.
+class MetricsTimer
+{
+public:
+    explicit MetricsTimer(Histogram* histogram) :
+        histogram_(histogram)
+    {
+        timer_.start();
+    }
+    ~MetricsTimer()
+    {
+        histogram_->record(timer_.nsecsElapsed() / 1000);
+    }
+private:
+    Histogram* histogram_;
+    QElapsedTimer timer_;
+};
+
+// Registry of all metrics. Metrics are created once, usually into a static
+// pointer at the place which records them, and live until the process exits.
+// labels is the Prometheus label set without braces, e.g. command="init".
+class Metrics
+{
+public:
+    static Metrics& instance();
+
+    // the same name and labels return the same metric
+    Counter* counter(const QString& name, const QString& help, const QString& labels = QString());
+    Gauge* gauge(const QString& name, const QString& help, const QString& labels = QString());
+    Histogram* histogram(const QString& name, const QString& help, const QString& labels = QString());
+
+    // Prometheus text exposition format, version 0.0.4
+    QByteArray render() const;
+private:
+    enum Type {
+        CounterType,
+        GaugeType,
+        HistogramType
+    };
+
+    struct Family {
+        Type type;
+        QString help;
+        // labels -> index in the metrics of the type
+        std::map<QString, size_t> series;
+    };
+
+    Metrics();
+    Metrics(const Metrics&);
+    Metrics& operator = (const Metrics&);
+
+    Family& family(const QString& name, const QString& help, Type type);
+private:
+    mutable QMutex mutex_;
+    std::map<QString, Family> families_;
+    std::vector<std::unique_ptr<Counter>> counters_;
+    std::vector<std::unique_ptr<Gauge>> gauges_;
+    std::vector<std::unique_ptr<Histogram>> histograms_;
+};
+
+#endif // METRICS_H
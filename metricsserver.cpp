@@ -0,0 +1,56 @@
+// Copyright 2018 AtomicSwap Solutions Ltd. All rights reserved.
+// Use of this source code is governed by Microsoft Reference Source
+// License (MS-RSL) that can be found in the LICENSE file.
+
+#include "metricsserver.h"
+#include <QTcpSocket>
+#include "metrics.h"
+
+namespace {
+    // a scraper sends a short request, anything longer is not one
+    const int maxRequestSize = 8 * 1024;
+}
+
+MetricsServer::MetricsServer(QObject* parent) :
+    QTcpServer(parent)
+{
+    connect(this, SIGNAL(newConnection()), this, SLOT(onNewConnection()));
+}
+
+void MetricsServer::onNewConnection()
+{
+    while (QTcpSocket* socket = nextPendingConnection()) {
+        connect(socket, SIGNAL(readyRead()), this, SLOT(onReadyRead()));
+        connect(socket, SIGNAL(disconnected()), socket, SLOT(deleteLater()));
+    }
+}
+
+void MetricsServer::onReadyRead()
+{
+    QTcpSocket* socket = (QTcpSocket*)sender();
+    QByteArray request = socket->peek(maxRequestSize + 1);
+    if (!request.contains("\r\n\r\n") && !request.contains("\n\n")) {
+        if (request.size() > maxRequestSize) {
+            socket->abort();
+        }
+        return;
+    }
+    disconnect(socket, SIGNAL(readyRead()), this, SLOT(onReadyRead()));
+
+    QByteArray status;
+    QByteArray body;
+    if (request.startsWith("GET /metrics ") || request.startsWith("GET / ")) {
+        emit collecting();
+        status = "200 OK";
+        body = Metrics::instance().render();
+    } else {
+        status = "404 Not Found";
+        body = "Only GET /metrics is served\n";
+    }
+    socket->write("HTTP/1.0 " + status + "\r\n" \
+                  "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n" \
+                  "Content-Length: " + QByteArray::number(body.size()) + "\r\n" \
+                  "Connection: close\r\n\r\n");
+    socket->write(body);
+    socket->disconnectFromHost();
+}
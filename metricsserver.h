@@ -0,0 +1,27 @@
+// Copyright 2018 AtomicSwap Solutions Ltd. All rights reserved.
+// Use of this source code is governed by Microsoft Reference Source
+// License (MS-RSL) that can be found in the LICENSE file.
+
+#ifndef METRICSSERVER_H
+#define METRICSSERVER_H
+
+#include <QTcpServer>
+
+class QTcpSocket;
+
+// Minimal HTTP/1.0 server on a local port which answers GET /metrics with
+// Metrics::instance().render(). collecting() is emitted before every render so
+// that the owner can update its gauges, and it runs in the owner's thread.
+class MetricsServer : public QTcpServer
+{
+    Q_OBJECT
+public:
+    explicit MetricsServer(QObject* parent = nullptr);
+signals:
+    void collecting();
+private slots:
+    void onNewConnection();
+    void onReadyRead();
+};
+
+#endif // METRICSSERVER_H
@@ -0,0 +1,115 @@
+// Copyright 2018 AtomicSwap Solutions Ltd. All rights reserved.
+// Use of this source code is governed by Microsoft Reference Source
+// License (MS-RSL) that can be found in the LICENSE file.
+
+#include "orderbook.h"
+#include "info.h"
+
+namespace {
+#ifndef __SIZEOF_INT128__
+    // the 128-bit product of a and b from four 32-bit products
+    void multiply(quint64 a, quint64 b, quint64& high, quint64& low)
+    {
+        quint64 aLow = a & 0xffffffff;
+        quint64 aHigh = a >> 32;
+        quint64 bLow = b & 0xffffffff;
+        quint64 bHigh = b >> 32;
+        quint64 lowLow = aLow * bLow;
+        quint64 lowHigh = aLow * bHigh;
+        quint64 highLow = aHigh * bLow;
+        quint64 middle = (lowLow >> 32) + (lowHigh & 0xffffffff) + (highLow & 0xffffffff);
+        low = (middle << 32) | (lowLow & 0xffffffff);
+        high = aHigh * bHigh + (lowHigh >> 32) + (highLow >> 32) + (middle >> 32);
+    }
+#endif
+
+    // sign of a * b - c * d, exact for any 64-bit amounts
+    int compareProducts(quint64 a, quint64 b, quint64 c, quint64 d)
+    {
+#ifdef __SIZEOF_INT128__
+        unsigned __int128 left = (unsigned __int128)a * b;
+        unsigned __int128 right = (unsigned __int128)c * d;
+        return left < right ? -1 : (left > right ? 1 : 0);
+#else
+        quint64 leftHigh, leftLow, rightHigh, rightLow;
+        multiply(a, b, leftHigh, leftLow);
+        multiply(c, d, rightHigh, rightLow);
+        if (leftHigh != rightHigh) {
+            return leftHigh < rightHigh ? -1 : 1;
+        }
+        return leftLow < rightLow ? -1 : (leftLow > rightLow ? 1 : 0);
+#endif
+    }
+}
+
+bool OrderBook::PriceLess::operator()(const OrderInfoPtr& left, const OrderInfoPtr& right) const
+{
+    // left.getCount / left.sendCount < right.getCount / right.sendCount without division.
+    // The products are compared in 128 bits, so prices which differ in the last unit
+    // are never equal. It is a strict weak ordering only for positive counts, see
+    // OrderInfo::hasPrice().
+    int order = compareProducts(left->getCount_, right->sendCount_, right->getCount_, left->sendCount_);
+    if (order != 0) {
+        return order < 0;
+    }
+    return left->orderId_ < right->orderId_;
+}
+
+void OrderBook::load(Orders&& orders)
+{
+    orders_ = std::move(orders);
+    pairs_.clear();
+    for (auto it = orders_.begin(); it != orders_.end(); ++it) {
+        pairs_[CurrencyPair(it->second->sendCur_.toString(), it->second->getCur_.toString())].insert(it->second);
+    }
+}
+
+void OrderBook::insert(OrderInfoPtr order)
+{
+    Q_ASSERT(order->hasPrice());
+    orders_[order->orderId_] = order;
+    pairs_[CurrencyPair(order->sendCur_.toString(), order->getCur_.toString())].insert(order);
+}
+
+OrderInfoPtr OrderBook::find(long long id) const
+{
+    auto it = orders_.find(id);
+    if (it != orders_.end()) {
+        return it->second;
+    } else {
+        return OrderInfoPtr();
+    }
+}
+
+OrderInfoPtr OrderBook::take(long long id)
+{
+    auto it = orders_.find(id);
+    if (it == orders_.end()) {
+        return OrderInfoPtr();
+    }
+    OrderInfoPtr order = it->second;
+    orders_.erase(it);
+
+    auto itPair = pairs_.find(CurrencyPair(order->sendCur_.toString(), order->getCur_.toString()));
+    if (itPair != pairs_.end()) {
+        itPair->second.erase(order);
+        if (itPair->second.empty()) {
+            pairs_.erase(itPair);
+        }
+    }
+    return order;
+}
+
+void OrderBook::getOrders(const CurrencyPair& pair, size_t limit, std::vector<OrderInfoPtr>& orders) const
+{
+    auto itPair = pairs_.find(pair);
+    if (itPair == pairs_.end()) {
+        return;
+    }
+    const PriceLevels& levels = itPair->second;
+    size_t count = (limit > 0 && limit < levels.size()) ? limit : levels.size();
+    orders.reserve(orders.size() + count);
+    for (auto it = levels.begin(); it != levels.end() && count > 0; ++it, --count) {
+        orders.push_back(*it);
+    }
+}
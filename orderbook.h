@@ -0,0 +1,47 @@
+// Copyright 2018 AtomicSwap Solutions Ltd. All rights reserved.
+// Use of this source code is governed by Microsoft Reference Source
+// License (MS-RSL) that can be found in the LICENSE file.
+
+#ifndef ORDERBOOK_H
+#define ORDERBOOK_H
+
+#include <QString>
+#include <map>
+#include <memory>
+#include <set>
+#include <utility>
+#include <vector>
+
+struct OrderInfo;
+using OrderInfoPtr = std::shared_ptr<OrderInfo>;
+using Orders = std::map<long long, OrderInfoPtr>;
+
+// (sendCur, getCur)
+using CurrencyPair = std::pair<QString, QString>;
+
+// Active orders indexed by id and by currency pair. Inside a pair orders are
+// kept in price levels ordered by getCount / sendCount, the cheapest first,
+// orders with the same price are ordered by id.
+class OrderBook
+{
+public:
+    void load(Orders&& orders);
+    void insert(OrderInfoPtr order);
+    OrderInfoPtr find(long long id) const;
+    OrderInfoPtr take(long long id);
+    void getOrders(const CurrencyPair& pair, size_t limit, std::vector<OrderInfoPtr>& orders) const;
+
+    const Orders& orders() const { return orders_; }
+    size_t size() const { return orders_.size(); }
+private:
+    struct PriceLess {
+        bool operator()(const OrderInfoPtr& left, const OrderInfoPtr& right) const;
+    };
+    using PriceLevels = std::set<OrderInfoPtr, PriceLess>;
+    using Pairs = std::map<CurrencyPair, PriceLevels>;
+
+    Orders orders_;
+    Pairs pairs_;
+};
+
+#endif // ORDERBOOK_H
@@ -0,0 +1,106 @@
+// Copyright 2018 AtomicSwap Solutions Ltd. All rights reserved.
+// Use of this source code is governed by Microsoft Reference Source
+// License (MS-RSL) that can be found in the LICENSE file.
+
+#include "ratelimiter.h"
+#include <algorithm>
+
+namespace {
+    const int wheelSlots = 64;
+}
+
+RateLimiter::RateLimiter() :
+    wheel_(wheelSlots),
+    tickMs_(1),
+    currentTick_(0),
+    capacity_(0),
+    refillPerMs_(0),
+    idleMs_(0)
+{
+    clock_.start();
+}
+
+void RateLimiter::configure(double requests, qint64 intervalMs)
+{
+    buckets_.clear();
+    for (size_t i = 0; i < wheel_.size(); ++i) {
+        wheel_[i].clear();
+    }
+    if (requests <= 0 || intervalMs <= 0) {
+        capacity_ = 0;
+        return;
+    }
+    capacity_ = requests;
+    refillPerMs_ = requests / intervalMs;
+    // an empty bucket is full again after one interval
+    idleMs_ = intervalMs;
+    // so every deadline is less than one turn of the wheel ahead
+    tickMs_ = std::max<qint64>(1, (intervalMs + wheelSlots - 2) / (wheelSlots - 1));
+    currentTick_ = clock_.elapsed() / tickMs_;
+}
+
+void RateLimiter::setCost(const QString& command, double cost)
+{
+    costs_.insert(command, cost);
+}
+
+bool RateLimiter::consume(const IpKey& key, double cost)
+{
+    qint64 nowMs = clock_.elapsed();
+    qint64 tick = nowMs / tickMs_;
+    if (tick > currentTick_) {
+        expire(tick);
+    }
+
+    auto it = buckets_.find(key);
+    if (it == buckets_.end()) {
+        if (cost > capacity_) {
+            return false;
+        }
+        Bucket bucket;
+        bucket.tokens = capacity_ - cost;
+        bucket.lastMs = nowMs;
+        buckets_.emplace(key, bucket);
+        schedule(key, nowMs);
+        return true;
+    }
+
+    Bucket& bucket = it->second;
+    bucket.tokens = std::min(capacity_, bucket.tokens + (nowMs - bucket.lastMs) * refillPerMs_);
+    // the wheel entry is moved lazily when it comes up
+    bucket.lastMs = nowMs;
+    if (bucket.tokens < cost) {
+        return false;
+    }
+    bucket.tokens -= cost;
+    return true;
+}
+
+void RateLimiter::schedule(const IpKey& key, qint64 lastMs)
+{
+    qint64 tick = (lastMs + idleMs_) / tickMs_ + 1;
+    wheel_[tick % wheelSlots].push_back(key);
+}
+
+void RateLimiter::expire(qint64 tick)
+{
+    // after a long pause every slot is due, each is visited once
+    qint64 first = std::max(currentTick_ + 1, tick - wheelSlots + 1);
+    currentTick_ = tick;
+    qint64 nowMs = tick * tickMs_;
+    for (qint64 t = first; t <= tick; ++t) {
+        Slot due;
+        due.swap(wheel_[t % wheelSlots]);
+        for (size_t i = 0; i < due.size(); ++i) {
+            auto it = buckets_.find(due[i]);
+            if (it == buckets_.end()) {
+                continue;
+            }
+            if (nowMs - it->second.lastMs >= idleMs_) {
+                buckets_.erase(it);
+            } else {
+                schedule(due[i], it->second.lastMs);
+            }
+        }
+    }
+}
@@ -0,0 +1,58 @@
+// Copyright 2018 AtomicSwap Solutions Ltd. All rights reserved.
+// Use of this source code is governed by Microsoft Reference Source
+// License (MS-RSL) that can be found in the LICENSE file.
+
+#ifndef RATELIMITER_H
+#define RATELIMITER_H
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QString>
+#include <unordered_map>
+#include <vector>
+#include "ipkey.h"
+
+// Token bucket per client IP. A bucket holds up to `requests` tokens and
+// refills at `requests` per interval, every request takes the cost of its
+// command. A bucket which refilled completely is the same as no bucket, so it
+// is dropped by a timer wheel which the requests themselves advance.
+class RateLimiter
+{
+public:
+    RateLimiter();
+
+    // 0 requests or interval disables the limiter
+    void configure(double requests, qint64 intervalMs);
+    bool isEnabled() const { return capacity_ > 0; }
+    // commands without a cost take 1 token
+    void setCost(const QString& command, double cost);
+    double cost(const QString& command) const { return costs_.value(command, 1.0); }
+
+    // takes cost tokens from the bucket of key, false when there are not enough
+    bool consume(const IpKey& key, double cost);
+    size_t size() const { return buckets_.size(); }
+private:
+    struct Bucket {
+        double tokens;
+        qint64 lastMs;
+    };
+    using Buckets = std::unordered_map<IpKey, Bucket, IpKeyHash>;
+    using Slot = std::vector<IpKey>;
+
+    void schedule(const IpKey& key, qint64 lastMs);
+    void expire(qint64 tick);
+private:
+    Buckets buckets_;
+    // a key sits in the slot of the tick when its bucket will be full, it is
+    // checked then and moved on if the bucket was used in the meantime
+    std::vector<Slot> wheel_;
+    qint64 tickMs_;
+    qint64 currentTick_;
+    double capacity_;
+    double refillPerMs_;
+    qint64 idleMs_;
+    QHash<QString, double> costs_;
+    QElapsedTimer clock_;
+};
+
+#endif // RATELIMITER_H
@@ -0,0 +1,88 @@
+// Copyright 2018 AtomicSwap Solutions Ltd. All rights reserved.
+// Use of this source code is governed by Microsoft Reference Source
+// License (MS-RSL) that can be found in the LICENSE file.
+
+#include "replystream.h"
+
+namespace {
+    // UTF-8 of text appended to out, addresses and currencies are ASCII and take the loop
+    void appendUtf8(QByteArray& out, const QString& text)
+    {
+        const QChar* chars = text.constData();
+        int size = text.size();
+        for (int i = 0; i < size; ++i) {
+            ushort c = chars[i].unicode();
+            if (c >= 0x80) {
+                out += text.midRef(i).toUtf8();
+                return;
+            }
+            out += char(c);
+        }
+    }
+}
+
+ReplyStream::ReplyStream() :
+    next_(0)
+{
+}
+
+void ReplyStream::append(const QByteArray& json, bool separated)
+{
+    Part part;
+    part.json = json;
+    part.size = json.size();
+    part.isString = false;
+    part.separated = separated;
+    parts_.push_back(part);
+}
+
+void ReplyStream::appendLine(const QByteArray& line, bool separated)
+{
+    append(line, separated);
+    if (line.endsWith('\n')) {
+        --parts_.back().size;
+    }
+}
+
+void ReplyStream::appendString(const QString& text, bool separated)
+{
+    Part part;
+    part.size = 0;
+    part.text = text;
+    part.isString = true;
+    part.separated = separated;
+    parts_.push_back(part);
+}
+
+void ReplyStream::nextChunk(int chunkSize, QByteArray& chunk)
+{
+    // resize() keeps the allocation where clear() would free it
+    chunk.resize(0);
+    while (next_ < parts_.size() && chunk.size() < chunkSize) {
+        Part& part = parts_[next_++];
+        if (part.separated) {
+            chunk += ", ";
+        }
+        if (part.isString) {
+            chunk += '"';
+            appendUtf8(chunk, part.text);
+            chunk += '"';
+        } else {
+            chunk.append(part.json.constData(), part.size);
+        }
+        // the part is written, its shared data can go
+        part.json = QByteArray();
+        part.text = QString();
+    }
+}
+
+QByteArray ReplyStream::readAll()
+{
+    QByteArray reply;
+    QByteArray chunk;
+    while (!atEnd()) {
+        nextChunk(64 * 1024, chunk);
+        reply += chunk;
+    }
+    return reply;
+}
@@ -0,0 +1,54 @@
+// Copyright 2018 AtomicSwap Solutions Ltd. All rights reserved.
+// Use of this source code is governed by Microsoft Reference Source
+// License (MS-RSL) that can be found in the LICENSE file.
+
+#ifndef REPLYSTREAM_H
+#define REPLYSTREAM_H
+
+#include <QByteArray>
+#include <QMetaType>
+#include <QString>
+#include <memory>
+#include <vector>
+
+// A large JSON reply, like the init snapshot, which is written to a socket in
+// chunks. The engine builds it from parts it already has: the cached JSON of
+// orders and trades and the address strings are implicitly shared, so building
+// copies no JSON and the parts stay as they were when the reply was built even
+// if the orders and trades change later. A connection worker encodes the parts
+// into one reused chunk buffer at a time when its socket has room for them.
+class ReplyStream
+{
+public:
+    ReplyStream();
+
+    // separated puts ", " before the part, for elements of a JSON array after the first
+    void append(const QByteArray& json, bool separated = false);
+    // a '\n' terminated message without the '\n'
+    void appendLine(const QByteArray& line, bool separated = false);
+    // a JSON string, the text is taken as it is like the replies built by the engine do
+    void appendString(const QString& text, bool separated = false);
+
+    bool atEnd() const { return next_ == parts_.size(); }
+    // replaces chunk with the next parts, at least chunkSize bytes of them unless
+    // it is the end, the capacity of chunk is kept for the next call
+    void nextChunk(int chunkSize, QByteArray& chunk);
+    // the whole reply at once, for a connection which needs it in one frame
+    QByteArray readAll();
+private:
+    struct Part {
+        QByteArray json;
+        // bytes of json which are written
+        int size;
+        QString text;
+        bool isString;
+        bool separated;
+    };
+    std::vector<Part> parts_;
+    size_t next_;
+};
+
+using ReplyStreamPtr = std::shared_ptr<ReplyStream>;
+Q_DECLARE_METATYPE(ReplyStreamPtr)
+
+#endif // REPLYSTREAM_H
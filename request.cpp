@@ -0,0 +1,200 @@
+// Copyright 2018 AtomicSwap Solutions Ltd. All rights reserved.
+// Use of this source code is governed by Microsoft Reference Source
+// License (MS-RSL) that can be found in the LICENSE file.
+
+#include "request.h"
+#include "jsonreader.h"
+
+TradeUpdate::TradeUpdate() :
+    id(0),
+    commissionInitiatorPaid(false),
+    commissionParticipantPaid(false),
+    hasRefundedInit(false),
+    refundedInit(false),
+    hasRefundedPart(false),
+    refundedPart(false),
+    hasRefundTimeInit(false),
+    refundTimeInit(0),
+    hasRefundTimePart(false),
+    refundTimePart(0)
+{
+}
+
+Request::Request() :
+    command(Commands::Unknown),
+    id(0),
+    orderId(0),
+    binaryProtocol(false),
+    hasLastSeq(false),
+    lastSeq(0),
+    epoch(0),
+    limit(0)
+{
+}
+
+namespace RequestParser
+{
+    namespace {
+        OrderInfoPtr newOrder()
+        {
+            OrderInfoPtr order = OrderInfo::create();
+            order->orderId_ = 0;
+            order->sendCount_ = 0;
+            order->getCount_ = 0;
+            return order;
+        }
+
+        // a value which is not an object is an order without fields, like QJsonValue::toObject()
+        bool readOrder(JsonReader& reader, OrderInfo& order, Request& request)
+        {
+            if (!reader.isNextObject()) {
+                return reader.skipValue();
+            }
+            reader.beginObject();
+            JsonReader::Name name;
+            while (reader.nextMember(name)) {
+                if (name == "sendCur") {
+                    reader.readString(request.orderSendCur);
+                } else if (name == "getCur") {
+                    reader.readString(request.orderGetCur);
+                } else if (name == "sendCount") {
+                    reader.readInteger(order.sendCount_);
+                } else if (name == "getCount") {
+                    reader.readInteger(order.getCount_);
+                } else if (name == "getAddr") {
+                    reader.readString(order.getAddress_);
+                } else {
+                    reader.skipValue();
+                }
+            }
+            return !reader.hasError();
+        }
+
+        bool readTrade(JsonReader& reader, TradeUpdate& trade)
+        {
+            if (!reader.isNextObject()) {
+                return reader.skipValue();
+            }
+            reader.beginObject();
+            JsonReader::Name name;
+            while (reader.nextMember(name)) {
+                if (name == "id") {
+                    reader.readInteger(trade.id);
+                } else if (name == "secretHash") {
+                    reader.readString(trade.secretHash);
+                } else if (name == "contractInitiator") {
+                    reader.readString(trade.contractInitiator);
+                } else if (name == "contractParticipant") {
+                    reader.readString(trade.contractParticipant);
+                } else if (name == "initiatorContractTransaction") {
+                    reader.readString(trade.initiatorContractTransaction);
+                } else if (name == "participantContractTransaction") {
+                    reader.readString(trade.participantContractTransaction);
+                } else if (name == "initiatorRedemptionTransaction") {
+                    reader.readString(trade.initiatorRedemptionTransaction);
+                } else if (name == "participantRedemptionTransaction") {
+                    reader.readString(trade.participantRedemptionTransaction);
+                } else if (name == "commissionInitiatorPaid") {
+                    reader.readBool(trade.commissionInitiatorPaid);
+                } else if (name == "commissionParticipantPaid") {
+                    reader.readBool(trade.commissionParticipantPaid);
+                } else if (name == "refundedInit") {
+                    trade.hasRefundedInit = true;
+                    reader.readBool(trade.refundedInit);
+                } else if (name == "refundedPart") {
+                    trade.hasRefundedPart = true;
+                    reader.readBool(trade.refundedPart);
+                } else if (name == "refundTimeInit") {
+                    trade.hasRefundTimeInit = true;
+                    reader.readInteger(trade.refundTimeInit);
+                } else if (name == "refundTimePart") {
+                    trade.hasRefundTimePart = true;
+                    reader.readInteger(trade.refundTimePart);
+                } else {
+                    reader.skipValue();
+                }
+            }
+            return !reader.hasError();
+        }
+
+        // the addrs of every element of curs, an init with hundreds of addresses allocates only their strings
+        bool readCurs(JsonReader& reader, std::vector<QString>& addrs)
+        {
+            if (!reader.isNextArray()) {
+                return reader.skipValue();
+            }
+            reader.beginArray();
+            while (reader.nextElement()) {
+                if (!reader.isNextObject()) {
+                    reader.skipValue();
+                    continue;
+                }
+                reader.beginObject();
+                JsonReader::Name name;
+                while (reader.nextMember(name)) {
+                    if (name != "addrs" || !reader.isNextArray()) {
+                        reader.skipValue();
+                        continue;
+                    }
+                    reader.beginArray();
+                    while (reader.nextElement()) {
+                        addrs.emplace_back();
+                        reader.readString(addrs.back());
+                    }
+                }
+            }
+            return !reader.hasError();
+        }
+    }
+
+    bool parse(const QByteArray& json, Request& request)
+    {
+        JsonReader reader(json);
+        if (!reader.isNextObject()) {
+            return false;
+        }
+        reader.beginObject();
+        JsonReader::Name name;
+        while (reader.nextMember(name)) {
+            if (name == "command") {
+                JsonReader::Name command;
+                reader.readRawString(command);
+                request.command = Commands::find(command.data, command.size);
+            } else if (name == "key") {
+                reader.readString(request.key);
+            } else if (name == "order") {
+                request.order = newOrder();
+                readOrder(reader, *request.order, request);
+            } else if (name == "trade") {
+                readTrade(reader, request.trade);
+            } else if (name == "id") {
+                reader.readInteger(request.id);
+            } else if (name == "orderId") {
+                reader.readInteger(request.orderId);
+            } else if (name == "address") {
+                reader.readString(request.address);
+            } else if (name == "curs") {
+                request.addrs.clear();
+                readCurs(reader, request.addrs);
+            } else if (name == "protocol") {
+                JsonReader::Name protocol;
+                reader.readRawString(protocol);
+                request.binaryProtocol = protocol == "binary";
+            } else if (name == "lastSeq") {
+                request.hasLastSeq = true;
+                reader.readInteger(request.lastSeq);
+            } else if (name == "epoch") {
+                reader.readInteger(request.epoch);
+            } else if (name == "sendCur") {
+                reader.readString(request.sendCur);
+            } else if (name == "getCur") {
+                reader.readString(request.getCur);
+            } else if (name == "limit") {
+                reader.readInteger(request.limit);
+            } else {
+                reader.skipValue();
+            }
+        }
+        return reader.atEnd();
+    }
+}
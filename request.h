@@ -0,0 +1,81 @@
+// Copyright 2018 AtomicSwap Solutions Ltd. All rights reserved.
+// Use of this source code is governed by Microsoft Reference Source
+// License (MS-RSL) that can be found in the LICENSE file.
+
+#ifndef REQUEST_H
+#define REQUEST_H
+
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+#include <vector>
+#include "commands.h"
+#include "info.h"
+
+// Fields of an update_trade request. The refund fields change the trade only
+// when they are in the request, the others always do.
+struct TradeUpdate {
+    TradeUpdate();
+
+    long long id;
+    QString secretHash;
+    QString contractInitiator;
+    QString contractParticipant;
+    QString initiatorContractTransaction;
+    QString participantContractTransaction;
+    QString initiatorRedemptionTransaction;
+    QString participantRedemptionTransaction;
+    bool commissionInitiatorPaid;
+    bool commissionParticipantPaid;
+    bool hasRefundedInit;
+    bool refundedInit;
+    bool hasRefundedPart;
+    bool refundedPart;
+    bool hasRefundTimeInit;
+    long long refundTimeInit;
+    bool hasRefundTimePart;
+    long long refundTimePart;
+};
+
+// A request parsed by a connection worker into the fields of its command. A
+// field which is not in the request has the value a QJsonValue conversion of
+// a missing member gives: a null string, 0 or false.
+struct Request {
+    Request();
+
+    Commands::Command command;
+    QString key;
+    // delete_order
+    long long id;
+    // create_trade
+    long long orderId;
+    QString address;
+    // init and request_swap_commission, the addrs of all curs
+    std::vector<QString> addrs;
+    // init
+    bool binaryProtocol;
+    bool hasLastSeq;
+    long long lastSeq;
+    long long epoch;
+    // get_orders, subscribe and unsubscribe
+    QString sendCur;
+    QString getCur;
+    long long limit;
+    // create_order, the id is given by the engine, nullptr when the request has no order
+    OrderInfoPtr order;
+    // the currency codes of the order as text, the engine interns them once it accepts the order
+    QString orderSendCur;
+    QString orderGetCur;
+    // update_trade
+    TradeUpdate trade;
+};
+using Requests = QVector<Request>;
+
+namespace RequestParser
+{
+    // JSON text of a request, read with JsonReader without building a document.
+    // False when it is not a JSON object.
+    bool parse(const QByteArray& json, Request& request);
+}
+
+#endif // REQUEST_H
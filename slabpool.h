@@ -0,0 +1,138 @@
+// Copyright 2018 AtomicSwap Solutions Ltd. All rights reserved.
+// Use of this source code is governed by Microsoft Reference Source
+// License (MS-RSL) that can be found in the LICENSE file.
+
+#ifndef SLABPOOL_H
+#define SLABPOOL_H
+
+#include <QMutex>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+// Totals of all pools, for the metrics and the memory benchmark.
+namespace SlabPools
+{
+    inline std::atomic<long long>& slabBytesCounter()
+    {
+        static std::atomic<long long> bytes(0);
+        return bytes;
+    }
+    inline std::atomic<long long>& usedBytesCounter()
+    {
+        static std::atomic<long long> bytes(0);
+        return bytes;
+    }
+
+    // memory taken by slabs from the system
+    inline long long slabBytes() { return slabBytesCounter().load(std::memory_order_relaxed); }
+    // the part of it which holds records
+    inline long long usedBytes() { return usedBytesCounter().load(std::memory_order_relaxed); }
+}
+
+// Fixed-size slots carved from slabs of slotsPerSlab slots. Records of one
+// type are allocated next to each other without a malloc header per record,
+// freed slots are reused by the next allocation. Slabs are never returned to
+// the system, the pool of a size lives until the process exits, so records
+// which are released by static destructors are still valid to free. Records
+// are created by the connection workers and released by any thread, the pool
+// is guarded by a mutex which is never held longer than a free list update.
+template<size_t Size, size_t Align>
+class SlabPool
+{
+public:
+    static const int slotsPerSlab = 256;
+
+    static SlabPool& instance()
+    {
+        static SlabPool* pool = new SlabPool();
+        return *pool;
+    }
+
+    void* allocate()
+    {
+        QMutexLocker locker(&mutex_);
+        if (!free_) {
+            addSlab();
+        }
+        Slot* slot = free_;
+        free_ = slot->next;
+        SlabPools::usedBytesCounter().fetch_add(sizeof(Slot), std::memory_order_relaxed);
+        return slot;
+    }
+    void deallocate(void* p)
+    {
+        Slot* slot = static_cast<Slot*>(p);
+        QMutexLocker locker(&mutex_);
+        slot->next = free_;
+        free_ = slot;
+        SlabPools::usedBytesCounter().fetch_sub(sizeof(Slot), std::memory_order_relaxed);
+    }
+private:
+    union Slot {
+        Slot* next;
+        typename std::aligned_storage<Size, Align>::type storage;
+    };
+
+    SlabPool() :
+        free_(nullptr)
+    {
+    }
+
+    void addSlab()
+    {
+        Slot* slab = new Slot[slotsPerSlab];
+        slabs_.emplace_back(slab);
+        SlabPools::slabBytesCounter().fetch_add(slotsPerSlab * sizeof(Slot), std::memory_order_relaxed);
+        // the free list follows the slab, so consecutive records are neighbours in memory
+        for (int i = slotsPerSlab - 1; i >= 0; --i) {
+            slab[i].next = free_;
+            free_ = &slab[i];
+        }
+    }
+private:
+    QMutex mutex_;
+    Slot* free_;
+    std::vector<std::unique_ptr<Slot[]>> slabs_;
+};
+
+// Allocator for std::allocate_shared: the record and its reference counts take
+// one slot of the pool of their combined size.
+template<class T>
+class PoolAllocator
+{
+public:
+    using value_type = T;
+
+    PoolAllocator() {}
+    template<class U>
+    PoolAllocator(const PoolAllocator<U>&) {}
+
+    T* allocate(size_t n)
+    {
+        if (n != 1) {
+            return std::allocator<T>().allocate(n);
+        }
+        return static_cast<T*>(pool().allocate());
+    }
+    void deallocate(T* p, size_t n)
+    {
+        if (n != 1) {
+            std::allocator<T>().deallocate(p, n);
+            return;
+        }
+        pool().deallocate(p);
+    }
+
+    static SlabPool<sizeof(T), alignof(T)>& pool() { return SlabPool<sizeof(T), alignof(T)>::instance(); }
+};
+
+template<class T, class U>
+bool operator == (const PoolAllocator<T>&, const PoolAllocator<U>&) { return true; }
+template<class T, class U>
+bool operator != (const PoolAllocator<T>&, const PoolAllocator<U>&) { return false; }
+
+#endif // SLABPOOL_H
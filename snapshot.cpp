@@ -0,0 +1,492 @@
+// Copyright 2018 AtomicSwap Solutions Ltd. All rights reserved.
+// Use of this source code is governed by Microsoft Reference Source
+// License (MS-RSL) that can be found in the LICENSE file.
+
+#include "snapshot.h"
+#include "info.h"
+#include "logger.h"
+#include <QDataStream>
+#include <QFileInfo>
+#include <algorithm>
+#include <cstdio>
+
+#ifdef Q_OS_UNIX
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace {
+    const quint32 snapshotMagic = 0x41455350; // "AESP"
+    const quint32 journalMagic = 0x4145534a; // "AESJ"
+    // 3 has CRC-32C checksums, files of an older version are not read
+    const quint32 formatVersion = 3;
+    // magic, version, generation, max order id, max trade id, payload size, payload checksum
+    const qint64 snapshotHeaderSize = 4 + 4 + 8 + 8 + 8 + 8 + 4;
+    // magic, version, generation
+    const qint64 journalHeaderSize = 4 + 4 + 8;
+    // payload size, payload checksum
+    const qint64 recordHeaderSize = 4 + 4;
+    const int streamVersion = QDataStream::Qt_5_0;
+
+    struct Crc32cTable {
+        Crc32cTable()
+        {
+            // reflected Castagnoli polynomial
+            const quint32 polynomial = 0x82f63b78;
+            for (quint32 i = 0; i < 256; ++i) {
+                quint32 crc = i;
+                for (int bit = 0; bit < 8; ++bit) {
+                    crc = (crc >> 1) ^ (crc & 1 ? polynomial : 0);
+                }
+                entries[i] = crc;
+            }
+        }
+
+        quint32 entries[256];
+    };
+
+    // CRC-32C, unlike the 16-bit qChecksum it misses a torn or corrupted payload
+    // once in four billion instead of once in 65536
+    quint32 crc32c(const char* data, qint64 size)
+    {
+        static const Crc32cTable table;
+        quint32 crc = 0xffffffff;
+        for (qint64 i = 0; i < size; ++i) {
+            crc = table.entries[(crc ^ quint8(data[i])) & 0xff] ^ (crc >> 8);
+        }
+        return crc ^ 0xffffffff;
+    }
+
+    // waits until the written data of the file is on the disk
+    bool syncFile(QFile& file)
+    {
+        if (!file.flush()) {
+            return false;
+        }
+#ifdef Q_OS_UNIX
+        return ::fsync(file.handle()) == 0;
+#else
+        return true;
+#endif
+    }
+
+    // a rename is durable once the directory which holds the file is synced
+    bool syncDirectory(const QString& fileName)
+    {
+#ifdef Q_OS_UNIX
+        int fd = ::open(QFile::encodeName(QFileInfo(fileName).absolutePath()).constData(), O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+        bool res = ::fsync(fd) == 0;
+        ::close(fd);
+        return res;
+#else
+        Q_UNUSED(fileName);
+        return true;
+#endif
+    }
+
+    void writeOrder(QDataStream& out, const OrderInfo& order)
+    {
+        out << qint64(order.orderId_) << order.sendCur_.toString() << qint64(order.sendCount_)
+            << order.getCur_.toString() << qint64(order.getCount_) << order.getAddress_ << order.getHash();
+    }
+
+    OrderInfoPtr readOrder(QDataStream& in)
+    {
+        qint64 id, sendCount, getCount;
+        QString sendCur, getCur, hash;
+        OrderInfoPtr order = OrderInfo::create();
+        in >> id >> sendCur >> sendCount >> getCur >> getCount >> order->getAddress_ >> hash;
+        order->orderId_ = id;
+        order->sendCur_ = CurrencyCode::fromString(sendCur);
+        order->sendCount_ = sendCount;
+        order->getCur_ = CurrencyCode::fromString(getCur);
+        order->getCount_ = getCount;
+        order->setHash(hash);
+        return order;
+    }
+
+    void writeTrade(QDataStream& out, const TradeInfo& trade)
+    {
+        writeOrder(out, *trade.order_);
+        out << qint64(trade.tradeId_) << trade.initiatorAddress_ << trade.secretHash_
+            << trade.contractInitiator_ << trade.contractParticipant_
+            << trade.initiatorContractTransaction_ << trade.participantContractTransaction_
+            << trade.initiatorRedemptionTransaction_ << trade.participantRedemptionTransaction_
+            << trade.initiatorCommissionPaid_ << trade.participantCommissionPaid_
+            << trade.refundedInit_ << trade.refundedPart_
+            << qint64(trade.refundTimeInit_) << qint64(trade.refundTimePart_) << trade.getHash();
+    }
+
+    TradeInfoPtr readTrade(QDataStream& in)
+    {
+        TradeInfoPtr trade = TradeInfo::create();
+        trade->order_ = readOrder(in);
+        qint64 id, refundTimeInit, refundTimePart;
+        QString hash;
+        in >> id >> trade->initiatorAddress_ >> trade->secretHash_
+           >> trade->contractInitiator_ >> trade->contractParticipant_
+           >> trade->initiatorContractTransaction_ >> trade->participantContractTransaction_
+           >> trade->initiatorRedemptionTransaction_ >> trade->participantRedemptionTransaction_
+           >> trade->initiatorCommissionPaid_ >> trade->participantCommissionPaid_
+           >> trade->refundedInit_ >> trade->refundedPart_
+           >> refundTimeInit >> refundTimePart >> hash;
+        trade->tradeId_ = id;
+        trade->refundTimeInit_ = refundTimeInit;
+        trade->refundTimePart_ = refundTimePart;
+        trade->setHash(hash);
+        return trade;
+    }
+
+    // a trade whose order is still in the orders shares its record instead of a copy
+    void shareOrder(const Orders& orders, TradeInfo& trade)
+    {
+        auto it = orders.find(trade.order_->orderId_);
+        if (it != orders.end()) {
+            trade.order_ = it->second;
+        }
+    }
+
+    void writeMutation(QDataStream& out, const DBMutation& mutation)
+    {
+        out << quint8(mutation.type);
+        switch (mutation.type) {
+        case DBMutation::AddOrder:
+            writeOrder(out, *mutation.order);
+            break;
+        case DBMutation::AddTrade:
+        case DBMutation::UpdateTrade:
+            writeTrade(out, *mutation.trade);
+            break;
+        case DBMutation::AddToBlackList:
+            out << mutation.ip << qint64(mutation.id);
+            break;
+        case DBMutation::RemoveFromBlackList:
+            out << mutation.ip;
+            break;
+        case DBMutation::DeleteOrder:
+        case DBMutation::DeleteTrade:
+            out << qint64(mutation.id);
+            break;
+        case DBMutation::Checkpoint:
+            break;
+        }
+    }
+
+    bool readMutation(QDataStream& in, DBMutation& mutation)
+    {
+        quint8 type;
+        in >> type;
+        mutation.type = DBMutation::Type(type);
+        switch (mutation.type) {
+        case DBMutation::AddOrder:
+            mutation.order = readOrder(in);
+            break;
+        case DBMutation::AddTrade:
+        case DBMutation::UpdateTrade:
+            mutation.trade = readTrade(in);
+            break;
+        case DBMutation::AddToBlackList: {
+            qint64 expiresAt;
+            in >> mutation.ip >> expiresAt;
+            mutation.id = expiresAt;
+            break;
+        }
+        case DBMutation::RemoveFromBlackList:
+            in >> mutation.ip;
+            break;
+        case DBMutation::DeleteOrder:
+        case DBMutation::DeleteTrade: {
+            qint64 id;
+            in >> id;
+            mutation.id = id;
+            break;
+        }
+        default:
+            return false;
+        }
+        return in.status() == QDataStream::Ok;
+    }
+}
+
+bool Snapshot::read(QFile& file, SnapshotState& state)
+{
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    qint64 size = file.size();
+    uchar* data = size >= snapshotHeaderSize ? file.map(0, size) : nullptr;
+    if (!data) {
+        file.close();
+        return false;
+    }
+
+    bool res = false;
+    {
+        QByteArray raw = QByteArray::fromRawData(reinterpret_cast<const char*>(data), size);
+        QDataStream in(raw);
+        in.setVersion(streamVersion);
+        quint32 magic, version;
+        qint64 generation, maxOrderId, maxTradeId;
+        quint64 payloadSize;
+        quint32 checksum;
+        in >> magic >> version >> generation >> maxOrderId >> maxTradeId >> payloadSize >> checksum;
+        if (magic == snapshotMagic && version == formatVersion && payloadSize == quint64(size - snapshotHeaderSize) &&
+            crc32c(raw.constData() + snapshotHeaderSize, qint64(payloadSize)) == checksum) {
+            state.generation = generation;
+            state.maxOrderId = maxOrderId;
+            state.maxTradeId = maxTradeId;
+
+            quint32 count;
+            in >> count;
+            for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+                OrderInfoPtr order = readOrder(in);
+                state.orders.emplace_hint(state.orders.end(), order->orderId_, order);
+            }
+            in >> count;
+            for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+                TradeInfoPtr trade = readTrade(in);
+                shareOrder(state.orders, *trade);
+                state.trades.emplace_hint(state.trades.end(), trade->tradeId_, trade);
+            }
+            in >> count;
+            for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+                QString ip;
+                qint64 expiresAt;
+                in >> ip >> expiresAt;
+                state.blackList.emplace_hint(state.blackList.end(), ip, expiresAt);
+            }
+            res = in.status() == QDataStream::Ok;
+        }
+    }
+
+    file.unmap(data);
+    file.close();
+    if (!res) {
+        state = SnapshotState();
+    }
+    return res;
+}
+
+bool Snapshot::write(const QString& fileName, const SnapshotState& state)
+{
+    QByteArray payload;
+    {
+        QDataStream out(&payload, QIODevice::WriteOnly);
+        out.setVersion(streamVersion);
+        out << quint32(state.orders.size());
+        for (auto it = state.orders.begin(); it != state.orders.end(); ++it) {
+            writeOrder(out, *it->second);
+        }
+        out << quint32(state.trades.size());
+        for (auto it = state.trades.begin(); it != state.trades.end(); ++it) {
+            writeTrade(out, *it->second);
+        }
+        out << quint32(state.blackList.size());
+        for (auto it = state.blackList.begin(); it != state.blackList.end(); ++it) {
+            out << it->first << qint64(it->second);
+        }
+    }
+
+    QByteArray header;
+    {
+        QDataStream out(&header, QIODevice::WriteOnly);
+        out.setVersion(streamVersion);
+        out << snapshotMagic << formatVersion << qint64(state.generation)
+            << qint64(state.maxOrderId) << qint64(state.maxTradeId)
+            << quint64(payload.size()) << crc32c(payload.constData(), payload.size());
+    }
+
+    // the old snapshot stays valid until the new one is complete
+    QString tmpFileName = fileName + ".tmp";
+    QFile file(tmpFileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return false;
+    }
+    // the data is on the disk before the rename, otherwise a crash could leave an empty file under the name
+    bool res = file.write(header) == header.size() && file.write(payload) == payload.size() && syncFile(file);
+    file.close();
+    if (res) {
+        res = std::rename(QFile::encodeName(tmpFileName).constData(), QFile::encodeName(fileName).constData()) == 0;
+    }
+    if (res && !syncDirectory(fileName)) {
+        // the new snapshot is complete, only the rename may be lost in a crash
+        Logger::warning() << "Failed to sync the directory of " + fileName;
+    }
+    if (!res) {
+        QFile::remove(tmpFileName);
+    }
+    return res;
+}
+
+void Snapshot::apply(SnapshotState& state, const DBMutation& mutation)
+{
+    switch (mutation.type) {
+    case DBMutation::AddOrder:
+        state.orders[mutation.order->orderId_] = mutation.order;
+        state.maxOrderId = std::max(state.maxOrderId, mutation.order->orderId_);
+        break;
+    case DBMutation::AddTrade:
+        shareOrder(state.orders, *mutation.trade);
+        state.trades[mutation.trade->tradeId_] = mutation.trade;
+        state.maxTradeId = std::max(state.maxTradeId, mutation.trade->tradeId_);
+        state.maxOrderId = std::max(state.maxOrderId, mutation.trade->order_->orderId_);
+        break;
+    case DBMutation::UpdateTrade: {
+        // like the UPDATE statement it does nothing for a deleted trade
+        auto it = state.trades.find(mutation.trade->tradeId_);
+        if (it != state.trades.end()) {
+            it->second = mutation.trade;
+        }
+        break;
+    }
+    case DBMutation::AddToBlackList:
+        state.blackList[mutation.ip] = mutation.id;
+        break;
+    case DBMutation::RemoveFromBlackList:
+        state.blackList.erase(mutation.ip);
+        break;
+    case DBMutation::DeleteOrder:
+        state.orders.erase(mutation.id);
+        break;
+    case DBMutation::DeleteTrade:
+        state.trades.erase(mutation.id);
+        break;
+    case DBMutation::Checkpoint:
+        break;
+    }
+}
+
+Journal::Journal()
+{
+
+}
+
+Journal::~Journal()
+{
+    close();
+}
+
+bool Journal::open(const QString& fileName, long long generation, qint64 validSize)
+{
+    close();
+    file_.setFileName(fileName);
+    if (validSize >= journalHeaderSize) {
+        // drop a torn tail so the new records follow the last valid one
+        if (!file_.open(QIODevice::ReadWrite) || !file_.resize(validSize) || !file_.seek(validSize)) {
+            close();
+            return false;
+        }
+        return true;
+    }
+    if (!file_.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return false;
+    }
+    QDataStream out(&buffer_, QIODevice::WriteOnly);
+    out.setVersion(streamVersion);
+    out << journalMagic << formatVersion << qint64(generation);
+    if (!flush()) {
+        close();
+        return false;
+    }
+    if (!syncDirectory(fileName)) {
+        Logger::warning() << "Failed to sync the directory of " + fileName;
+    }
+    return true;
+}
+
+void Journal::close()
+{
+    if (file_.isOpen()) {
+        file_.close();
+    }
+    buffer_.clear();
+}
+
+bool Journal::isEmpty() const
+{
+    return buffer_.isEmpty() && file_.size() <= journalHeaderSize;
+}
+
+void Journal::append(const DBMutation& mutation)
+{
+    QByteArray payload;
+    {
+        QDataStream out(&payload, QIODevice::WriteOnly);
+        out.setVersion(streamVersion);
+        writeMutation(out, mutation);
+    }
+    QDataStream out(&buffer_, QIODevice::WriteOnly | QIODevice::Append);
+    out.setVersion(streamVersion);
+    out << quint32(payload.size()) << crc32c(payload.constData(), payload.size());
+    out.writeRawData(payload.constData(), payload.size());
+}
+
+bool Journal::flush()
+{
+    if (buffer_.isEmpty()) {
+        return true;
+    }
+    // a committed transaction must not be lost with the page cache
+    bool res = file_.write(buffer_) == buffer_.size() && syncFile(file_);
+    buffer_.clear();
+    return res;
+}
+
+bool Journal::read(const QString& fileName, long long generation, DBMutations& mutations, qint64& validSize)
+{
+    validSize = 0;
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    qint64 size = file.size();
+    uchar* data = size >= journalHeaderSize ? file.map(0, size) : nullptr;
+    if (!data) {
+        return false;
+    }
+
+    bool res = false;
+    {
+        QByteArray raw = QByteArray::fromRawData(reinterpret_cast<const char*>(data), size);
+        QDataStream in(raw);
+        in.setVersion(streamVersion);
+        quint32 magic, version;
+        qint64 journalGeneration;
+        in >> magic >> version >> journalGeneration;
+        // a journal of another generation is either older than the snapshot or left from a failed checkpoint
+        res = magic == journalMagic && version == formatVersion && journalGeneration == generation;
+
+        // the start of the record being read, a torn record is cut off here so the next records follow the last valid one
+        qint64 recordStart = journalHeaderSize;
+        while (res && recordStart + recordHeaderSize <= size) {
+            quint32 payloadSize;
+            quint32 checksum;
+            in >> payloadSize >> checksum;
+            qint64 offset = recordStart + recordHeaderSize;
+            if (offset + payloadSize > size || crc32c(raw.constData() + offset, payloadSize) != checksum) {
+                Logger::info() << "Journal " + fileName + " has a torn record at offset " + QString::number(recordStart) + ", the rest is skipped";
+                break;
+            }
+            QByteArray payload = QByteArray::fromRawData(raw.constData() + offset, payloadSize);
+            QDataStream record(payload);
+            record.setVersion(streamVersion);
+            DBMutation mutation;
+            if (!readMutation(record, mutation)) {
+                Logger::info() << "Journal " + fileName + " has an unknown record at offset " + QString::number(recordStart) + ", the rest is skipped";
+                break;
+            }
+            mutations.push_back(mutation);
+            in.skipRawData(payloadSize);
+            recordStart = offset + payloadSize;
+        }
+        if (res) {
+            validSize = recordStart;
+        }
+    }
+
+    file.unmap(data);
+    return res;
+}
@@ -0,0 +1,76 @@
+// Copyright 2018 AtomicSwap Solutions Ltd. All rights reserved.
+// Use of this source code is governed by Microsoft Reference Source
+// License (MS-RSL) that can be found in the LICENSE file.
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QString>
+#include <map>
+#include <memory>
+#include <set>
+#include "dbwriter.h"
+
+using Orders = std::map<long long, OrderInfoPtr>;
+using Trades = std::map<long long, TradeInfoPtr>;
+// entry -> expiry time in seconds since epoch, 0 never expires
+using BlackListEntries = std::map<QString, long long>;
+
+// Everything which is persisted in the database, as it would be loaded from it.
+struct SnapshotState {
+    SnapshotState() :
+        generation(0),
+        maxOrderId(0),
+        maxTradeId(0)
+    {}
+
+    long long generation;
+    long long maxOrderId;
+    long long maxTradeId;
+    Orders orders;
+    Trades trades;
+    BlackListEntries blackList;
+};
+using SnapshotStatePtr = std::shared_ptr<SnapshotState>;
+
+// Binary image of SnapshotState. The file is memory mapped for reading and
+// replaced atomically on writing, a torn or foreign file is rejected.
+class Snapshot
+{
+public:
+    static bool read(QFile& file, SnapshotState& state);
+    static bool write(const QString& fileName, const SnapshotState& state);
+    // mutations are idempotent, a mutation which is already in the state may be applied again
+    static void apply(SnapshotState& state, const DBMutation& mutation);
+};
+
+// Mutations written since the snapshot of the same generation. Every record has
+// its own checksum, reading stops at the first torn record.
+class Journal
+{
+public:
+    Journal();
+    ~Journal();
+
+    // starts a new empty journal or, with validSize, continues the one which was read
+    bool open(const QString& fileName, long long generation, qint64 validSize = 0);
+    void close();
+    bool isOpen() const { return file_.isOpen(); }
+    // no mutations since the snapshot
+    bool isEmpty() const;
+
+    void append(const DBMutation& mutation);
+    // writes the appended records to the file and syncs it, called before the database commit
+    bool flush();
+
+    // returns false when there is no journal for this generation, validSize
+    // is the size up to the first torn record
+    static bool read(const QString& fileName, long long generation, DBMutations& mutations, qint64& validSize);
+private:
+    QFile file_;
+    QByteArray buffer_;
+};
+
+#endif // SNAPSHOT_H
@@ -0,0 +1,71 @@
+// Copyright 2018 AtomicSwap Solutions Ltd. All rights reserved.
+// Use of this source code is governed by Microsoft Reference Source
+// License (MS-RSL) that can be found in the LICENSE file.
+
+#include "subscriptions.h"
+
+void Subscriptions::addConnection(qintptr descr)
+{
+    unscoped_.insert(descr);
+}
+
+void Subscriptions::removeConnection(qintptr descr)
+{
+    unscoped_.erase(descr);
+
+    auto it = connectionPairs_.find(descr);
+    if (it == connectionPairs_.end()) {
+        return;
+    }
+    for (auto itPair = it->second.begin(); itPair != it->second.end(); ++itPair) {
+        auto itSubscribers = pairs_.find(*itPair);
+        if (itSubscribers != pairs_.end()) {
+            itSubscribers->second.erase(descr);
+            if (itSubscribers->second.empty()) {
+                pairs_.erase(itSubscribers);
+            }
+        }
+    }
+    connectionPairs_.erase(it);
+}
+
+bool Subscriptions::subscribe(qintptr descr, const CurrencyPair& pair)
+{
+    if (!connectionPairs_[descr].insert(pair).second) {
+        return false;
+    }
+    pairs_[pair].insert(descr);
+    unscoped_.erase(descr);
+    return true;
+}
+
+bool Subscriptions::unsubscribe(qintptr descr, const CurrencyPair& pair)
+{
+    auto it = connectionPairs_.find(descr);
+    if (it == connectionPairs_.end() || it->second.erase(pair) == 0) {
+        return false;
+    }
+    if (it->second.empty()) {
+        connectionPairs_.erase(it);
+    }
+
+    auto itSubscribers = pairs_.find(pair);
+    if (itSubscribers != pairs_.end()) {
+        itSubscribers->second.erase(descr);
+        if (itSubscribers->second.empty()) {
+            pairs_.erase(itSubscribers);
+        }
+    }
+    return true;
+}
+
+void Subscriptions::getSubscribers(const CurrencyPair& pair, std::vector<qintptr>& subscribers) const
+{
+    auto it = pairs_.find(pair);
+    size_t count = unscoped_.size() + (it != pairs_.end() ? it->second.size() : 0);
+    subscribers.reserve(subscribers.size() + count);
+    subscribers.insert(subscribers.end(), unscoped_.begin(), unscoped_.end());
+    if (it != pairs_.end()) {
+        subscribers.insert(subscribers.end(), it->second.begin(), it->second.end());
+    }
+}
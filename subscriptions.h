@@ -0,0 +1,37 @@
+// Copyright 2018 AtomicSwap Solutions Ltd. All rights reserved.
+// Use of this source code is governed by Microsoft Reference Source
+// License (MS-RSL) that can be found in the LICENSE file.
+
+#ifndef SUBSCRIPTIONS_H
+#define SUBSCRIPTIONS_H
+
+#include <QtGlobal>
+#include <map>
+#include <set>
+#include <vector>
+#include "orderbook.h"
+
+using Subscribers = std::set<qintptr>;
+
+// Per currency pair subscriber sets for order events. A connection which has
+// never subscribed gets the events of every pair, as clients did before the
+// subscribe command existed, its first subscription narrows it to the
+// subscribed pairs for the rest of the connection.
+class Subscriptions
+{
+public:
+    void addConnection(qintptr descr);
+    void removeConnection(qintptr descr);
+    bool subscribe(qintptr descr, const CurrencyPair& pair);
+    bool unsubscribe(qintptr descr, const CurrencyPair& pair);
+    void getSubscribers(const CurrencyPair& pair, std::vector<qintptr>& subscribers) const;
+private:
+    using Pairs = std::map<CurrencyPair, Subscribers>;
+    using ConnectionPairs = std::map<qintptr, std::set<CurrencyPair>>;
+
+    Pairs pairs_;
+    ConnectionPairs connectionPairs_;
+    Subscribers unscoped_;
+};
+
+#endif // SUBSCRIPTIONS_H
@@ -0,0 +1,67 @@
+// Copyright 2018 AtomicSwap Solutions Ltd. All rights reserved.
+// Use of this source code is governed by Microsoft Reference Source
+// License (MS-RSL) that can be found in the LICENSE file.
+
+#include "tcpserver.h"
+#include "blacklist.h"
+#include "metrics.h"
+
+#ifdef Q_OS_UNIX
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+TcpServer::TcpServer(QObject* parent) :
+    QTcpServer(parent),
+    blackList_(nullptr),
+    rejectedCount_(0)
+{
+}
+
+void TcpServer::setBlackList(const BlackList* blackList)
+{
+    blackList_ = blackList;
+}
+
+void TcpServer::incomingConnection(qintptr socketDescriptor)
+{
+    if (isBlocked(socketDescriptor)) {
+#ifdef Q_OS_UNIX
+        ::close(int(socketDescriptor));
+#endif
+        ++rejectedCount_;
+        static Counter* blackListHits = Metrics::instance().counter("atom_engine_black_list_hits_total", "Connections and requests rejected by the black list", "stage=\"accept\"");
+        blackListHits->add();
+        return;
+    }
+    emit socketAccepted(socketDescriptor);
+}
+
+bool TcpServer::isBlocked(qintptr socketDescriptor) const
+{
+#ifdef Q_OS_UNIX
+    if (!blackList_) {
+        return false;
+    }
+    sockaddr_storage address;
+    socklen_t length = sizeof(address);
+    if (::getpeername(int(socketDescriptor), reinterpret_cast<sockaddr*>(&address), &length) != 0) {
+        return false;
+    }
+    if (address.ss_family == AF_INET) {
+        const sockaddr_in* ipv4 = reinterpret_cast<const sockaddr_in*>(&address);
+        return blackList_->contains(IpKey::fromIPv4(ntohl(ipv4->sin_addr.s_addr)));
+    }
+    if (address.ss_family == AF_INET6) {
+        const sockaddr_in6* ipv6 = reinterpret_cast<const sockaddr_in6*>(&address);
+        return blackList_->contains(IpKey::fromIPv6(ipv6->sin6_addr.s6_addr));
+    }
+    return false;
+#else
+    // other platforms check the address when the connection is opened
+    Q_UNUSED(socketDescriptor);
+    return false;
+#endif
+}
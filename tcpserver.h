@@ -0,0 +1,35 @@
+// Copyright 2018 AtomicSwap Solutions Ltd. All rights reserved.
+// Use of this source code is governed by Microsoft Reference Source
+// License (MS-RSL) that can be found in the LICENSE file.
+
+#ifndef TCPSERVER_H
+#define TCPSERVER_H
+
+#include <QTcpServer>
+
+class BlackList;
+
+// Listening server which does not create sockets itself, it only hands accepted
+// descriptors to the engine so they can be served by any connection worker.
+// Descriptors of blocked peers are closed right away, before any socket object
+// or worker is involved.
+class TcpServer : public QTcpServer
+{
+    Q_OBJECT
+public:
+    explicit TcpServer(QObject* parent = nullptr);
+
+    void setBlackList(const BlackList* blackList);
+    long long rejectedCount() const { return rejectedCount_; }
+signals:
+    void socketAccepted(qintptr socketDescriptor);
+protected:
+    void incomingConnection(qintptr socketDescriptor) override;
+private:
+    bool isBlocked(qintptr socketDescriptor) const;
+private:
+    const BlackList* blackList_;
+    long long rejectedCount_;
+};
+
+#endif // TCPSERVER_H
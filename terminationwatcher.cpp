@@ -0,0 +1,41 @@
+// Copyright 2018 AtomicSwap Solutions Ltd. All rights reserved.
+// Use of this source code is governed by Microsoft Reference Source
+// License (MS-RSL) that can be found in the LICENSE file.
+
+#include "terminationwatcher.h"
+#include <QCoreApplication>
+#include <csignal>
+
+namespace {
+    // how long a termination waits for the event loop
+    const int checkIntervalMs = 100;
+
+    volatile std::sig_atomic_t terminateRequested = 0;
+
+    void onTerminate(int)
+    {
+        terminateRequested = 1;
+    }
+}
+
+TerminationWatcher::TerminationWatcher(QObject* parent) :
+    QObject(parent)
+{
+    connect(&timer_, SIGNAL(timeout()), this, SLOT(onCheck()));
+}
+
+void TerminationWatcher::watch()
+{
+    std::signal(SIGINT, onTerminate);
+    std::signal(SIGTERM, onTerminate);
+    timer_.start(checkIntervalMs);
+}
+
+void TerminationWatcher::onCheck()
+{
+    if (terminateRequested) {
+        timer_.stop();
+        // leave the event loop so that the engine is destroyed and drains its database queue
+        QCoreApplication::quit();
+    }
+}
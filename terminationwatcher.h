@@ -0,0 +1,27 @@
+// Copyright 2018 AtomicSwap Solutions Ltd. All rights reserved.
+// Use of this source code is governed by Microsoft Reference Source
+// License (MS-RSL) that can be found in the LICENSE file.
+
+#ifndef TERMINATIONWATCHER_H
+#define TERMINATIONWATCHER_H
+
+#include <QObject>
+#include <QTimer>
+
+// Quits the application on SIGINT and SIGTERM. The signal handler only sets a
+// flag, nothing else is safe to call from it, and a timer checks the flag in
+// the event loop and calls QCoreApplication::quit() there.
+class TerminationWatcher : public QObject
+{
+    Q_OBJECT
+public:
+    explicit TerminationWatcher(QObject* parent = nullptr);
+    // installs the handlers, call once
+    void watch();
+private slots:
+    void onCheck();
+private:
+    QTimer timer_;
+};
+
+#endif // TERMINATIONWATCHER_H
@@ -0,0 +1,214 @@
+// Copyright 2018 AtomicSwap Solutions Ltd. All rights reserved.
+// Use of this source code is governed by Microsoft Reference Source
+// License (MS-RSL) that can be found in the LICENSE file.
+
+#include "binaryprotocoltest.h"
+#include "binaryprotocol.h"
+#include "info.h"
+#include "request.h"
+#include <QTest>
+#include <QtEndian>
+#include <algorithm>
+
+using namespace BinaryProtocol;
+
+namespace {
+    // the frame without its size, as LineFramer::nextFrame() returns it
+    QByteArray payloadOf(const QByteArray& frame)
+    {
+        if (frame.size() < 4) {
+            return QByteArray();
+        }
+        quint32 size = qFromBigEndian<quint32>(reinterpret_cast<const uchar*>(frame.constData()));
+        return size == quint32(frame.size() - 4) ? frame.mid(4) : QByteArray();
+    }
+
+    QByteArray type(quint16 value)
+    {
+        uchar bytes[2];
+        qToBigEndian<quint16>(value, bytes);
+        return QByteArray(reinterpret_cast<const char*>(bytes), 2);
+    }
+
+    QByteArray tag(Field field, WireType wire)
+    {
+        return QByteArray(1, char(field << 2 | wire));
+    }
+
+    QByteArray size(quint32 value)
+    {
+        uchar bytes[4];
+        qToBigEndian<quint32>(value, bytes);
+        return QByteArray(reinterpret_cast<const char*>(bytes), 4);
+    }
+
+    QByteArray bytesField(Field field, const QByteArray& value)
+    {
+        return tag(field, Bytes) + size(value.size()) + value;
+    }
+
+    // a create_trade payload with the first count of its fields, 3 is all of them
+    QByteArray createTrade(int count)
+    {
+        Writer writer(CreateTrade);
+        if (count > 0) {
+            writer.addString(Key, "key");
+        }
+        if (count > 1) {
+            writer.addInt(OrderId, 42);
+        }
+        if (count > 2) {
+            writer.addString(Address, "initiator");
+        }
+        return payloadOf(writer.finish());
+    }
+}
+
+void BinaryProtocolTest::orderRoundTrip()
+{
+    OrderInfo order;
+    order.orderId_ = 0;
+    order.sendCur_ = CurrencyCode::fromString("BTC");
+    order.sendCount_ = 100000000;
+    order.getCur_ = CurrencyCode::fromString("LTC");
+    order.getCount_ = 6000000000;
+    order.getAddress_ = QString::fromUtf8("addr \xc3\xa9");
+
+    Writer writer(CreateOrder);
+    writer.addString(Key, "key");
+    writer.addOrder(Order, order);
+    QByteArray payload = payloadOf(writer.finish());
+    QVERIFY(!payload.isEmpty());
+
+    Request request;
+    QVERIFY(decodeRequest(payload, request));
+    QCOMPARE(int(request.command), int(Commands::CreateOrder));
+    QCOMPARE(request.key, QString("key"));
+    QVERIFY(request.order != nullptr);
+    QCOMPARE(request.orderSendCur, QString("BTC"));
+    QCOMPARE(request.orderGetCur, QString("LTC"));
+    QCOMPARE(request.order->sendCount_, order.sendCount_);
+    QCOMPARE(request.order->getCount_, order.getCount_);
+    QCOMPARE(request.order->getAddress_, order.getAddress_);
+}
+
+void BinaryProtocolTest::tradeRoundTrip()
+{
+    Writer writer(UpdateTrade);
+    writer.addString(Key, "key");
+    writer.beginMessage(Trade);
+    writer.addInt(Id, 7);
+    writer.addString(SecretHash, "secret");
+    writer.addString(ContractInitiator, "contract");
+    writer.addBool(CommissionInitiatorPaid, true);
+    writer.addBool(RefundedPart, false);
+    writer.addInt(RefundTimeInit, 1539820800);
+    // a newer client's field is skipped
+    writer.addString(Field(60), "unknown");
+    writer.endMessage();
+    writer.addInt(Seq, 3);
+    QByteArray payload = payloadOf(writer.finish());
+    QVERIFY(!payload.isEmpty());
+
+    Request request;
+    QVERIFY(decodeRequest(payload, request));
+    QCOMPARE(int(request.command), int(Commands::UpdateTrade));
+    QCOMPARE(request.key, QString("key"));
+    const TradeUpdate& trade = request.trade;
+    QCOMPARE(trade.id, 7LL);
+    QCOMPARE(trade.secretHash, QString("secret"));
+    QCOMPARE(trade.contractInitiator, QString("contract"));
+    QVERIFY(trade.contractParticipant.isNull());
+    QVERIFY(trade.commissionInitiatorPaid);
+    QVERIFY(!trade.commissionParticipantPaid);
+    QVERIFY(!trade.hasRefundedInit);
+    QVERIFY(trade.hasRefundedPart);
+    QVERIFY(!trade.refundedPart);
+    QVERIFY(trade.hasRefundTimeInit);
+    QCOMPARE(trade.refundTimeInit, 1539820800LL);
+    QVERIFY(!trade.hasRefundTimePart);
+}
+
+void BinaryProtocolTest::jsonFrame()
+{
+    QByteArray payload = payloadOf(encodeJson("{\"command\": \"get_orders\", \"limit\": 5}\n"));
+    QVERIFY(!payload.isEmpty());
+    Request request;
+    QVERIFY(decodeRequest(payload, request));
+    QCOMPARE(int(request.command), int(Commands::GetOrders));
+    QCOMPARE(request.limit, 5LL);
+
+    Request broken;
+    QVERIFY(!decodeRequest(payloadOf(encodeJson("{\"command\": ")), broken));
+}
+
+void BinaryProtocolTest::rejectsMalformed_data()
+{
+    QTest::addColumn<QByteArray>("payload");
+
+    QTest::newRow("empty") << QByteArray();
+    QTest::newRow("half a type") << QByteArray(1, '\0');
+    QTest::newRow("unknown type") << type(77) + bytesField(Key, "key");
+    QTest::newRow("reply type") << type(CreateOrderSuccess);
+    QTest::newRow("int without value") << type(DeleteOrder) + tag(Id, Int) + QByteArray(7, '\0');
+    QTest::newRow("bool without value") << type(DeleteOrder) + tag(Id, Bool);
+    QTest::newRow("torn size") << type(CreateTrade) + tag(Key, Bytes) + QByteArray(3, '\0');
+    QTest::newRow("bytes beyond the payload") << type(CreateTrade) + tag(Key, Bytes) + size(4) + "key";
+    QTest::newRow("huge size") << type(CreateTrade) + tag(Key, Bytes) + size(0xffffffff) + "key";
+    QTest::newRow("message beyond the payload") << type(CreateOrder) + tag(Order, Message) + size(64) + bytesField(SendCur, "BTC");
+    // the nested field does not fit its message even though the payload goes on
+    QTest::newRow("field beyond its message") << type(CreateOrder) + tag(Order, Message) + size(5) + bytesField(SendCur, "BTC") + bytesField(Key, "key");
+    QTest::newRow("torn field after valid ones") << type(CreateTrade) + bytesField(Key, "key") + tag(OrderId, Int) + QByteArray(2, '\0');
+}
+
+void BinaryProtocolTest::rejectsMalformed()
+{
+    QFETCH(QByteArray, payload);
+
+    Request request;
+    QVERIFY(!decodeRequest(payload, request));
+}
+
+void BinaryProtocolTest::rejectsTruncated()
+{
+    // a payload cut between two fields is a shorter valid request, any other cut is rejected
+    QByteArray payload = createTrade(3);
+    std::vector<int> boundaries;
+    for (int count = 0; count <= 3; ++count) {
+        boundaries.push_back(createTrade(count).size());
+        QCOMPARE(createTrade(count), payload.left(boundaries.back()));
+    }
+    for (int cut = 0; cut <= payload.size(); ++cut) {
+        bool boundary = std::find(boundaries.begin(), boundaries.end(), cut) != boundaries.end();
+        Request request;
+        QCOMPARE(decodeRequest(payload.left(cut), request), boundary);
+    }
+
+    Request request;
+    QVERIFY(decodeRequest(payload, request));
+    QCOMPARE(int(request.command), int(Commands::CreateTrade));
+    QCOMPARE(request.key, QString("key"));
+    QCOMPARE(request.orderId, 42LL);
+    QCOMPARE(request.address, QString("initiator"));
+}
+
+void BinaryProtocolTest::rejectsDeepMessages()
+{
+    // a trade event holds its order, as a request it nests one level too deep
+    OrderInfoPtr order = OrderInfo::create();
+    order->orderId_ = 1;
+    order->sendCount_ = 1;
+    order->getCount_ = 1;
+    TradeInfo trade(2, order, "initiator");
+    QByteArray event = encodeTrade(TradeCreated, trade);
+    QByteArray payload = type(UpdateTrade) + payloadOf(event).mid(2);
+    Request request;
+    QVERIFY(!decodeRequest(payload, request));
+
+    // a message in an unknown field is skipped unread, but it still counts toward the depth
+    QByteArray inner = tag(Field(60), Message) + size(0);
+    Request nested;
+    QVERIFY(!decodeRequest(type(CreateOrder) + tag(Order, Message) + size(inner.size()) + inner, nested));
+    Request flat;
+    QVERIFY(decodeRequest(type(CreateOrder) + inner, flat));
+}
@@ -0,0 +1,25 @@
+// Copyright 2018 AtomicSwap Solutions Ltd. All rights reserved.
+// Use of this source code is governed by Microsoft Reference Source
+// License (MS-RSL) that can be found in the LICENSE file.
+
+#ifndef BINARYPROTOCOLTEST_H
+#define BINARYPROTOCOLTEST_H
+
+#include <QObject>
+
+// Requests encoded with BinaryProtocol::Writer and decoded as a server reads
+// them, and frames which the decoder has to reject.
+class BinaryProtocolTest : public QObject
+{
+    Q_OBJECT
+private slots:
+    void orderRoundTrip();
+    void tradeRoundTrip();
+    void jsonFrame();
+    void rejectsMalformed_data();
+    void rejectsMalformed();
+    void rejectsTruncated();
+    void rejectsDeepMessages();
+};
+
+#endif // BINARYPROTOCOLTEST_H
@@ -0,0 +1,93 @@
+// Copyright 2018 AtomicSwap Solutions Ltd. All rights reserved.
+// Use of this source code is governed by Microsoft Reference Source
+// License (MS-RSL) that can be found in the LICENSE file.
+
+#include "journaltest.h"
+#include "dbwriter.h"
+#include "snapshot.h"
+#include <QFile>
+#include <QFileInfo>
+#include <QTemporaryDir>
+#include <QTest>
+
+namespace {
+    const long long generation = 7;
+
+    DBMutation blackListed(int i)
+    {
+        DBMutation mutation;
+        mutation.type = DBMutation::AddToBlackList;
+        mutation.id = 1000 + i;
+        mutation.ip = "10.0.0." + QString::number(i);
+        return mutation;
+    }
+
+    void appendTo(const QString& fileName, qint64 validSize, int first, int count)
+    {
+        Journal journal;
+        QVERIFY(journal.open(fileName, generation, validSize));
+        for (int i = first; i < first + count; ++i) {
+            journal.append(blackListed(i));
+        }
+        QVERIFY(journal.flush());
+        journal.close();
+    }
+
+    void appendGarbage(const QString& fileName, const QByteArray& garbage)
+    {
+        QFile file(fileName);
+        QVERIFY(file.open(QIODevice::Append));
+        QCOMPARE(file.write(garbage), qint64(garbage.size()));
+    }
+
+    // reads the journal as a restart does and checks that it holds records 0 .. count - 1
+    void readBack(const QString& fileName, int count, qint64& validSize)
+    {
+        DBMutations mutations;
+        validSize = 0;
+        QVERIFY(Journal::read(fileName, generation, mutations, validSize));
+        QCOMPARE(int(mutations.size()), count);
+        for (int i = 0; i < count; ++i) {
+            QCOMPARE(int(mutations[i].type), int(DBMutation::AddToBlackList));
+            QCOMPARE(mutations[i].id, 1000LL + i);
+            QCOMPARE(mutations[i].ip, "10.0.0." + QString::number(i));
+        }
+    }
+}
+
+void JournalTest::tornTailSurvivesRestarts_data()
+{
+    QTest::addColumn<QByteArray>("tail");
+
+    // shorter than a record header
+    QTest::newRow("torn header") << QByteArray("\x00\x00", 2);
+    // a header whose payload was not written
+    QTest::newRow("torn payload") << QByteArray("\x00\x00\x00\x40\x12\x34\x56\x78" "abc", 11);
+    // a complete record which does not match its checksum
+    QTest::newRow("bad checksum") << QByteArray("\x00\x00\x00\x03\x12\x34\x56\x78" "abc", 11);
+}
+
+void JournalTest::tornTailSurvivesRestarts()
+{
+    QFETCH(QByteArray, tail);
+
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString fileName = dir.filePath("journal");
+
+    appendTo(fileName, 0, 0, 3);
+    appendGarbage(fileName, tail);
+
+    // the first restart drops the torn record and continues after the last valid one
+    qint64 validSize;
+    readBack(fileName, 3, validSize);
+    QCOMPARE(validSize, QFileInfo(fileName).size() - tail.size());
+    appendTo(fileName, validSize, 3, 2);
+
+    // the second restart sees the records of both runs
+    readBack(fileName, 5, validSize);
+    QCOMPARE(validSize, QFileInfo(fileName).size());
+    appendTo(fileName, validSize, 5, 1);
+
+    readBack(fileName, 6, validSize);
+}
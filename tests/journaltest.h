@@ -0,0 +1,19 @@
+// Copyright 2018 AtomicSwap Solutions Ltd. All rights reserved.
+// Use of this source code is governed by Microsoft Reference Source
+// License (MS-RSL) that can be found in the LICENSE file.
+
+#ifndef JOURNALTEST_H
+#define JOURNALTEST_H
+
+#include <QObject>
+
+// Recovery of the journal after a crash left a torn record at its end.
+class JournalTest : public QObject
+{
+    Q_OBJECT
+private slots:
+    void tornTailSurvivesRestarts_data();
+    void tornTailSurvivesRestarts();
+};
+
+#endif // JOURNALTEST_H
@@ -0,0 +1,159 @@
+// Copyright 2018 AtomicSwap Solutions Ltd. All rights reserved.
+// Use of this source code is governed by Microsoft Reference Source
+// License (MS-RSL) that can be found in the LICENSE file.
+
+#include "lineframertest.h"
+#include "lineframer.h"
+#include <QTest>
+#include <QtEndian>
+#include <algorithm>
+
+namespace {
+    QByteArray frame(const QByteArray& payload)
+    {
+        uchar size[4];
+        qToBigEndian<quint32>(payload.size(), size);
+        return QByteArray(reinterpret_cast<const char*>(size), 4) + payload;
+    }
+}
+
+void LineFramerTest::lineSplitAcrossReads()
+{
+    LineFramer framer;
+    QByteArray line;
+
+    framer.append("{\"command\":");
+    QVERIFY(!framer.next(line));
+    framer.append(" \"init\"}");
+    QVERIFY(!framer.next(line));
+    framer.append("\n{\"comm");
+    QVERIFY(framer.next(line));
+    QCOMPARE(line, QByteArray("{\"command\": \"init\"}"));
+    QVERIFY(!framer.next(line));
+    QCOMPARE(framer.size(), 6);
+
+    // several lines and an empty one in one read
+    framer.append("and\": 1}\n\n{}\n");
+    QVERIFY(framer.next(line));
+    QCOMPARE(line, QByteArray("{\"command\": 1}"));
+    QVERIFY(framer.next(line));
+    QCOMPARE(line, QByteArray());
+    QVERIFY(framer.next(line));
+    QCOMPARE(line, QByteArray("{}"));
+    QVERIFY(!framer.next(line));
+    QCOMPARE(framer.size(), 0);
+}
+
+void LineFramerTest::crlf()
+{
+    // '\r' stays in the line, the JSON reader skips it as whitespace
+    LineFramer framer;
+    QByteArray line;
+    framer.append("{\"id\": 1}\r\n{\"id\": 2}\r");
+    QVERIFY(framer.next(line));
+    QCOMPARE(line, QByteArray("{\"id\": 1}\r"));
+    QVERIFY(!framer.next(line));
+    framer.append("\n");
+    QVERIFY(framer.next(line));
+    QCOMPARE(line, QByteArray("{\"id\": 2}\r"));
+    QVERIFY(!framer.next(line));
+}
+
+void LineFramerTest::pendingSizeForLimit()
+{
+    // the worker drops the connection's input when size() goes above
+    // security/request_max_size_bytes, so it has to count the line which
+    // is not complete yet and nothing which was taken before it
+    const int maxSize = 64;
+    LineFramer framer;
+    QByteArray line;
+
+    framer.append(QByteArray(40, 'a') + "\n" + QByteArray(20, 'b'));
+    QCOMPARE(framer.size(), 61);
+    QVERIFY(framer.next(line));
+    QCOMPARE(framer.size(), 20);
+    QVERIFY(!framer.next(line));
+    QCOMPARE(framer.size(), 20);
+
+    framer.append(QByteArray(40, 'b'));
+    QVERIFY(!framer.next(line));
+    QCOMPARE(framer.size(), 60);
+    QVERIFY(framer.size() <= maxSize);
+    framer.append(QByteArray(10, 'b'));
+    QVERIFY(framer.size() > maxSize);
+
+    framer.clear();
+    QCOMPARE(framer.size(), 0);
+    framer.append("{}\n");
+    QVERIFY(framer.next(line));
+    QCOMPARE(line, QByteArray("{}"));
+}
+
+void LineFramerTest::compaction()
+{
+    LineFramer framer;
+    QByteArray line;
+
+    // the taken line is longer than the rest, the next append drops it
+    framer.append("aaaaaaaa\nbb");
+    QVERIFY(framer.next(line));
+    QCOMPARE(line, QByteArray("aaaaaaaa"));
+    QVERIFY(!framer.next(line));
+    framer.append("b\ncc");
+    QVERIFY(framer.next(line));
+    QCOMPARE(line, QByteArray("bbb"));
+    QCOMPARE(framer.size(), 2);
+
+    // reads of every size from 1 to 13 bytes, the buffer is compacted at many offsets
+    QByteArray stream;
+    QList<QByteArray> expected;
+    int maxLineSize = 0;
+    for (int i = 0; i < 200; ++i) {
+        QByteArray text = "{\"id\": " + QByteArray::number(i) + ", \"pad\": \"" + QByteArray(i % 17, 'x') + "\"}";
+        expected.append(text);
+        stream += text + "\n";
+        maxLineSize = std::max(maxLineSize, text.size());
+    }
+    LineFramer chunked;
+    QList<QByteArray> lines;
+    int pos = 0;
+    for (int chunk = 1; pos < stream.size(); chunk = chunk % 13 + 1) {
+        chunked.append(stream.mid(pos, chunk));
+        pos += chunk;
+        while (chunked.next(line)) {
+            // a line refers to the buffer, it is copied before the next append
+            lines.append(QByteArray(line.constData(), line.size()));
+        }
+        // only the line which is not complete yet is left
+        QVERIFY(chunked.size() <= maxLineSize);
+    }
+    QCOMPARE(lines, expected);
+    QCOMPARE(chunked.size(), 0);
+}
+
+void LineFramerTest::frameSplitAcrossReads()
+{
+    LineFramer framer;
+    QByteArray payload;
+    QByteArray first = frame("first payload");
+    QByteArray second = frame(QByteArray(300, 'p'));
+
+    // the size itself is torn
+    framer.append(first.left(2));
+    QVERIFY(!framer.nextFrame(payload));
+    framer.append(first.mid(2, 5));
+    QVERIFY(!framer.nextFrame(payload));
+    framer.append(first.mid(7) + second.left(100));
+    QVERIFY(framer.nextFrame(payload));
+    QCOMPARE(payload, QByteArray("first payload"));
+    QVERIFY(!framer.nextFrame(payload));
+    QCOMPARE(framer.size(), 100);
+
+    framer.append(second.mid(100) + frame(QByteArray()));
+    QVERIFY(framer.nextFrame(payload));
+    QCOMPARE(payload, QByteArray(300, 'p'));
+    QVERIFY(framer.nextFrame(payload));
+    QCOMPARE(payload, QByteArray());
+    QVERIFY(!framer.nextFrame(payload));
+    QCOMPARE(framer.size(), 0);
+}
@@ -0,0 +1,23 @@
+// Copyright 2018 AtomicSwap Solutions Ltd. All rights reserved.
+// Use of this source code is governed by Microsoft Reference Source
+// License (MS-RSL) that can be found in the LICENSE file.
+
+#ifndef LINEFRAMERTEST_H
+#define LINEFRAMERTEST_H
+
+#include <QObject>
+
+// Lines and frames taken from a connection's stream as it arrives in reads
+// of any size.
+class LineFramerTest : public QObject
+{
+    Q_OBJECT
+private slots:
+    void lineSplitAcrossReads();
+    void crlf();
+    void pendingSizeForLimit();
+    void compaction();
+    void frameSplitAcrossReads();
+};
+
+#endif // LINEFRAMERTEST_H
@@ -0,0 +1,39 @@
+// Copyright 2018 AtomicSwap Solutions Ltd. All rights reserved.
+// Use of this source code is governed by Microsoft Reference Source
+// License (MS-RSL) that can be found in the LICENSE file.
+
+#include <QCoreApplication>
+#include <QTest>
+#include "binaryprotocoltest.h"
+#include "journaltest.h"
+#include "lineframertest.h"
+#include "requestparsertest.h"
+#include "tradetest.h"
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+
+    int status = 0;
+    {
+        BinaryProtocolTest test;
+        status |= QTest::qExec(&test, argc, argv);
+    }
+    {
+        JournalTest test;
+        status |= QTest::qExec(&test, argc, argv);
+    }
+    {
+        LineFramerTest test;
+        status |= QTest::qExec(&test, argc, argv);
+    }
+    {
+        RequestParserTest test;
+        status |= QTest::qExec(&test, argc, argv);
+    }
+    {
+        TradeTest test;
+        status |= QTest::qExec(&test, argc, argv);
+    }
+    return status;
+}
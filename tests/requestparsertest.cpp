@@ -0,0 +1,158 @@
+// Copyright 2018 AtomicSwap Solutions Ltd. All rights reserved.
+// Use of this source code is governed by Microsoft Reference Source
+// License (MS-RSL) that can be found in the LICENSE file.
+
+#include "requestparsertest.h"
+#include "benchmarks/documentparser.h"
+#include "info.h"
+#include "request.h"
+#include <QTest>
+
+namespace {
+    // skipped containers deeper than this are rejected by JsonReader
+    const int maxSkipDepth = 64;
+
+    QByteArray nested(int depth)
+    {
+        return "{\"command\": \"get_orders\", \"extra\": " + QByteArray(depth, '[') + QByteArray(depth, ']') + "}";
+    }
+
+    void compareRequests(const Request& actual, const Request& expected)
+    {
+        QCOMPARE(int(actual.command), int(expected.command));
+        QCOMPARE(actual.key, expected.key);
+        QCOMPARE(actual.id, expected.id);
+        QCOMPARE(actual.orderId, expected.orderId);
+        QCOMPARE(actual.address, expected.address);
+        QVERIFY(actual.addrs == expected.addrs);
+        QCOMPARE(actual.binaryProtocol, expected.binaryProtocol);
+        QCOMPARE(actual.hasLastSeq, expected.hasLastSeq);
+        QCOMPARE(actual.lastSeq, expected.lastSeq);
+        QCOMPARE(actual.epoch, expected.epoch);
+        QCOMPARE(actual.sendCur, expected.sendCur);
+        QCOMPARE(actual.getCur, expected.getCur);
+        QCOMPARE(actual.limit, expected.limit);
+
+        QCOMPARE(bool(actual.order), bool(expected.order));
+        if (actual.order) {
+            QCOMPARE(actual.order->sendCount_, expected.order->sendCount_);
+            QCOMPARE(actual.order->getCount_, expected.order->getCount_);
+            QCOMPARE(actual.order->getAddress_, expected.order->getAddress_);
+        }
+        QCOMPARE(actual.orderSendCur, expected.orderSendCur);
+        QCOMPARE(actual.orderGetCur, expected.orderGetCur);
+
+        const TradeUpdate& trade = actual.trade;
+        const TradeUpdate& expectedTrade = expected.trade;
+        QCOMPARE(trade.id, expectedTrade.id);
+        QCOMPARE(trade.secretHash, expectedTrade.secretHash);
+        QCOMPARE(trade.contractInitiator, expectedTrade.contractInitiator);
+        QCOMPARE(trade.contractParticipant, expectedTrade.contractParticipant);
+        QCOMPARE(trade.initiatorContractTransaction, expectedTrade.initiatorContractTransaction);
+        QCOMPARE(trade.participantContractTransaction, expectedTrade.participantContractTransaction);
+        QCOMPARE(trade.initiatorRedemptionTransaction, expectedTrade.initiatorRedemptionTransaction);
+        QCOMPARE(trade.participantRedemptionTransaction, expectedTrade.participantRedemptionTransaction);
+        QCOMPARE(trade.commissionInitiatorPaid, expectedTrade.commissionInitiatorPaid);
+        QCOMPARE(trade.commissionParticipantPaid, expectedTrade.commissionParticipantPaid);
+        QCOMPARE(trade.hasRefundedInit, expectedTrade.hasRefundedInit);
+        QCOMPARE(trade.refundedInit, expectedTrade.refundedInit);
+        QCOMPARE(trade.hasRefundedPart, expectedTrade.hasRefundedPart);
+        QCOMPARE(trade.refundedPart, expectedTrade.refundedPart);
+        QCOMPARE(trade.hasRefundTimeInit, expectedTrade.hasRefundTimeInit);
+        QCOMPARE(trade.refundTimeInit, expectedTrade.refundTimeInit);
+        QCOMPARE(trade.hasRefundTimePart, expectedTrade.hasRefundTimePart);
+        QCOMPARE(trade.refundTimePart, expectedTrade.refundTimePart);
+    }
+}
+
+void RequestParserTest::matchesDocument_data()
+{
+    QTest::addColumn<QByteArray>("json");
+
+    QTest::newRow("create_order") << QByteArray("{\"command\": \"create_order\", \"key\": \"k\", \"order\": {\"sendCur\": \"BTC\", \"getCur\": \"LTC\", \"sendCount\": 100000000, \"getCount\": 6000000000, \"getAddr\": \"addr\"}}");
+    QTest::newRow("update_trade") << QByteArray("{\"command\": \"update_trade\", \"trade\": {\"id\": 7, \"secretHash\": \"abc\", \"commissionInitiatorPaid\": true, \"commissionParticipantPaid\": 1, \"refundedInit\": false, \"refundTimePart\": \"1539820800\"}}");
+    QTest::newRow("init") << QByteArray("{\"command\": \"init\", \"curs\": [{\"cur\": \"BTC\", \"addrs\": [\"a1\", \"a2\"]}, 5, {\"addrs\": [\"a3\"]}], \"protocol\": \"binary\", \"epoch\": 1539820800000, \"lastSeq\": 10}");
+    QTest::newRow("order is not an object") << QByteArray("{\"command\": \"create_order\", \"order\": [1, 2]}");
+    QTest::newRow("values of other types") << QByteArray("{\"key\": 5, \"id\": \"12\", \"orderId\": true, \"address\": null, \"limit\": 12.5, \"sendCur\": {}}");
+    QTest::newRow("whitespace") << QByteArray(" \r\n\t{ \"command\" :\"get_orders\" , \"limit\"\t: 3 }\r\n");
+    QTest::newRow("empty object") << QByteArray("{}");
+
+    // truncated lines
+    QTest::newRow("empty") << QByteArray();
+    QTest::newRow("open brace") << QByteArray("{");
+    QTest::newRow("member without value") << QByteArray("{\"command\":");
+    QTest::newRow("missing close") << QByteArray("{\"command\": \"init\"");
+    QTest::newRow("truncated string") << QByteArray("{\"key\": \"abc");
+    QTest::newRow("truncated escape") << QByteArray("{\"key\": \"abc\\");
+    QTest::newRow("truncated unicode escape") << QByteArray("{\"key\": \"\\u00");
+    QTest::newRow("truncated number") << QByteArray("{\"id\": -");
+    QTest::newRow("truncated exponent") << QByteArray("{\"id\": 1e");
+    QTest::newRow("truncated literal") << QByteArray("{\"refund\": tru}");
+    QTest::newRow("truncated nested") << QByteArray("{\"curs\": [{\"addrs\": [\"a\"");
+    QTest::newRow("garbage after the object") << QByteArray("{\"id\": 1} x");
+    QTest::newRow("not an object") << QByteArray("[{\"id\": 1}]");
+
+    // escapes and surrogates
+    QTest::newRow("escapes") << QByteArray("{\"key\": \"\\\"\\\\\\/\\b\\f\\n\\r\\t\"}");
+    QTest::newRow("unicode escapes") << QByteArray("{\"key\": \"\\u0041\\u00e9\\u20AC\"}");
+    QTest::newRow("utf-8") << QByteArray("{\"key\": \"\xc3\xa9\xe2\x82\xac\xf0\x9f\x98\x80\"}");
+    QTest::newRow("surrogate pair") << QByteArray("{\"key\": \"a\\ud83d\\ude00b\"}");
+    QTest::newRow("surrogate pair in addrs") << QByteArray("{\"curs\": [{\"addrs\": [\"\\uD83D\\uDE00\"]}]}");
+    QTest::newRow("unknown escape") << QByteArray("{\"key\": \"\\x\"}");
+    QTest::newRow("bad unicode escape") << QByteArray("{\"key\": \"\\u00g0\"}");
+
+    // numbers which do not fit a 64-bit integer, both convert them as a double
+    QTest::newRow("20 digits") << QByteArray("{\"id\": 12345678901234567890}");
+    QTest::newRow("below the minimum") << QByteArray("{\"id\": -9223372036854775809}");
+    QTest::newRow("long fraction") << QByteArray("{\"id\": 0.000000000000000000000000000000000000001}");
+    QTest::newRow("exponent") << QByteArray("{\"id\": 1e300, \"limit\": 2.5E+3}");
+    QTest::newRow("number string") << QByteArray("{\"id\": \"12345678901234567890\"}");
+
+    // skipped values
+    QTest::newRow("nested unknown") << QByteArray("{\"x\": {\"a\": [1, {\"b\": \"]}\"}], \"c\": null}, \"command\": \"subscribe\"}");
+    QTest::newRow("unbalanced unknown") << QByteArray("{\"x\": [1, 2}, \"command\": \"subscribe\"}");
+    QTest::newRow("deepest skipped value") << nested(maxSkipDepth);
+
+    // JsonReader scans strings eight bytes at a time, the quote and the
+    // escape fall on every offset around a chunk
+    for (int size = 0; size <= 17; ++size) {
+        QByteArray text(size, 'a');
+        QByteArray tag = "string of " + QByteArray::number(size);
+        QTest::newRow(tag.constData()) << QByteArray("{\"key\": \"" + text + "\"}");
+        tag = "escape after " + QByteArray::number(size);
+        QTest::newRow(tag.constData()) << QByteArray("{\"key\": \"" + text + "\\n\"}");
+        tag = "unterminated string of " + QByteArray::number(size);
+        QTest::newRow(tag.constData()) << QByteArray("{\"key\": \"" + text);
+    }
+}
+
+void RequestParserTest::matchesDocument()
+{
+    QFETCH(QByteArray, json);
+
+    Request expected;
+    bool expectedValid = DocumentParser::parse(json, expected);
+    Request actual;
+    QCOMPARE(RequestParser::parse(json, actual), expectedValid);
+    if (expectedValid) {
+        compareRequests(actual, expected);
+    }
+
+    // a line is a part of the read buffer, the reader must stop at its end
+    // even when a quote or a brace follows
+    QByteArray buffer = json + "\"}\\\"}]\"";
+    Request bounded;
+    QCOMPARE(RequestParser::parse(QByteArray::fromRawData(buffer.constData(), json.size()), bounded), expectedValid);
+    if (expectedValid) {
+        compareRequests(bounded, expected);
+    }
+}
+
+void RequestParserTest::rejectsDeepNesting()
+{
+    // QJsonDocument takes it, JsonReader limits the depth of skipped values
+    Request request;
+    QVERIFY(DocumentParser::parse(nested(maxSkipDepth + 1), request));
+    QVERIFY(!RequestParser::parse(nested(maxSkipDepth + 1), request));
+    QVERIFY(!RequestParser::parse(nested(1000), request));
+}
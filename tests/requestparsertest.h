@@ -0,0 +1,21 @@
+// Copyright 2018 AtomicSwap Solutions Ltd. All rights reserved.
+// Use of this source code is governed by Microsoft Reference Source
+// License (MS-RSL) that can be found in the LICENSE file.
+
+#ifndef REQUESTPARSERTEST_H
+#define REQUESTPARSERTEST_H
+
+#include <QObject>
+
+// RequestParser against the QJsonDocument reader it replaced, both have to
+// accept the same lines and give the same fields.
+class RequestParserTest : public QObject
+{
+    Q_OBJECT
+private slots:
+    void matchesDocument_data();
+    void matchesDocument();
+    void rejectsDeepNesting();
+};
+
+#endif // REQUESTPARSERTEST_H
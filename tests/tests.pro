@@ -0,0 +1,50 @@
+QT -= gui
+QT += network sql testlib
+
+CONFIG += c++11 console
+CONFIG -= app_bundle
+
+TARGET = atom-engine-tests
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+INCLUDEPATH += ..
+
+SOURCES += main.cpp \
+    binaryprotocoltest.cpp \
+    journaltest.cpp \
+    lineframertest.cpp \
+    requestparsertest.cpp \
+    tradetest.cpp \
+    ../benchmarks/documentparser.cpp \
+    ../binaryprotocol.cpp \
+    ../commands.cpp \
+    ../dbmanager.cpp \
+    ../dbwriter.cpp \
+    ../info.cpp \
+    ../jsonreader.cpp \
+    ../lineframer.cpp \
+    ../logger.cpp \
+    ../metrics.cpp \
+    ../request.cpp \
+    ../snapshot.cpp
+
+HEADERS += \
+    binaryprotocoltest.h \
+    journaltest.h \
+    lineframertest.h \
+    requestparsertest.h \
+    tradetest.h \
+    ../benchmarks/documentparser.h \
+    ../binaryprotocol.h \
+    ../commands.h \
+    ../dbmanager.h \
+    ../dbwriter.h \
+    ../info.h \
+    ../jsonreader.h \
+    ../lineframer.h \
+    ../logger.h \
+    ../metrics.h \
+    ../request.h \
+    ../slabpool.h \
+    ../snapshot.h
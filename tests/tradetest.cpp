@@ -0,0 +1,105 @@
+// Copyright 2018 AtomicSwap Solutions Ltd. All rights reserved.
+// Use of this source code is governed by Microsoft Reference Source
+// License (MS-RSL) that can be found in the LICENSE file.
+
+#include "tradetest.h"
+#include "dbmanager.h"
+#include "info.h"
+#include "snapshot.h"
+#include <QFile>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QTemporaryDir>
+#include <QTest>
+
+namespace {
+    const char* const schemaConnectionName = "trade-test-schema";
+    const long long orderId = 5;
+    const long long tradeId = 3;
+
+    void createSchema(const QString& name)
+    {
+        {
+            QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", schemaConnectionName);
+            db.setDatabaseName(name);
+            QVERIFY(db.open());
+            QSqlQuery query(db);
+            QVERIFY(query.exec("CREATE TABLE orders (id INTEGER PRIMARY KEY, sendCur TEXT, sendCount INTEGER, getCur TEXT, getCount INTEGER, getAddress TEXT, hash TEXT)"));
+            QVERIFY(query.exec("CREATE TABLE trades (orderId INTEGER, sendCur TEXT, sendCount INTEGER, getCur TEXT, getCount INTEGER, getAddress TEXT, orderHash TEXT, " \
+                               "id INTEGER PRIMARY KEY, initiatorAddress TEXT, secretHash TEXT, contractInitiator TEXT, contractParticipant TEXT, " \
+                               "initiatorContractTransaction TEXT, participantContractTransaction TEXT, initiatorRedemptionTransaction TEXT, participantRedemptionTransaction TEXT, " \
+                               "initiatorCommissionPaid INTEGER, participantCommissionPaid INTEGER, refundedInit INTEGER, refundedPart INTEGER, " \
+                               "refundTimeInit INTEGER, refundTimePart INTEGER, hash TEXT)"));
+            QVERIFY(query.exec("CREATE TABLE black_list (ip TEXT, expires_at INTEGER NOT NULL DEFAULT 0)"));
+            db.close();
+        }
+        QSqlDatabase::removeDatabase(schemaConnectionName);
+    }
+
+    // the state a restart finds holds the trade and not the order it took
+    void checkState(const Orders& orders, const Trades& trades)
+    {
+        QVERIFY(orders.find(orderId) == orders.end());
+        QCOMPARE(int(trades.size()), 1);
+        QCOMPARE(trades.begin()->first, tradeId);
+        QCOMPARE(trades.begin()->second->order_->orderId_, orderId);
+    }
+}
+
+void TradeTest::takenOrderIsGoneAfterRestart()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    DBSettings settings;
+    settings.name = dir.filePath("engine.db");
+    settings.syncCommit = true;
+    settings.snapshotFile = dir.filePath("engine.snapshot");
+    settings.journalFile = dir.filePath("engine.journal");
+    // the snapshot is written when snapshots start and on shutdown only
+    settings.snapshotIntervalSec = 0;
+    createSchema(settings.name);
+
+    DBManager& db = DBManager::instance();
+    QVERIFY(db.init(settings));
+    db.startSnapshots(std::make_shared<SnapshotState>(), 0);
+
+    OrderInfoPtr order = OrderInfo::create();
+    order->orderId_ = orderId;
+    order->sendCur_ = CurrencyCode::fromString("BTC");
+    order->sendCount_ = 100000000;
+    order->getCur_ = CurrencyCode::fromString("LTC");
+    order->getCount_ = 6000000000;
+    order->getAddress_ = "order address";
+    db.addToOrders(order);
+    db.addToTrades(TradeInfo::create(tradeId, order, "initiator address"));
+
+    // a crash now leaves the first snapshot and the journal of both mutations
+    const QString crashSnapshot = dir.filePath("crash.snapshot");
+    const QString crashJournal = dir.filePath("crash.journal");
+    QVERIFY(QFile::copy(settings.snapshotFile, crashSnapshot));
+    QVERIFY(QFile::copy(settings.journalFile, crashJournal));
+    db.shutdown();
+
+    Orders orders;
+    Trades trades;
+    db.loadOrders(orders);
+    db.loadTrades(orders, trades);
+    checkState(orders, trades);
+
+    SnapshotState state;
+    QFile snapshot(settings.snapshotFile);
+    QVERIFY(Snapshot::read(snapshot, state));
+    checkState(state.orders, state.trades);
+
+    SnapshotState crashState;
+    QFile crashFile(crashSnapshot);
+    QVERIFY(Snapshot::read(crashFile, crashState));
+    QVERIFY(crashState.trades.empty());
+    DBMutations mutations;
+    qint64 validSize;
+    QVERIFY(Journal::read(crashJournal, crashState.generation, mutations, validSize));
+    for (size_t i = 0; i < mutations.size(); ++i) {
+        Snapshot::apply(crashState, mutations[i]);
+    }
+    checkState(crashState.orders, crashState.trades);
+}
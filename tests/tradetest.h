@@ -0,0 +1,18 @@
+// Copyright 2018 AtomicSwap Solutions Ltd. All rights reserved.
+// Use of this source code is governed by Microsoft Reference Source
+// License (MS-RSL) that can be found in the LICENSE file.
+
+#ifndef TRADETEST_H
+#define TRADETEST_H
+
+#include <QObject>
+
+// Persisted state of a trade and the order it took.
+class TradeTest : public QObject
+{
+    Q_OBJECT
+private slots:
+    void takenOrderIsGoneAfterRestart();
+};
+
+#endif // TRADETEST_H